@@ -0,0 +1,156 @@
+#ifndef TYSON_AOT_RUNTIME_H__
+#define TYSON_AOT_RUNTIME_H__
+#include "lisp/env.h"
+#include "lisp/scope.h"
+#include "lisp/value.h"
+#include <array>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+// What the C++ tyson-aot writes calls, it needs the lisp library and
+// nothing else. The functions do what the resolved nodes of the same name
+// do in the tree engine, with the same errors.
+namespace aot
+{
+inline Value& global(std::unique_ptr<Env>& env, AtomTable::Atom name)
+{
+  Value* value{env->global(name)};
+  if (value == nullptr)
+  {
+    throw std::runtime_error("Could not find symbol " + env->get_name(name));
+  }
+  return *value;
+}
+
+inline void set_global(std::unique_ptr<Env>& env, AtomTable::Atom name, Value value)
+{
+  if (!env->set_global(name, std::move(value)))
+  {
+    throw std::runtime_error("Error trying to set " + env->get_name(name));
+  }
+}
+
+inline Value call(Value& callee, std::span<Value> args, std::unique_ptr<Env>& env)
+{
+  if (callee.is_procedure())
+  {
+    return callee.as_procedure()(args, env);
+  }
+  if (callee.is_primitive())
+  {
+    return callee.as_primitive()(args);
+  }
+  if (callee.is_closure())
+  {
+    return callee.as_closure()(args, env);
+  }
+  std::ostringstream out;
+  out << callee;
+  throw std::runtime_error("Cannot call " + out.str());
+}
+
+// A call in tail position, a procedure is left to the Procedure the lambda
+// runs under like the engines do, see Env::set_tail_call()
+inline Value tail_call(Value& callee, std::span<Value> args, std::unique_ptr<Env>& env)
+{
+  if (callee.is_procedure())
+  {
+    env->set_tail_call(callee.as_procedure(), {std::make_move_iterator(args.begin()),
+                                               std::make_move_iterator(args.end())});
+    return Value{Nil{}};
+  }
+  return call(callee, args, env);
+}
+
+// The value of a lambda called directly, once the tail calls it left ran
+inline Value finish(Value ret, std::unique_ptr<Env>& env)
+{
+  while (env->has_tail_call())
+  {
+    TailCall next{env->take_tail_call()};
+    ret = next.callee.body().call(next.args, env);
+  }
+  return ret;
+}
+
+// The builtin arithmetic and comparisons of a program that never defines
+// or sets their globals. Two ints are done here, anything else by the
+// primitive, which has the double arithmetic and the errors.
+enum class Builtin
+{
+  add,
+  sub,
+  mul,
+  lt,
+  gt,
+  eq
+};
+
+template <Builtin op>
+Value builtin(Value a, Value b, AtomTable::Atom name, std::unique_ptr<Env>& env)
+{
+  if (a.is_number() && b.is_number() && a.as_number().is_int() && b.as_number().is_int())
+  {
+    int x{a.as_number().as_int()};
+    int y{b.as_number().as_int()};
+    int r;
+    if constexpr (op == Builtin::add)
+    {
+      if (!__builtin_add_overflow(x, y, &r))
+      {
+        return Value{Number{r}};
+      }
+    }
+    else if constexpr (op == Builtin::sub)
+    {
+      if (!__builtin_sub_overflow(x, y, &r))
+      {
+        return Value{Number{r}};
+      }
+    }
+    else if constexpr (op == Builtin::mul)
+    {
+      if (!__builtin_mul_overflow(x, y, &r))
+      {
+        return Value{Number{r}};
+      }
+    }
+    else if constexpr (op == Builtin::lt)
+    {
+      return Value{Boolean{x < y}};
+    }
+    else if constexpr (op == Builtin::gt)
+    {
+      return Value{Boolean{x > y}};
+    }
+    else
+    {
+      return Value{Boolean{x == y}};
+    }
+  }
+  std::array<Value, 2> args{std::move(a), std::move(b)};
+  return call(global(env, name), args, env);
+}
+
+// A new scope for a call of a lambda, with the arguments in its first slots
+inline std::shared_ptr<Scope> enter(const std::shared_ptr<Scope>& parent, size_t size, size_t parameters,
+                                    std::span<Value> args)
+{
+  if (args.size() != parameters)
+  {
+    throw std::runtime_error("wrong number of arguments passed to lambda");
+  }
+  auto scope{std::make_shared<Scope>(parent, size)};
+  for (size_t i{0}; i < args.size(); ++i)
+  {
+    scope->slot(i) = std::move(args[i]);
+  }
+  return scope;
+}
+}
+
+#endif // TYSON_AOT_RUNTIME_H__
@@ -0,0 +1,97 @@
+#ifndef TYSON_TRANSLATOR_H__
+#define TYSON_TRANSLATOR_H__
+#include "ast/resolver.h"
+#include <cstddef>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Translates a resolved program to C++ that links against the lisp
+// library. Everything of a program goes in a namespace of its own, with
+// Value run(std::unique_ptr<Env>& env) running its forms in order, so
+// several programs can share a file.
+//
+// The whole program is known, so a global defined once at the top level
+// to a lambda and never set or defined again becomes a C++ function that
+// its calls go to directly. The builtin arithmetic and comparisons are
+// done inline unless the program defines or sets their globals. Tail
+// calls are left to the caller like in the engines, so a loop written as
+// recursion runs in constant stack. A Translator is for one program.
+class Translator
+{
+public:
+  Translator(std::unique_ptr<Env>& env);
+  std::string translate(const AST& program, const std::string& name);
+  // What the file starts with
+  static std::string prelude();
+  // A main that runs each program in an env of its own and prints the
+  // value of its last form, or the error it stopped with
+  static std::string main(const std::vector<std::string>& names);
+  // The run of a program as tyson_run, for a shared object
+  static std::string entry(const std::string& name);
+private:
+  // a global that is called directly
+  struct Direct
+  {
+    size_t index;
+    const ASTProcedure* lambda;
+  };
+  // Where generated statements go, at the indentation of the block
+  struct Out
+  {
+    std::ostringstream code;
+    size_t indent;
+    void line(const std::string& text);
+  };
+
+  void find_directs(const AST& program);
+  // Emits the statements node needs, returns a C++ expression of its value
+  std::string expression(const AST& node, Out& out);
+  std::string call(const ASTCall& call, Out& out);
+  // Emits the function of a lambda and its Body once, gives its number
+  size_t lambda(const ASTProcedure& lambda);
+  std::string temporary(const std::string& value, Out& out);
+  std::string atom(AtomTable::Atom name);
+  std::string constant(const Value& value);
+  std::string value_code(Value value);
+
+  std::unique_ptr<Env>& env_;
+  std::map<AtomTable::Atom, Direct> directs_;
+  // globals a define or set changes anywhere in the program
+  std::set<AtomTable::Atom> changed_;
+  std::map<AtomTable::Atom, size_t> atoms_;
+  // where the defines that guards are on leave versions
+  std::map<const uint32_t*, size_t> versions_;
+  std::map<const ASTProcedure*, size_t> lambdas_;
+  std::vector<std::string> constants_;
+  std::ostringstream declarations_;
+  std::ostringstream functions_;
+  size_t temporaries_{0};
+};
+
+// How tyson-aot builds translated code. The compiler is $CXX when that is
+// set. The tyson headers and the libraries an executable links are found at
+// $TYSON_AOT_INCLUDE and $TYSON_AOT_LIBRARIES, a list separated by ':', and
+// at the paths of the tree it was built in otherwise.
+class Toolchain
+{
+public:
+  Toolchain();
+  void set_flags(const std::string& flags) { flags_ = flags; }
+  void set_include(const std::string& include) { include_ = include; }
+  void set_libraries(const std::string& libraries) { libraries_ = libraries; }
+  // Whether the compiler is a program that can be run
+  bool available() const;
+  // Builds a C++ file into an executable, or a shared object that leaves
+  // the lisp library to the program that loads it. Throws on failure.
+  void build(const std::string& source, const std::string& output, bool shared) const;
+private:
+  std::string compiler_;
+  std::string flags_;
+  std::string include_;
+  std::string libraries_;
+};
+
+#endif // TYSON_TRANSLATOR_H__
@@ -0,0 +1,32 @@
+#ifndef TYSON_ANALYSIS_H__
+#define TYSON_ANALYSIS_H__
+#include "ast/ast.h"
+#include "lexer/line_index.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A pass over a tree fresh from the parser. It checks the shape of every
+// special form once, so evaluating them does not have to, and puts lowered
+// nodes in place of define, set, let and lambda. Their names are interned
+// in the atom table of env, the tree has to run in env.
+class Analysis
+{
+public:
+  // locate turns an offset into the line and column errors report
+  Analysis(std::unique_ptr<Env>& env, std::function<Position(size_t)> locate);
+  std::unique_ptr<AST> lower(std::unique_ptr<AST> ast);
+private:
+  [[noreturn]] void error(const std::string& message, const AST& node) const;
+  std::unique_ptr<AST> lower_define(std::unique_ptr<AST> define);
+  std::unique_ptr<AST> lower_set(std::unique_ptr<AST> set);
+  std::unique_ptr<AST> lower_let(std::unique_ptr<AST> let);
+  std::unique_ptr<AST> lower_lambda(std::unique_ptr<AST> lambda);
+  void lower_children(AST& node);
+
+  std::unique_ptr<Env>& env_;
+  std::function<Position(size_t)> locate_;
+};
+
+#endif // TYSON_ANALYSIS_H__
@@ -1,10 +1,12 @@
 #ifndef TYSON_AST_H__
 #define TYSON_AST_H__
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
 #include <ostream>
+#include <functional>
 #include "lisp/env.h"
 #include "lisp/runtime_types.h"
 
@@ -13,7 +15,7 @@ class Token;
 class AST
 {
 public:
-  enum class Type
+  enum class Type : uint8_t
   {
     number,
     string,
@@ -34,7 +36,14 @@ public:
   virtual ~AST() = default;
   virtual void add_child(std::unique_ptr<AST> child) {};
   virtual AST* get_child() { return nullptr; }
+  // Adds the direct children of the node to out, in source order
+  virtual void append_children(std::vector<const AST*>& out) const {}
+  // Puts what replace returns for each direct child in its place
+  using Replace = std::function<std::unique_ptr<AST>(std::unique_ptr<AST>)>;
+  virtual void replace_children(const Replace& replace) {}
   Type type() const { return type_; }
+  // Where the node starts in the input, the lexer knows its line and column
+  size_t offset() const { return offset_; }
   static std::unique_ptr<AST> factory(Token& token);
 //  virtual bool operator()() = 0;
   const std::string& str() const { return print_value_; }
@@ -45,38 +54,46 @@ public:
   virtual const std::string as_string() const { return ""; }
   virtual Value quote(std::unique_ptr<Env>& env) { return Value{Nil{}}; }
 protected:
-  size_t line_;
-  size_t column_;
+  size_t offset_;
   Type type_;
   const std::string print_value_;
 private:
   static std::unique_ptr<AST> symbol_factory(Token& token);
 };
 
+// The top-level forms of an input, in order
 class ASTStart : public AST
 {
 public:
   ASTStart(Token& token) : AST{token} {type_ = AST::Type::start;}
   virtual void add_child(std::unique_ptr<AST> child) override;
-  virtual AST* get_child() override { return root_.get(); }
+  // The first form
+  virtual AST* get_child() override { return forms_.empty() ? nullptr : forms_.front().get(); }
+  AST* get_child_at(size_t index) { return forms_[index].get(); }
+  size_t size() const { return forms_.size(); }
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
+  // Runs every form but the last and returns the value of the last one,
+  // which like any single form is left for the caller to execute
   virtual Value eval(std::unique_ptr<Env>& env) override;
   virtual Value quote(std::unique_ptr<Env>& env) override;
 private:
-  std::unique_ptr<AST> root_;
+  std::vector<std::unique_ptr<AST>> forms_;
 };
 
 class ASTNumber : public AST
 {
 public:
   ASTNumber(Token& token);
-  double value() const { return value_; }
+  double value() const { return value_.as_double(); }
+  const Number& number() const { return value_; }
   virtual std::ostream& output(std::ostream& out) const;
   virtual Value eval(std::unique_ptr<Env>& env) override;
-  virtual double as_number() const override{ return value_; }
-  virtual Value quote(std::unique_ptr<Env>& env) override { return Value{Number{value_}}; }
+  virtual double as_number() const override{ return value_.as_double(); }
+  virtual Value quote(std::unique_ptr<Env>& env) override { return Value{value_}; }
   virtual const std::string as_string() const override { return ""; } // TODO
 private:
-  double value_;
+  Number value_;
 };
 
 class ASTString : public AST
@@ -112,6 +129,8 @@ public:
   ASTList(Token& token);
   void add_child(std::unique_ptr<AST> child) override;
   virtual std::ostream& output(std::ostream& out) const;
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
   virtual Value eval(std::unique_ptr<Env>& env) override;
   virtual Value quote(std::unique_ptr<Env>& env) override;
   AST* get_child_at(size_t index) { return value_[index].get(); }
@@ -149,6 +168,8 @@ public:
   ASTQuote(Token& token);
   const std::string& value() const;
   void add_child(std::unique_ptr<AST> child) override;
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
   virtual Value eval(std::unique_ptr<Env>& env) override;
 private:
   std::unique_ptr<AST> value_;
@@ -158,6 +179,10 @@ class ASTIf : public AST
 {
 public:
   ASTIf(Token& token);
+  // An if with no children yet, where node is
+  ASTIf(const AST& node);
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
   virtual Value eval(std::unique_ptr<Env>& env) override;
   virtual Value quote(std::unique_ptr<Env>& env) override;
   void add_child(std::unique_ptr<AST> child) override;
@@ -172,6 +197,8 @@ class ASTDefine : public AST
 {
 public:
   ASTDefine(Token& token);
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
   virtual Value eval(std::unique_ptr<Env>& env) override;
   virtual Value quote(std::unique_ptr<Env>& env) override;
   void add_child(std::unique_ptr<AST> child) override;
@@ -185,6 +212,8 @@ class ASTSet : public AST
 {
 public:
   ASTSet(Token& token);
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
   virtual Value eval(std::unique_ptr<Env>& env) override;
   virtual Value quote(std::unique_ptr<Env>& env) override;
   void add_child(std::unique_ptr<AST> child) override;
@@ -198,6 +227,8 @@ class ASTLet : public AST
 {
 public:
   ASTLet(Token& token);
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
   virtual Value eval(std::unique_ptr<Env>& env) override;
   virtual Value quote(std::unique_ptr<Env>& env) override;
   void add_child(std::unique_ptr<AST> child) override;
@@ -210,6 +241,8 @@ class ASTLambda : public AST
 {
 public:
   ASTLambda(Token& token);
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
   virtual Value eval(std::unique_ptr<Env>& env) override;
   virtual Value quote(std::unique_ptr<Env>& env) override;
   void add_child(std::unique_ptr<AST> child) override;
@@ -218,4 +251,72 @@ private:
   std::vector<std::unique_ptr<AST>> statements_;
 };
 
+// The nodes Analysis puts in place of define, set, let and lambda. Their
+// shape was checked and their names interned, eval goes straight to work.
+class ASTLoweredDefine : public AST
+{
+public:
+  ASTLoweredDefine(const AST& define, AtomTable::Atom name, std::unique_ptr<AST> symbol, std::unique_ptr<AST> value);
+  AtomTable::Atom name() const { return name_; }
+  std::unique_ptr<AST>& value() { return value_; }
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+  virtual Value quote(std::unique_ptr<Env>& env) override;
+private:
+  AtomTable::Atom name_;
+  std::unique_ptr<AST> symbol_;
+  std::unique_ptr<AST> value_;
+};
+
+class ASTLoweredSet : public AST
+{
+public:
+  ASTLoweredSet(const AST& set, AtomTable::Atom name, std::unique_ptr<AST> symbol, std::unique_ptr<AST> value);
+  AtomTable::Atom name() const { return name_; }
+  std::unique_ptr<AST>& value() { return value_; }
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+  virtual Value quote(std::unique_ptr<Env>& env) override;
+private:
+  AtomTable::Atom name_;
+  std::unique_ptr<AST> symbol_;
+  std::unique_ptr<AST> value_;
+};
+
+class ASTLoweredLet : public AST
+{
+public:
+  // names and values are the bindings, in order
+  ASTLoweredLet(const AST& let, std::vector<AtomTable::Atom> names, std::vector<std::unique_ptr<AST>> values,
+                std::vector<std::unique_ptr<AST>> statements);
+  const std::vector<AtomTable::Atom>& names() const { return names_; }
+  std::vector<std::unique_ptr<AST>>& values() { return values_; }
+  std::vector<std::unique_ptr<AST>>& statements() { return statements_; }
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+  virtual Value quote(std::unique_ptr<Env>& env) override;
+private:
+  std::vector<AtomTable::Atom> names_;
+  std::vector<std::unique_ptr<AST>> values_;
+  std::vector<std::unique_ptr<AST>> statements_;
+};
+
+class ASTLoweredLambda : public AST
+{
+public:
+  // prototype is the Lambda every eval closes over the current frame
+  ASTLoweredLambda(const AST& lambda, Lambda prototype, std::unique_ptr<AST> bindings,
+                   std::vector<AtomTable::Atom> parameters, std::vector<std::unique_ptr<AST>> statements);
+  const std::vector<AtomTable::Atom>& parameters() const { return parameters_; }
+  std::vector<std::unique_ptr<AST>>& statements() { return statements_; }
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+  virtual Value quote(std::unique_ptr<Env>& env) override;
+private:
+  Lambda prototype_;
+  std::vector<AtomTable::Atom> parameters_;
+  std::unique_ptr<AST> bindings_;
+  std::vector<std::unique_ptr<AST>> statements_;
+};
+
 #endif // TYSON_AST_H__
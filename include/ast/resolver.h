@@ -0,0 +1,247 @@
+#ifndef TYSON_RESOLVER_H__
+#define TYSON_RESOLVER_H__
+#include "ast/ast.h"
+#include "lisp/scope.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A pass over a tree Analysis lowered. Every symbol is bound to where its
+// value lives: a slot depth scopes up from the running one, or the global
+// slot of its atom when no lambda or let around it has the name. The nodes
+// it makes run to a value, eval does all of the work and there is nothing
+// left to execute.
+class Resolver
+{
+public:
+  Resolver(std::unique_ptr<Env>& env);
+  std::unique_ptr<AST> resolve(std::unique_ptr<AST> ast);
+private:
+  // a let or lambda body, its names in slot order
+  struct Lexical
+  {
+    std::vector<AtomTable::Atom> names;
+  };
+  struct Address
+  {
+    size_t depth;
+    size_t index;
+  };
+  // false when the name is a global
+  bool find(AtomTable::Atom name, Address& address) const;
+  // The slot of name in the innermost scope, a new one if it has none
+  size_t declare(AtomTable::Atom name);
+  // Resolves statements in the innermost scope, the defines among them
+  // take their slots first so they can refer to each other
+  std::unique_ptr<AST> resolve_body(const AST& node, std::vector<std::unique_ptr<AST>>& statements);
+  std::unique_ptr<AST> resolve_define(std::unique_ptr<AST> define);
+  std::unique_ptr<AST> resolve_set(std::unique_ptr<AST> set);
+  std::unique_ptr<AST> resolve_let(std::unique_ptr<AST> let);
+  std::unique_ptr<AST> resolve_lambda(std::unique_ptr<AST> lambda);
+  std::unique_ptr<AST> resolve_call(std::unique_ptr<AST> list);
+  // Marks the calls whose value is the value of node as tail calls
+  void mark_tail(AST& node);
+
+  std::unique_ptr<Env>& env_;
+  std::vector<Lexical> scopes_;
+};
+
+// A value known before the program runs, a literal or a quoted form
+class ASTConstant : public AST
+{
+public:
+  ASTConstant(const AST& node, Value value);
+  const Value& value() const { return value_; }
+  virtual Value eval(std::unique_ptr<Env>& env) override { return value_; }
+private:
+  Value value_;
+};
+
+class ASTLocal : public AST
+{
+public:
+  ASTLocal(const AST& symbol, size_t depth, size_t index);
+  size_t depth() const { return depth_; }
+  size_t index() const { return index_; }
+  virtual Value eval(std::unique_ptr<Env>& env) override { return env->scope()->up(depth_)->slot(index_); }
+private:
+  size_t depth_;
+  size_t index_;
+};
+
+class ASTGlobal : public AST
+{
+public:
+  ASTGlobal(const AST& symbol, AtomTable::Atom name);
+  AtomTable::Atom name() const { return name_; }
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+private:
+  AtomTable::Atom name_;
+};
+
+// A list in code position, the first value is called with the others. A
+// tail call is the last thing its lambda does, a procedure it calls is
+// left to the Procedure the lambda runs under, see Env::set_tail_call().
+class ASTCall : public AST
+{
+public:
+  ASTCall(const AST& list, std::unique_ptr<AST> callee, std::vector<std::unique_ptr<AST>> arguments);
+  const AST& callee() const { return *callee_; }
+  const std::vector<std::unique_ptr<AST>>& arguments() const { return arguments_; }
+  bool tail() const { return tail_; }
+  void set_tail(bool tail) { tail_ = tail; }
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+  // The value of calling callee with arguments, what every engine does
+  static Value apply(Value& callee, std::span<Value> arguments, std::unique_ptr<Env>& env);
+  // The same for a tail call, a procedure is left to the caller
+  static Value tail_apply(Value& callee, std::vector<Value> arguments, std::unique_ptr<Env>& env);
+private:
+  std::unique_ptr<AST> callee_;
+  std::vector<std::unique_ptr<AST>> arguments_;
+  bool tail_{false};
+};
+
+class ASTDefineGlobal : public AST
+{
+public:
+  ASTDefineGlobal(const AST& define, AtomTable::Atom name, std::unique_ptr<AST> value);
+  AtomTable::Atom name() const { return name_; }
+  const AST& value() const { return *value_; }
+  // Where the define leaves the version it gave the global, when guards
+  // are on what it defined
+  const std::shared_ptr<uint32_t>& version() const { return version_; }
+  void set_version(std::shared_ptr<uint32_t> version) { version_ = std::move(version); }
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+private:
+  AtomTable::Atom name_;
+  std::unique_ptr<AST> value_;
+  std::shared_ptr<uint32_t> version_;
+};
+
+class ASTSetGlobal : public AST
+{
+public:
+  ASTSetGlobal(const AST& set, AtomTable::Atom name, std::unique_ptr<AST> value);
+  AtomTable::Atom name() const { return name_; }
+  const AST& value() const { return *value_; }
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+private:
+  AtomTable::Atom name_;
+  std::unique_ptr<AST> value_;
+};
+
+// A set of a local, and a define in a body, which took its slot up front
+class ASTSetLocal : public AST
+{
+public:
+  ASTSetLocal(const AST& set, size_t depth, size_t index, std::unique_ptr<AST> value);
+  size_t depth() const { return depth_; }
+  size_t index() const { return index_; }
+  const AST& value() const { return *value_; }
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+private:
+  size_t depth_;
+  size_t index_;
+  std::unique_ptr<AST> value_;
+};
+
+// Statements run in order for the value of the last, nil for none
+class ASTBlock : public AST
+{
+public:
+  ASTBlock(const AST& node, std::vector<std::unique_ptr<AST>> statements);
+  const std::vector<std::unique_ptr<AST>>& statements() const { return statements_; }
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+private:
+  std::vector<std::unique_ptr<AST>> statements_;
+};
+
+// A let, its values go in the first slots of a new scope
+class ASTScope : public AST
+{
+public:
+  ASTScope(const AST& let, std::vector<std::unique_ptr<AST>> values, size_t size, std::unique_ptr<AST> body);
+  const std::vector<std::unique_ptr<AST>>& values() const { return values_; }
+  size_t size() const { return size_; }
+  const AST& body() const { return *body_; }
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+private:
+  std::vector<std::unique_ptr<AST>> values_;
+  size_t size_;
+  std::unique_ptr<AST> body_;
+};
+
+// What a pass over a resolved tree puts in place of a node it made faster
+// on what some globals held. While each global keeps the version it had
+// then, fast is evaluated, once one of them changed, slow, the node it
+// replaced. A version can be shared with the define that gives it, it is
+// 0 until that ran and such a guard does not hold.
+class ASTGuard : public AST
+{
+public:
+  using Guards = std::vector<std::pair<AtomTable::Atom, std::shared_ptr<const uint32_t>>>;
+  ASTGuard(const AST& node, Guards guards, std::unique_ptr<AST> fast, std::unique_ptr<AST> slow);
+  const Guards& guards() const { return guards_; }
+  const AST& fast() const { return *fast_; }
+  const AST& slow() const { return *slow_; }
+  static bool holds(const Guards& guards, std::unique_ptr<Env>& env);
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+private:
+  Guards guards_;
+  std::unique_ptr<AST> fast_;
+  std::unique_ptr<AST> slow_;
+};
+
+// A resolved lambda. Its arguments go in the first slots of the scope of
+// a call, size counts those and the defines of the body.
+struct Code
+{
+  size_t parameters;
+  size_t size;
+  std::unique_ptr<AST> body;
+};
+
+// The Body of a Procedure made from a resolved lambda, it evaluates the
+// tree of the lambda in a scope under the one the lambda closed over. A
+// tail call of itself runs again in the same scope.
+class TreeBody : public Body
+{
+public:
+  TreeBody(std::shared_ptr<Code> code, std::shared_ptr<Scope> scope) :
+    code_{std::move(code)}, scope_{std::move(scope)} {}
+  virtual Value call(std::span<Value> args, std::unique_ptr<Env>& env) override;
+private:
+  std::shared_ptr<Code> code_;
+  std::shared_ptr<Scope> scope_;
+};
+
+class ASTProcedure : public AST
+{
+public:
+  ASTProcedure(const AST& lambda, std::shared_ptr<Code> code);
+  const std::shared_ptr<Code>& code() const { return code_; }
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+private:
+  std::shared_ptr<Code> code_;
+};
+
+#endif // TYSON_RESOLVER_H__
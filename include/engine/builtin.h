@@ -0,0 +1,29 @@
+#ifndef TYSON_BUILTIN_H__
+#define TYSON_BUILTIN_H__
+#include "lisp/value.h"
+#include <string>
+
+// The arithmetic and comparison primitives Env loads, which compiled code
+// may do itself as long as their global still holds them
+enum class Builtin
+{
+  add,
+  sub,
+  mul,
+  lt,
+  gt,
+  eq,
+  none
+};
+
+// Which builtin a name is bound to at first, none for any other name
+Builtin builtin(const std::string& name);
+// Whether value is still the primitive of op
+bool is_builtin(Value& value, Builtin op);
+bool is_comparison(Builtin op);
+bool comparison(Builtin op, Number& a, Number& b);
+// What the primitive gives for two numbers, ints stay ints until they
+// overflow like they do in accumulate()
+Value arithmetic(Builtin op, Number& a, Number& b);
+
+#endif // TYSON_BUILTIN_H__
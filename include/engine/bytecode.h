@@ -0,0 +1,90 @@
+#ifndef TYSON_BYTECODE_H__
+#define TYSON_BYTECODE_H__
+#include "ast/ast.h"
+#include "ast/resolver.h"
+#include "engine/engine.h"
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+// The instructions of the stack machine. a and b are their operands, an
+// instruction that takes none leaves them 0.
+enum class Op : uint8_t
+{
+  // push constants[a]
+  constant,
+  // push slot b of the scope a levels up
+  local,
+  // push the global with atom a
+  global,
+  // store the top in slot b of the scope a levels up, the top stays
+  set_local,
+  set_global,
+  // the same, with the version it gives the global left in versions[b - 1]
+  // when b is not 0
+  define_global,
+  pop,
+  // go to code[a]
+  jump,
+  // pop the top and go to code[a] if it is false
+  jump_if_false,
+  // call the value under the a arguments on top, they are replaced by
+  // the result
+  call,
+  // the same, with the global of atom b as callee
+  call_global,
+  // a call or call_global in tail position, the callee takes the place of
+  // the function that calls it
+  tail_call,
+  tail_call_global,
+  // leave the function with the top as its value
+  ret,
+  // push a procedure of functions[a] that closes over the current scope
+  closure,
+  // pop b values into the first slots of a new scope of size a
+  enter,
+  // go back to the scope around the current one
+  leave,
+  // go to code[a] unless the globals of guards[b] keep their versions
+  guard
+};
+
+struct Instruction
+{
+  Op op;
+  uint32_t a;
+  uint32_t b;
+};
+
+// A compiled lambda, or a compiled top-level form with no parameters
+struct Function
+{
+  std::vector<Instruction> code;
+  std::vector<Value> constants;
+  std::vector<std::shared_ptr<const Function>> functions;
+  std::vector<ASTGuard::Guards> guards;
+  std::vector<std::shared_ptr<uint32_t>> versions;
+  size_t parameters{0};
+  size_t size{0};
+};
+
+std::ostream& operator<<(std::ostream& out, const Function& function);
+
+// Compiles a resolved tree to bytecode
+class Compiler
+{
+public:
+  std::shared_ptr<const Function> compile(const AST& form);
+private:
+  void emit(Function& function, const AST& node);
+  uint32_t add_constant(Function& function, Value value);
+};
+
+class VMEngine : public Engine
+{
+public:
+  virtual Program compile(std::unique_ptr<AST> form) override;
+};
+
+#endif // TYSON_BYTECODE_H__
@@ -0,0 +1,60 @@
+#ifndef TYSON_CLOSURE_H__
+#define TYSON_CLOSURE_H__
+#include "ast/ast.h"
+#include "engine/engine.h"
+#include "lisp/scope.h"
+#include <functional>
+#include <memory>
+#include <span>
+
+// A resolved node compiled to a C++ callable. What it needs, constants,
+// slots, atoms and the callables of its children, was bound when it was
+// made, running it is a call with the scope to run in.
+using Compiled = std::function<Value(const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env)>;
+// A value used where it is, a slot or a constant, any other node is
+// evaluated into temp
+using CompiledOperand = std::function<Value&(const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env,
+                                             Value& temp)>;
+// The test of an if, a comparison gives its answer without making a value
+using CompiledTest = std::function<bool(const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env)>;
+
+// Compiles a resolved tree node by node. A call of a global that holds a
+// built-in arithmetic or comparison primitive, with two arguments, becomes
+// a node that does the arithmetic itself while that global keeps the
+// version it had when the node checked it.
+class ClosureCompiler
+{
+public:
+  Compiled compile(const AST& node);
+private:
+  Compiled compile_call(const AST& node);
+  CompiledOperand compile_operand(const AST& node);
+  CompiledTest compile_test(const AST& node);
+};
+
+// A lambda compiled by ClosureCompiler
+struct ClosureCode
+{
+  size_t parameters;
+  size_t size;
+  Compiled body;
+};
+
+class ClosureBody final : public Body
+{
+public:
+  ClosureBody(std::shared_ptr<const ClosureCode> code, std::shared_ptr<Scope> scope) :
+    code_{std::move(code)}, scope_{std::move(scope)} {}
+  virtual Value call(std::span<Value> args, std::unique_ptr<Env>& env) override;
+private:
+  std::shared_ptr<const ClosureCode> code_;
+  std::shared_ptr<Scope> scope_;
+};
+
+class ClosureEngine : public Engine
+{
+public:
+  virtual Program compile(std::unique_ptr<AST> form) override;
+};
+
+#endif // TYSON_CLOSURE_H__
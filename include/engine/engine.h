@@ -0,0 +1,44 @@
+#ifndef TYSON_ENGINE_H__
+#define TYSON_ENGINE_H__
+#include "ast/ast.h"
+#include "lexer/line_index.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Runs resolved forms. An engine compiles a form once into whatever it
+// runs, the program it returns can then run in the env the form was
+// resolved in as often as needed.
+class Engine
+{
+public:
+  using Program = std::function<Value(std::unique_ptr<Env>&)>;
+  virtual ~Engine() = default;
+  virtual Program compile(std::unique_ptr<AST> form) = 0;
+  // "tree" evaluates the resolved tree, "vm" runs it as bytecode,
+  // "closure" as a tree of C++ callables, "quick" evaluates it with calls
+  // that specialise themselves and "jit" compiles its hot lambdas to
+  // native code. Throws for any other name.
+  static std::unique_ptr<Engine> factory(const std::string& name);
+  static const std::vector<std::string>& names();
+};
+
+class Optimizer;
+
+// Takes a form fresh from the parser to one an engine compiles: lowers it,
+// resolves its names and, given an optimizer, optimizes it. locate is as
+// Analysis has it.
+std::unique_ptr<AST> prepare(std::unique_ptr<AST> form, std::unique_ptr<Env>& env,
+                             std::function<Position(size_t)> locate, Optimizer* optimizer = nullptr);
+// Parses all of program as one form, prepares it and compiles it for engine
+Engine::Program compile(const std::string& program, Engine& engine, std::unique_ptr<Env>& env,
+                        Optimizer* optimizer = nullptr);
+
+class TreeEngine : public Engine
+{
+public:
+  virtual Program compile(std::unique_ptr<AST> form) override;
+};
+
+#endif // TYSON_ENGINE_H__
@@ -0,0 +1,87 @@
+#ifndef TYSON_JIT_H__
+#define TYSON_JIT_H__
+#include "ast/resolver.h"
+#include "engine/engine.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+// Switches for the template JIT, they apply to every jit engine in the
+// process and can change while code runs. A lambda is compiled on the call
+// that reaches the threshold, with the JIT off every lambda is interpreted.
+class Jit
+{
+public:
+  static bool enabled();
+  static void set_enabled(bool enabled);
+  static size_t threshold();
+  static void set_threshold(size_t calls);
+  // False where there is no code generator, anything but x86-64 Linux
+  static bool supported();
+};
+
+struct JitFunction;
+
+// What the JIT knows of one lambda, shared by every procedure made from
+// it. Only lambdas of ints are compiled: parameters, int constants, the
+// builtin arithmetic and comparisons, if, and calls of globals that hold
+// such lambdas. That code has no effects, so native code that finds
+// anything else, an overflow, a redefined builtin, a callee it cannot run,
+// gives up and the call runs again in the interpreter.
+class JitState
+{
+public:
+  JitState(std::shared_ptr<Code> code);
+  ~JitState();
+  const Code& code() const { return *code_; }
+  bool compiled() const { return function_ != nullptr; }
+  // The native code, compiling it first if it is due, nullptr while the
+  // lambda is interpreted
+  JitFunction* function(std::unique_ptr<Env>& env, bool now);
+  // Native code that gave up too often is dropped for good
+  void failed();
+private:
+  std::shared_ptr<Code> code_;
+  size_t calls_{0};
+  size_t failures_{0};
+  bool rejected_{false};
+  std::unique_ptr<JitFunction> function_;
+  // dropped code is kept, it may still be running further up the stack
+  std::vector<std::unique_ptr<JitFunction>> retired_;
+};
+
+class JitBody : public Body
+{
+public:
+  JitBody(std::shared_ptr<JitState> state, std::shared_ptr<Scope> scope) :
+    state_{std::move(state)}, scope_{std::move(scope)} {}
+  virtual Value call(std::span<Value> args, std::unique_ptr<Env>& env) override;
+  JitState& state() const { return *state_; }
+private:
+  std::shared_ptr<JitState> state_;
+  std::shared_ptr<Scope> scope_;
+};
+
+// A resolved lambda that makes procedures with a JitBody
+class ASTJitProcedure : public AST
+{
+public:
+  ASTJitProcedure(const AST& lambda, std::shared_ptr<Code> code);
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+private:
+  std::shared_ptr<Code> code_;
+  std::shared_ptr<JitState> state_;
+};
+
+// The tree engine with the lambdas of the tree JIT compiled once hot
+class JitEngine : public Engine
+{
+public:
+  virtual Program compile(std::unique_ptr<AST> form) override;
+};
+
+#endif // TYSON_JIT_H__
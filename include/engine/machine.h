@@ -0,0 +1,52 @@
+#ifndef TYSON_MACHINE_H__
+#define TYSON_MACHINE_H__
+#include "engine/bytecode.h"
+#include "lisp/scope.h"
+#include <memory>
+#include <span>
+#include <vector>
+
+// Runs bytecode. A call from one compiled function to another stays in the
+// loop of run(), it pushes a frame rather than recursing on the C++ stack.
+// A tail call replaces the frame of the caller, or reuses it for a call of
+// the same function, and a tail call from the first frame of any other
+// procedure is left to the Procedure the machine runs under.
+class Machine
+{
+public:
+  // Runs function with args in the first slots of a new scope under scope
+  Value run(std::shared_ptr<const Function> function, std::shared_ptr<Scope> scope, std::span<Value> args,
+            std::unique_ptr<Env>& env);
+private:
+  struct Frame
+  {
+    std::shared_ptr<const Function> function;
+    size_t pc;
+    std::shared_ptr<Scope> scope;
+  };
+  // Starts a call of a compiled procedure, or runs any other callee to its
+  // value. The arguments are the top count values of the stack, below is
+  // how many values under them go too, 1 for the callee of a call.
+  void call(Value& callee, size_t count, size_t below, bool tail, std::unique_ptr<Env>& env);
+  void enter(std::shared_ptr<const Function> function, std::shared_ptr<Scope> scope, std::span<Value> args,
+             bool tail);
+
+  std::vector<Value> stack_;
+  std::vector<Frame> frames_;
+};
+
+// The Body of a procedure made by the machine
+class MachineBody final : public Body
+{
+public:
+  MachineBody(std::shared_ptr<const Function> function, std::shared_ptr<Scope> scope) :
+    function_{std::move(function)}, scope_{std::move(scope)} {}
+  virtual Value call(std::span<Value> args, std::unique_ptr<Env>& env) override;
+  const std::shared_ptr<const Function>& function() const { return function_; }
+  const std::shared_ptr<Scope>& scope() const { return scope_; }
+private:
+  std::shared_ptr<const Function> function_;
+  std::shared_ptr<Scope> scope_;
+};
+
+#endif // TYSON_MACHINE_H__
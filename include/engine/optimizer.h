@@ -0,0 +1,75 @@
+#ifndef TYSON_OPTIMIZER_H__
+#define TYSON_OPTIMIZER_H__
+#include "ast/resolver.h"
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <vector>
+
+// Passes over a resolved form before an engine compiles it, in order:
+//
+// inline: a call of a global that a define at the top level set to a
+// small lambda becomes the body of the lambda, with the arguments in place
+// of the parameters. It is guarded on the version the define left the
+// global at. A lambda that calls itself is not inlined, nor is a call
+// whose arguments would then be evaluated in another order or more than
+// once.
+// fold: a call of a builtin on two constant numbers becomes its value,
+// guarded on the version of the global, so the call is made again once
+// the builtin was defined or set to something else.
+// prune: an if with a constant test becomes the branch it takes.
+// drop: the statements of a lambda or let body other than the last are
+// dropped when evaluating them can have no effect.
+class Optimizer
+{
+public:
+  // What each pass did, over every form optimized so far
+  struct Stats
+  {
+    size_t inlined{0};
+    size_t folded{0};
+    size_t pruned{0};
+    size_t dropped{0};
+  };
+
+  // The most nodes the body of a lambda that is inlined may have
+  static constexpr size_t inline_budget{24};
+
+  Optimizer(std::unique_ptr<Env>& env);
+  std::unique_ptr<AST> optimize(std::unique_ptr<AST> form);
+  const Stats& stats() const { return stats_; }
+private:
+  // A lambda the calls of a global can be replaced with
+  struct Inlinable
+  {
+    size_t parameters;
+    std::unique_ptr<AST> body;
+    std::shared_ptr<uint32_t> version;
+  };
+
+  std::unique_ptr<AST> inline_calls(std::unique_ptr<AST> node);
+  std::unique_ptr<AST> inline_call(std::unique_ptr<AST> node);
+  void learn(ASTDefineGlobal& define);
+  // Whether an argument is read the same wherever the body reads it
+  bool trivial(const AST& argument) const;
+  // What an argument is on the fast path, when it cannot have an effect,
+  // nullptr otherwise. The guards it needs go in guards.
+  std::unique_ptr<AST> simple(const AST& argument, ASTGuard::Guards& guards) const;
+  std::unique_ptr<AST> fold(std::unique_ptr<AST> node);
+  std::unique_ptr<AST> prune(std::unique_ptr<AST> node);
+  // body is whether node is the body of a lambda or let
+  std::unique_ptr<AST> drop(std::unique_ptr<AST> node, bool body);
+
+  std::unique_ptr<Env>& env_;
+  Stats stats_;
+  std::map<AtomTable::Atom, Inlinable> inlinable_;
+  // the slots set anywhere in each scope around the node being inlined
+  // into, the innermost last
+  std::vector<std::set<size_t>> assigned_;
+};
+
+std::ostream& operator<<(std::ostream& out, const Optimizer::Stats& stats);
+
+#endif // TYSON_OPTIMIZER_H__
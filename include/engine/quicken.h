@@ -0,0 +1,92 @@
+#ifndef TYSON_QUICKEN_H__
+#define TYSON_QUICKEN_H__
+#include "ast/resolver.h"
+#include "engine/builtin.h"
+#include "engine/engine.h"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Replaces the calls of globals in a resolved tree with nodes that
+// specialise themselves on what they see when they run. Every other node
+// stays as it is.
+class Quickener
+{
+public:
+  std::unique_ptr<AST> quicken(std::unique_ptr<AST> node);
+};
+
+// A two argument call of a global that held a builtin when the tree was
+// quickened. The first run picks a state from the operands, later runs
+// take the path of that state while its guard holds: the global keeps its
+// version and the operands are of the kind the state is for. A guard that
+// fails rewrites the node to a state that takes more, and generic calls
+// whatever the global holds like ASTCall. States only ever widen.
+class ASTQuickBuiltin : public AST
+{
+public:
+  enum class State
+  {
+    unknown,
+    ints,
+    doubles,
+    numbers,
+    generic
+  };
+  ASTQuickBuiltin(const AST& call, AtomTable::Atom name, Builtin op, std::unique_ptr<AST> left,
+                  std::unique_ptr<AST> right);
+  State state() const { return state_; }
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+private:
+  // The state operands a and b call for, at least the current one
+  State widen(Value& a, Value& b) const;
+  // What the global does with a and b, whatever it holds
+  Value call(Value& a, Value& b, std::unique_ptr<Env>& env);
+
+  AtomTable::Atom name_;
+  Builtin op_;
+  std::unique_ptr<AST> left_;
+  std::unique_ptr<AST> right_;
+  State state_;
+  uint32_t checked_;
+};
+
+// A call of a global. While the global keeps the version it had when the
+// node saw a procedure in it, the node calls that procedure without
+// reading the global, anything else makes it generic for good. A tail
+// call leaves the procedure to its caller like ASTCall.
+class ASTQuickCall : public AST
+{
+public:
+  enum class State
+  {
+    unknown,
+    procedure,
+    generic
+  };
+  ASTQuickCall(const AST& call, AtomTable::Atom name, std::vector<std::unique_ptr<AST>> arguments, bool tail);
+  State state() const { return state_; }
+  virtual void append_children(std::vector<const AST*>& out) const override;
+  virtual void replace_children(const Replace& replace) override;
+  virtual Value eval(std::unique_ptr<Env>& env) override;
+private:
+  AtomTable::Atom name_;
+  std::vector<std::unique_ptr<AST>> arguments_;
+  bool tail_;
+  State state_;
+  uint32_t checked_;
+  std::optional<Procedure> procedure_;
+};
+
+// The tree engine on a quickened tree
+class QuickEngine : public Engine
+{
+public:
+  virtual Program compile(std::unique_ptr<AST> form) override;
+};
+
+#endif // TYSON_QUICKEN_H__
@@ -0,0 +1,154 @@
+#ifndef TYSON_KEYWORDS_H__
+#define TYSON_KEYWORDS_H__
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+// The words the lexer and the AST give a meaning of their own. Both use the
+// same table, a perfect hash over the length and the first and last chars
+// found at compile time, so classifying a symbol is one probe and at most
+// one compare.
+enum class Keyword : unsigned char
+{
+  none,
+  set,
+  define,
+  nil,
+  if_t,
+  quote,
+  let,
+  lambda,
+  true_t,
+  false_t
+};
+
+namespace keyword_detail
+{
+struct Entry
+{
+  std::string_view name;
+  Keyword keyword;
+};
+
+inline constexpr std::array<Entry, 9> entries{{
+  {"set", Keyword::set},
+  {"define", Keyword::define},
+  {"nil", Keyword::nil},
+  {"if", Keyword::if_t},
+  {"quote", Keyword::quote},
+  {"let", Keyword::let},
+  {"lambda", Keyword::lambda},
+  {"true", Keyword::true_t},
+  {"false", Keyword::false_t}
+}};
+
+inline constexpr size_t table_size{16};
+
+constexpr char fold(char c)
+{
+  return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+struct Hash
+{
+  size_t length;
+  size_t first;
+  size_t last;
+  constexpr size_t operator()(std::string_view text) const
+  {
+    return (text.size() * length + fold(text.front()) * first +
+            fold(text.back()) * last) % table_size;
+  }
+};
+
+consteval bool is_perfect(Hash hash)
+{
+  std::array<bool, table_size> used{};
+  for (const Entry& entry : entries)
+  {
+    size_t slot{hash(entry.name)};
+    if (used[slot])
+    {
+      return false;
+    }
+    used[slot] = true;
+  }
+  return true;
+}
+
+consteval Hash find_hash()
+{
+  for (size_t length{1}; length < table_size; ++length)
+  {
+    for (size_t first{0}; first < table_size; ++first)
+    {
+      for (size_t last{0}; last < table_size; ++last)
+      {
+        if (is_perfect({length, first, last}))
+        {
+          return {length, first, last};
+        }
+      }
+    }
+  }
+  throw "no perfect hash for the keywords, grow table_size";
+}
+
+inline constexpr Hash hash{find_hash()};
+
+consteval std::array<Entry, table_size> make_table()
+{
+  std::array<Entry, table_size> table{};
+  for (const Entry& entry : entries)
+  {
+    table[hash(entry.name)] = entry;
+  }
+  return table;
+}
+
+inline constexpr std::array<Entry, table_size> table{make_table()};
+
+consteval std::array<size_t, 2> length_range()
+{
+  std::array<size_t, 2> range{entries[0].name.size(), entries[0].name.size()};
+  for (const Entry& entry : entries)
+  {
+    range[0] = entry.name.size() < range[0] ? entry.name.size() : range[0];
+    range[1] = entry.name.size() > range[1] ? entry.name.size() : range[1];
+  }
+  return range;
+}
+
+inline constexpr std::array<size_t, 2> lengths{length_range()};
+}
+
+// Keyword::none if text is not a keyword. With fold_case "Define" is a keyword too.
+constexpr Keyword classify_keyword(std::string_view text, bool fold_case = false)
+{
+  using namespace keyword_detail;
+  if (text.size() < lengths[0] || text.size() > lengths[1])
+  {
+    return Keyword::none;
+  }
+  const Entry& entry{table[hash(text)]};
+  if (entry.name.size() != text.size())
+  {
+    return Keyword::none;
+  }
+  for (size_t i{0}; i < text.size(); ++i)
+  {
+    char c{fold_case ? fold(text[i]) : text[i]};
+    if (c != entry.name[i])
+    {
+      return Keyword::none;
+    }
+  }
+  return entry.keyword;
+}
+
+static_assert(classify_keyword("lambda") == Keyword::lambda);
+static_assert(classify_keyword("FALSE", true) == Keyword::false_t);
+static_assert(classify_keyword("FALSE") == Keyword::none);
+static_assert(classify_keyword("lambdas") == Keyword::none);
+
+#endif // TYSON_KEYWORDS_H__
@@ -8,18 +8,25 @@ class Lexer : private StringHandler
 {
 public:
   Lexer(std::string src);
+  Lexer(std::unique_ptr<Source> source);
 
   Token token();
   void push_back(Token token);
-
-  const std::string& source() const { return text(); }
+  // Line and column of a token this lexer made
+  Position position(const Token& token) const { return StringHandler::position(token.offset()); }
+  // Offset of the next char to read, just past the last token taken unless
+  // some were pushed back
+  size_t offset() const { return index(); }
 private:
   bool is_coment_start() const;
   void skip_non_tokens();
+  Token read_token();
   Token get_string();
   Token get_number();
   Token get_symbol();
   bool is_number_start() const;
+  // Tokens from a source that slides its window can not point into it
+  Token finish(Token token) const;
   std::vector<Token> stack_;
 };
 
@@ -0,0 +1,30 @@
+#ifndef TYSON_LINE_INDEX_H__
+#define TYSON_LINE_INDEX_H__
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+struct Position
+{
+  size_t line;
+  size_t column;
+};
+
+// The offsets of every newline of an input, so line and column are only
+// worked out for the offsets someone asks about.
+class LineIndex
+{
+public:
+  // Record the newlines of text, which starts at offset base of the input.
+  // Text already added is skipped, so overlapping windows can be passed.
+  void add(std::string_view text, size_t base);
+  // Offset of the end of the text seen so far
+  size_t indexed() const { return end_; }
+  // Line and column, both from 1, of the char at offset
+  Position position(size_t offset) const;
+private:
+  std::vector<size_t> newlines_;
+  size_t end_{0};
+};
+
+#endif // TYSON_LINE_INDEX_H__
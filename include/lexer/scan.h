@@ -0,0 +1,44 @@
+#ifndef TYSON_SCAN_H__
+#define TYSON_SCAN_H__
+#include <cstddef>
+
+// Byte classification kernels used by the lexer to skip over runs of text
+// instead of walking them one char at a time. Each find function returns the
+// index of the first matching char in [data, data + size), or size.
+namespace scan
+{
+struct Lines
+{
+  size_t count;
+  // Index of the last newline, only meaningful when count > 0
+  size_t last;
+};
+
+struct Kernels
+{
+  const char* name;
+  // First char that is not white space
+  size_t (*skip_space)(const char* data, size_t size);
+  // First white space or ')', where a symbol ends
+  size_t (*symbol_end)(const char* data, size_t size);
+  // First '"' or '\\' inside a string literal
+  size_t (*string_end)(const char* data, size_t size);
+  // First '\n', where a comment ends
+  size_t (*newline)(const char* data, size_t size);
+  Lines (*count_lines)(const char* data, size_t size);
+};
+
+enum class Isa
+{
+  scalar,
+  sse2,
+  avx2
+};
+
+// The best kernels this cpu supports, picked once at startup
+const Kernels& kernels();
+// The kernels for a specific instruction set, nullptr if it is not available
+const Kernels* kernels(Isa isa);
+}
+
+#endif // TYSON_SCAN_H__
@@ -0,0 +1,85 @@
+#ifndef TYSON_SOURCE_H__
+#define TYSON_SOURCE_H__
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <memory>
+#include <istream>
+#include <functional>
+
+// The text a StringHandler reads from. The handler only looks at window(),
+// sources that hold the whole input never move it, streaming sources slide
+// it forward as more input is needed.
+class Source
+{
+public:
+  virtual ~Source() = default;
+
+  std::string_view window() const { return window_; }
+  // Offset in the input of the first char in the window
+  size_t base() const { return base_; }
+  // Views into the window stay valid for the lifetime of the source
+  virtual bool stable() const { return true; }
+  // Read more input into the window, text before the offset keep is no longer
+  // needed. Return false if there is no more input.
+  virtual bool fill(size_t keep) { return false; }
+
+  static std::unique_ptr<Source> from_string(std::string text);
+  // The text is not copied, it has to outlive the source. base is the offset
+  // of the view in a larger input, if it is part of one.
+  static std::unique_ptr<Source> from_view(std::string_view text, size_t base = 0);
+  static std::unique_ptr<Source> from_file(const std::string& path);
+  static std::unique_ptr<Source> from_stream(std::istream& in, size_t chunk = default_chunk);
+  static std::unique_ptr<Source> from_fd(int fd, size_t chunk = default_chunk);
+
+  static constexpr size_t default_chunk{64 * 1024};
+protected:
+  std::string_view window_;
+  size_t base_{0};
+};
+
+class StringSource : public Source
+{
+public:
+  StringSource(std::string text);
+private:
+  std::string text_;
+};
+
+class ViewSource : public Source
+{
+public:
+  ViewSource(std::string_view text, size_t base);
+};
+
+// A read only mmap of a whole file
+class MappedSource : public Source
+{
+public:
+  MappedSource(const std::string& path);
+  ~MappedSource();
+  MappedSource(const MappedSource&) = delete;
+  MappedSource& operator=(const MappedSource&) = delete;
+private:
+  void* data_;
+  size_t size_;
+};
+
+// Reads the input chunk by chunk, only the text from the keep offset on stays
+// in memory so a pipe of any length needs about a chunk of buffer.
+class StreamSource : public Source
+{
+public:
+  // Read up to size chars into the buffer, return how many were read, 0 at the end
+  using Reader = std::function<size_t(char* buffer, size_t size)>;
+  StreamSource(Reader reader, size_t chunk);
+  virtual bool stable() const override { return false; }
+  virtual bool fill(size_t keep) override;
+private:
+  Reader reader_;
+  size_t chunk_;
+  std::string buffer_;
+  bool done_;
+};
+
+#endif // TYSON_SOURCE_H__
@@ -1,16 +1,26 @@
 #ifndef TYSON_STRING_HANDLER_H__
 #define TYSON_STRING_HANDLER_H__
 #include <string>
+#include <string_view>
 #include <cstddef>
+#include <memory>
+#include "lexer/source.h"
+#include "lexer/scan.h"
+#include "lexer/line_index.h"
 
 class StringHandler
 {
 public:
   StringHandler(std::string text);
+  StringHandler(std::unique_ptr<Source> source);
+  StringHandler(StringHandler&&) = default;
+  StringHandler& operator=(StringHandler&&) = default;
   virtual ~StringHandler() = default;
 
-  size_t line() const { return line_; }
-  size_t column() const { return column_; }
+  // Only offsets are tracked while reading, lines and columns are looked up
+  size_t line() const { return position(index()).line; }
+  size_t column() const { return position(index()).column; }
+  Position position(size_t offset) const;
 
   // Return true if reading forward chars will be past the end of the inoput text
   bool eof(size_t forward=0) const;
@@ -20,11 +30,30 @@ public:
 
   bool is_space() const;
 protected:
-  const std::string& text() const { return text_; }
+  // Offset in the input of the next char
+  size_t index() const { return source_->base() + index_; }
+  // A view of the text between the two offsets, neither may be before the
+  // last mark. Valid while the handler lives if the source is stable.
+  std::string_view slice(size_t from, size_t to) const;
+  // Text from the current offset on is kept in memory until the next mark
+  void mark() { mark_ = index(); }
+  bool stable() const { return source_->stable(); }
+  // Move to the end of the current comment line, the newline is not consumed
+  void skip_line() { skip(kernels_->newline); }
+  // Move to the first char that ends a symbol
+  void skip_symbol() { skip(kernels_->symbol_end); }
+  // Move to the first '"' or '\\' of a string literal
+  void skip_string_chars() { skip(kernels_->string_end); }
 private:
-  std::string text_;
-  size_t index_;
-  size_t line_;
-  size_t column_;
+  // Consume chars for as long as find says they belong to the run
+  void skip(size_t (*find)(const char* data, size_t size));
+  // Pull input until forward chars are available, false if the input ends first
+  bool fill(size_t forward) const;
+  std::unique_ptr<Source> source_;
+  mutable std::string_view text_;
+  mutable size_t index_;
+  size_t mark_;
+  const scan::Kernels* kernels_;
+  mutable LineIndex lines_;
 };
 #endif // TYSON_STRING_HANDLER_H__
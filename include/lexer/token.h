@@ -1,9 +1,12 @@
 #ifndef TYSON_TOKEN_H__
 #define TYSON_TOKEN_H__
 #include <string>
-#include <optional>
-#include <cmath>
+#include <string_view>
+#include <variant>
 
+// A token does not own its text, it is a view into the buffer of the Lexer
+// that produced it and stays valid as long as that Lexer does. The only
+// exception are string literals with escapes, their unescaped text is owned.
 class Token
 {
 public:
@@ -24,20 +27,27 @@ public:
     lambda,
     END
   };
-  Token(Type type, const std::string& text, size_t line, size_t column,
-        std::optional<double> number = std::nullopt);
+  // Number literals without a dot or an exponent that fit are ints
+  using Numeric = std::variant<std::monostate, int, double>;
+  // offset is where the token starts in the input, the lexer that made it
+  // can turn it into a line and column
+  Token(Type type, std::string_view text, size_t offset, Numeric number = {});
 
   Type type() const { return type_; }
-  size_t line() const { return line_; }
-  size_t column() const { return column_; }
-  double number() const { return number_ ? number_.value() : std::nan("no number"); }
-  const std::string& string() const { return text_; }
+  size_t offset() const { return offset_; }
+  double number() const;
+  bool is_integer() const { return std::holds_alternative<int>(number_); }
+  int integer() const { return std::get<int>(number_); }
+  std::string_view string() const { return owns_text_ ? std::string_view{owned_} : text_; }
+  bool owns_text() const { return owns_text_; }
+  void set_owned(std::string text);
 private:
   Type type_;
-  std::string text_;
-  std::optional<double> number_;
-  size_t line_;
-  size_t column_;
+  std::string_view text_;
+  std::string owned_;
+  bool owns_text_;
+  Numeric number_;
+  size_t offset_;
 };
 
 #endif // TYSON_TOKEN_H__
@@ -0,0 +1,68 @@
+#ifndef TYSON_TOKEN_BUFFER_H__
+#define TYSON_TOKEN_BUFFER_H__
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "lexer/source.h"
+#include "lexer/token.h"
+#include "lexer/line_index.h"
+
+class ThreadPool;
+
+// All the tokens of an input, lexed in one pass and kept column by column:
+// a type byte, a 32 bit offset and length into the text and a 32 bit index
+// into the side tables for number values and unescaped strings. Walking it
+// is plain indexing, any token can be looked at in O(1) and no token costs
+// a heap allocation. The last token is always END.
+class TokenBuffer
+{
+public:
+  TokenBuffer(std::string text);
+  // A source that is not stable is read to its end before lexing
+  TokenBuffer(std::unique_ptr<Source> source);
+  // Lexes chunks of about chunk bytes on the pool, the tokens are the same
+  // as the serial lexer's
+  TokenBuffer(std::unique_ptr<Source> source, ThreadPool& pool, size_t chunk = parallel_chunk);
+
+  static constexpr size_t parallel_chunk{256 * 1024};
+
+  size_t size() const { return tokens_.types.size(); }
+  Token::Type type(size_t index) const { return static_cast<Token::Type>(tokens_.types[index]); }
+  size_t offset(size_t index) const { return tokens_.offsets[index]; }
+  std::string_view text(size_t index) const;
+  // The token at index, anything past the end is END
+  Token token(size_t index) const;
+  Position position(size_t index) const { return lines_.position(offset(index)); }
+  Position position(const Token& token) const { return lines_.position(token.offset()); }
+  // The whole input the tokens point into
+  std::string_view source() const { return text_; }
+private:
+  struct Columns
+  {
+    void reserve(size_t count);
+    void add(const Token& token);
+    // Appends the tokens [from, to) of other
+    void append(const Columns& other, size_t from, size_t to);
+
+    std::vector<uint8_t> types;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> lengths;
+    std::vector<uint32_t> extra;
+    std::vector<Token::Numeric> numbers;
+    std::vector<std::string> strings;
+  };
+
+  void load();
+  void tokenize();
+  void tokenize(ThreadPool& pool, size_t chunk);
+
+  std::unique_ptr<Source> source_;
+  std::string_view text_;
+  Columns tokens_;
+  LineIndex lines_;
+};
+
+#endif // TYSON_TOKEN_BUFFER_H__
@@ -1,9 +1,12 @@
 #ifndef TYSON_ENV_H__
 #define TYSON_ENV_H__
 #include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 #include "lisp/frame.h"
 #include "lisp/runtime_types.h"
+#include "lisp/scope.h"
 
 class Env
 {
@@ -14,6 +17,7 @@ public:
   Value lookup(AtomTable::Atom symbol);
   bool error() const { return had_error_; }
   void define(const std::string& name, Value val);
+  void define(AtomTable::Atom id, Value val);
   void set(const std::string& name, Value val);
   void set(AtomTable::Atom id, Value val);
   void add_frame(std::shared_ptr<Frame> frame);
@@ -22,9 +26,35 @@ public:
   AtomTable::Atom intern(const std::string& symbol);
   const std::string& get_name(AtomTable::Atom id);
   std::shared_ptr<Frame> get_frame() { return current_; }
+  // Resolved code reads globals by slot, the slot of a global is its atom.
+  // global() is nullptr for one that is not bound.
+  Value* global(AtomTable::Atom id) { return global_->global(id); }
+  void define_global(AtomTable::Atom id, Value val) { global_->define(id, std::move(val)); }
+  // false if the global is not bound
+  bool set_global(AtomTable::Atom id, Value val) { return global_->set(id, std::move(val)); }
+  // Changes with every define and set of the global, see Frame::version()
+  uint32_t version(AtomTable::Atom id) const { return global_->version(id); }
+  // The scope of the resolved code that runs, nullptr at the top level
+  const std::shared_ptr<Scope>& scope() const { return scope_; }
+  void set_scope(std::shared_ptr<Scope> scope) { scope_ = std::move(scope); }
+  // A call in tail position of a lambda is left here rather than made, the
+  // Procedure the lambda was called through makes it once the lambda has
+  // returned. A loop written as recursion in tail position so runs in
+  // constant stack, whichever lambdas it goes through.
+  void set_tail_call(Procedure callee, std::vector<Value> args);
+  bool has_tail_call() const { return tail_call_.has_value(); }
+  TailCall take_tail_call();
+  // True when the tail call left is of body itself, with the parameters
+  // it takes, and nothing but the caller holds scope: the call is taken,
+  // its arguments go in the first slots of scope and the others are
+  // cleared, for body to run again in it.
+  bool rerun(const Body& body, const std::shared_ptr<Scope>& scope, size_t parameters);
 private:
   AtomTable symbols_{};
   std::shared_ptr<Frame> current_;
+  std::shared_ptr<Frame> global_;
+  std::shared_ptr<Scope> scope_;
+  std::optional<TailCall> tail_call_;
   bool had_error_;
   void load_primitives();
 };
@@ -37,4 +67,15 @@ public:
 private:
   Env& env_;
 };
+
+// Runs resolved code in another scope until it goes out of scope
+class EnteredScope
+{
+public:
+  EnteredScope(Env& env, std::shared_ptr<Scope> scope);
+  ~EnteredScope();
+private:
+  Env& env_;
+  std::shared_ptr<Scope> outer_;
+};
 #endif // TYSON_ENV_H__
@@ -3,18 +3,29 @@
 #include "lisp/atom_table.h"
 #include "lisp/runtime_types.h"
 #include "lisp/value.h"
+#include <cstdint>
 #include <variant>
 #include <unordered_map>
 #include <memory>
+#include <vector>
 
 class Frame
 {
 public:
   Frame(AtomTable& symbols, std::shared_ptr<Frame> parent, bool is_global = false);
   void define(const std::string& name, Value v);
+  void define(AtomTable::Atom id, Value v);
   bool set(AtomTable::Atom id, Value val);
   Value lookup(const std::string& name, bool& ret) const;
   Value lookup(AtomTable::Atom id, bool& ret) const;
+  // The value of a global, nullptr if it is not bound. Only for the global frame.
+  Value* global(AtomTable::Atom id)
+  {
+    return version(id) != 0 ? &globals_[id] : nullptr;
+  }
+  // Counts the defines and sets of a global, 0 while it is not bound. Code
+  // that assumes what a global holds checks it is still the same version.
+  uint32_t version(AtomTable::Atom id) const { return id < versions_.size() ? versions_[id] : 0; }
   AtomTable& symbols() { return symbols_; }
   std::shared_ptr<Frame> parent();
   void set_parent(std::shared_ptr<Frame> parent) { parent_ = parent; }
@@ -23,6 +34,10 @@ private:
   std::shared_ptr<Frame> parent_;
   bool is_global_;
   std::unordered_map<AtomTable::Atom, Value> bindings_;
+  // The global frame keeps its values by atom, an atom is the global slot
+  // of its name
+  std::vector<Value> globals_;
+  std::vector<uint32_t> versions_;
   static Nil nil_;
 };
 
@@ -0,0 +1,36 @@
+#ifndef TYSON_READER_H__
+#define TYSON_READER_H__
+#include "lexer/lexer.h"
+#include "lisp/env.h"
+#include "lisp/value.h"
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Reads S-expression data straight from the tokens into values, with no AST
+// in between. Lists become List, numbers, strings and symbols their own
+// values, () and nil are Nil and true and false Boolean. 'x reads as
+// (quote x). Symbols are interned in the atom table of env.
+class Reader
+{
+public:
+  Reader(std::string text, Env& env);
+  // Reads the source as it goes, like the lexer does
+  Reader(std::unique_ptr<Source> source, Env& env);
+  // The next datum, nothing at the end of the input
+  std::optional<Value> next();
+  // Every datum left, in a list, Nil if there are none
+  Value all();
+private:
+  [[noreturn]] void error(const std::string& message, size_t offset) const;
+  Value symbol(std::string_view name);
+
+  Lexer lexer_;
+  Env& env_;
+  AtomTable::Atom quote_;
+  // items of the lists being read, kept from one datum to the next
+  std::vector<Value> items_;
+};
+
+#endif // TYSON_READER_H__
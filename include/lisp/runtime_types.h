@@ -56,6 +56,7 @@ public:
   Number& operator=(double value);
   Number& operator=(int value);
   bool is_int() const { return std::holds_alternative<int>(value_); }
+  // Throws on a double, which need not fit an int
   int as_int() const;
   double as_double() const;
   virtual bool is_true() const override { return true; }
@@ -96,8 +97,11 @@ private:
 class List : public Object
 {
 public:
+  List() = default;
+  List(std::vector<Value> values);
   virtual std::ostream& output(std::ostream& out) const override;
   void push_back(Value& val);
+  void push_back(Value&& val);
   Value& operator[](size_t index);
   std::vector<Value>::iterator begin() { return values_.begin(); }
   std::vector<Value>::iterator end() { return values_.end(); }
@@ -118,6 +122,7 @@ public:
   Primitive(const std::string& name, Function f) : name_{name}, function_{f} {}
   virtual std::ostream& output(std::ostream& out) const override;
   void set_name(const std::string& name);
+  const std::string& name() const { return name_; }
   Value operator()(std::span<Value> args);
   void set_function(Function func);
   virtual bool is_true() const override { return true; }
@@ -154,6 +159,39 @@ private:
   std::shared_ptr<Frame> frame_;
 };
 
+// What a Procedure runs, made by whichever engine compiled the lambda. It
+// holds the code and the scope the lambda closed over.
+class Body
+{
+public:
+  virtual ~Body() = default;
+  virtual Value call(std::span<Value> args, std::unique_ptr<Env>& env) = 0;
+};
+
+// A lambda of a resolved program, its body is compiled rather than kept
+// as quoted statements like a Lambda's
+class Procedure : public Object
+{
+public:
+  Procedure(std::shared_ptr<Body> body) : body_{std::move(body)} {}
+  virtual std::ostream& output(std::ostream& out) const override;
+  virtual bool is_true() const override { return true; }
+  virtual Value execute(std::unique_ptr<Env>& env) override;
+  // Calls the body, then the tail calls it leaves one after the other,
+  // see Env::set_tail_call()
+  Value operator()(std::span<Value> args, std::unique_ptr<Env>& env);
+  Body& body() const { return *body_; }
+private:
+  std::shared_ptr<Body> body_;
+};
+
+// A call a lambda makes as the last thing it does
+struct TailCall
+{
+  Procedure callee;
+  std::vector<Value> args;
+};
+
 class Quote : public Object
 {
 public:
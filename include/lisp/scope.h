@@ -0,0 +1,33 @@
+#ifndef TYSON_SCOPE_H__
+#define TYSON_SCOPE_H__
+#include "lisp/value.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// The frame of a resolved lambda call or let. Its names were turned into
+// slot numbers ahead of time, so a value is found by walking up a known
+// number of scopes and indexing, no hashing involved.
+class Scope
+{
+public:
+  Scope(std::shared_ptr<Scope> parent, size_t size) : parent_{std::move(parent)}, slots_(size) {}
+  Value& slot(size_t index) { return slots_[index]; }
+  size_t size() const { return slots_.size(); }
+  // The scope depth levels out, this one for 0
+  Scope* up(size_t depth)
+  {
+    Scope* scope{this};
+    for (; depth > 0; --depth)
+    {
+      scope = scope->parent_.get();
+    }
+    return scope;
+  }
+  const std::shared_ptr<Scope>& parent() const { return parent_; }
+private:
+  std::shared_ptr<Scope> parent_;
+  std::vector<Value> slots_;
+};
+
+#endif // TYSON_SCOPE_H__
@@ -6,7 +6,7 @@ class Env;
 class Value
 {
 public:
-  using Variant = std::variant<Nil, Boolean, Number, String, Symbol, List, Primitive, Lambda, Closure, Quote>;
+  using Variant = std::variant<Nil, Boolean, Number, String, Symbol, List, Primitive, Lambda, Closure, Quote, Procedure>;
   Value(Nil nil);
   Value(Boolean boolean);
   Value(Number number);
@@ -17,6 +17,7 @@ public:
   Value(Lambda lambda);
   Value(Closure closure);
   Value(Quote quote);
+  Value(Procedure procedure);
   Value() {}
   Variant get_variant() const { return value_; }
 
@@ -32,6 +33,7 @@ public:
   bool is_lambda() const { return std::holds_alternative<Lambda>(value_); }
   bool is_closure() const { return std::holds_alternative<Closure>(value_); }
   bool is_quote() const { return std::holds_alternative<Quote>(value_); }
+  bool is_procedure() const { return std::holds_alternative<Procedure>(value_); }
 
   Nil& as_nil() { return std::get<Nil>(value_); }
   Boolean& as_boolean() { return std::get<Boolean>(value_); }
@@ -43,6 +45,7 @@ public:
   Lambda& as_lambda() { return std::get<Lambda>(value_); }
   Closure& as_closure() { return std::get<Closure>(value_); }
   Quote& as_quote() { return std::get<Quote>(value_); }
+  Procedure& as_procedure() { return std::get<Procedure>(value_); }
 
   Value execute(std::unique_ptr<Env>& env);
 private:
@@ -2,22 +2,72 @@
 #define TYSON_PARSER_H__
 #include <string>
 #include "lexer/lexer.h"
+#include "lexer/token_buffer.h"
 #include "ast/ast.h"
 #include <memory>
 #include <vector>
+#include <optional>
+
+class ThreadPool;
 
 class Parser
 {
 public:
   Parser(std::string src);
-  Parser(Lexer& lexer);
+  // Reads the source as it goes, so inputs of any size take constant memory
+  Parser(std::unique_ptr<Source> source);
+  // Takes over the lexer, parsing continues from where it stopped
+  Parser(Lexer&& lexer);
+  // Walk tokens that were all lexed up front
+  Parser(std::shared_ptr<const TokenBuffer> tokens);
+  // All the forms left, under one ASTStart
   std::unique_ptr<AST> parse();
+  // The same, with the top-level forms parsed side by side on the pool.
+  // Only a parser over a token buffer can split its input, any other parses
+  // in order.
+  std::unique_ptr<AST> parse(ThreadPool& pool);
+  // The next top-level form, nullptr at the end of the input
+  std::unique_ptr<AST> next_form();
+  // Where the next form starts, or the end of the input if there is none
+  size_t next_offset();
+  // Just past the last token of the last form, for a parser reading from a
+  // lexer and not yet asked for next_offset(). Over a token buffer it is
+  // where the next token starts.
+  size_t offset() const;
+  // Line and column of an offset the parser has read up to
+  Position position(size_t offset) const;
 private:
-  Token token() { return lexer_.token(); }
-  void push_back(Token token) { lexer_.push_back(token); }
-  Lexer lexer_;
+  // Parses the tokens [begin, end) of the buffer
+  Parser(std::shared_ptr<const TokenBuffer> tokens, size_t begin, size_t end);
+  // Where each top-level form from position_ on starts, and the end
+  std::vector<size_t> form_starts() const;
+
+  // A node that still takes children
+  struct Open
+  {
+    AST* node;
+    size_t offset;
+    // made by a ' and done after one child
+    bool quote_char;
+  };
+
+  Token token();
+  void push_back(Token token);
+  [[noreturn]] void error(const std::string& message, size_t offset);
+  // Each returns the top-level form when it is the one that completes it
+  std::unique_ptr<AST> open_list(Token open);
+  void open(std::unique_ptr<AST> node, size_t offset, bool quote_char = false);
+  std::unique_ptr<AST> add(std::unique_ptr<AST> node);
+  std::unique_ptr<AST> close();
 
-  void parse_form(std::vector<AST*>& stack);
+  std::optional<Lexer> lexer_;
+  std::shared_ptr<const TokenBuffer> tokens_;
+  size_t position_;
+  size_t end_;
+  // the form being built and the path to where the next node goes, kept
+  // on the heap so nesting depth does not use the C++ stack
+  std::unique_ptr<AST> pending_;
+  std::vector<Open> open_;
 };
 
 #endif // TYSON_PARSER_H__
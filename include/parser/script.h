@@ -0,0 +1,69 @@
+#ifndef TYSON_SCRIPT_H__
+#define TYSON_SCRIPT_H__
+#include "ast/ast.h"
+#include "lisp/env.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// A script kept parsed form by form, to be reloaded as it is edited. A load
+// only lexes and parses the text between the first and the last change,
+// the forms around it keep their ASTs, and so do the forms in it whose text
+// hashes the same as before. A run evaluates the forms whose text changed
+// and the forms that use a top-level define that was evaluated again.
+class Script
+{
+public:
+  struct Stats
+  {
+    // forms in the script
+    size_t forms;
+    // forms parsed again, the edited ones and their neighbours
+    size_t parsed;
+    // forms with new text, they are evaluated on the next run
+    size_t changed;
+    // chars lexed
+    size_t lexed;
+  };
+
+  // Takes the whole new text of the script. On a syntax error it throws and
+  // the script stays as it was.
+  Stats load(std::string text);
+  // Evaluates what changed since the last run, in script order, and returns
+  // how many forms it evaluated. Every run has to be given the same env.
+  size_t run(std::unique_ptr<Env>& env);
+
+  size_t size() const { return forms_.size(); }
+  const AST& form(size_t index) const { return *forms_[index].ast; }
+  // Where the form is in the current text. A form kept from an earlier load
+  // has the offsets of the text it was parsed from in its nodes.
+  size_t start(size_t index) const { return forms_[index].start; }
+  const std::string& text() const { return text_; }
+private:
+  struct Form
+  {
+    size_t start;
+    // just past its last token
+    size_t end;
+    uint64_t hash;
+    std::unique_ptr<AST> ast;
+    // the name a (define name value) gives a value, empty for other forms
+    std::string defines;
+    // every symbol in the form, sorted
+    std::vector<std::string> uses;
+    // new text that has not been evaluated yet
+    bool pending;
+  };
+  static Form make_form(std::unique_ptr<AST> ast, std::string_view text, size_t start, size_t end);
+
+  std::string text_;
+  std::vector<Form> forms_;
+  // defines removed or evaluated again since the last complete run
+  std::unordered_set<std::string> changed_;
+};
+
+#endif // TYSON_SCRIPT_H__
@@ -0,0 +1,105 @@
+#ifndef TYSON_SYNTAX_TREE_H__
+#define TYSON_SYNTAX_TREE_H__
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include "ast/ast.h"
+#include "lexer/token_buffer.h"
+#include "util/arena.h"
+
+// A whole parse in one arena. Nodes are 16 bytes of plain data: the
+// children of a node sit next to each other in the arena and the node
+// keeps where they start and how many there are, text is an offset into
+// the source and numbers are kept inline. Freeing the tree is freeing the
+// arena. The same forms as Parser makes, to_ast() turns them into those.
+//
+// A tree can be saved to a .tyc file and mapped back in as is, without the
+// source. Its symbols are then indices into an atom table, and the text of
+// lists and special forms is their plain spelling.
+class SyntaxTree
+{
+public:
+  struct Node
+  {
+    enum Flags : uint8_t
+    {
+      // numbers
+      integer = 1,
+      // strings with escapes, their text is in the arena
+      unescaped = 2,
+      // a quote made by ' rather than (quote ...)
+      quote_char = 4,
+      // in a saved tree, data is the index of the text in the atom table
+      atom = 8,
+    };
+
+    AST::Type type;
+    uint8_t flags;
+    // the length of the token of lists, special forms and quotes
+    uint16_t length;
+    uint32_t offset;
+    // where the children start in the arena, an int, the arena offset of a
+    // double or unescaped text, or where a string's text starts
+    uint32_t data;
+    // the number of children, or the length of the text of atoms
+    uint32_t size;
+  };
+
+  SyntaxTree(std::string text);
+  SyntaxTree(std::shared_ptr<const TokenBuffer> tokens);
+
+  // The tree of the file at path, read from its cache_path() when that was
+  // saved from the same contents, and saved there otherwise
+  static SyntaxTree load_file(const std::string& path, bool cache = true);
+  // Where the tree of the file at path is cached, under $XDG_CACHE_HOME/tyson
+  // or ~/.cache/tyson, or empty when there is neither
+  static std::string cache_path(const std::string& path);
+  // A tree saved from a source with this hash, or nothing when the file is
+  // missing, stale or not a tree
+  static std::optional<SyntaxTree> load(const std::string& path, uint64_t hash);
+  void save(const std::string& path) const;
+  // What load() checks the source against
+  static uint64_t hash(std::string_view source);
+
+  std::span<const Node> forms() const { return children(forms_); }
+  std::span<const Node> children(const Node& node) const;
+  std::string_view text(const Node& node) const;
+  Token::Numeric number(const Node& node) const;
+  Position position(const Node& node) const { return position(node.offset); }
+  Position position(size_t offset) const;
+
+  std::unique_ptr<AST> to_ast(const Node& node) const;
+  // All forms under one ASTStart, as Parser::parse() gives them
+  std::unique_ptr<AST> to_ast() const;
+
+  size_t nodes() const { return nodes_; }
+  // Bytes of the arena in use
+  size_t bytes() const { return arena_.size(); }
+  bool cached() const { return image_ != nullptr; }
+private:
+  SyntaxTree() = default;
+  void parse();
+  template <typename T>
+  const T* at(uint32_t offset) const { return reinterpret_cast<const T*>(base_ + offset); }
+
+  std::shared_ptr<const TokenBuffer> tokens_;
+  Arena arena_;
+  // a list of all the top-level forms
+  Node forms_{AST::Type::start, 0, 0, 0, 0, 0};
+  size_t nodes_{0};
+
+  // where the nodes are, the arena or a mapped file, and where their text is
+  const std::byte* base_{nullptr};
+  std::string_view text_;
+  // only for a tree loaded from a file: the mapping, offset and length of
+  // each atom and the offsets of the newlines of the source
+  std::shared_ptr<const std::byte> image_;
+  const uint32_t* atoms_{nullptr};
+  std::span<const uint32_t> newlines_;
+};
+
+#endif // TYSON_SYNTAX_TREE_H__
@@ -0,0 +1,48 @@
+#ifndef TYSON_ARENA_H__
+#define TYSON_ARENA_H__
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+// A bump allocator over one buffer. Allocations are offsets into the
+// buffer rather than pointers, so they stay valid when it grows, and there
+// is nothing to free one by one: the whole arena goes at once. Only plain
+// data can live in it, growing moves it with memcpy.
+class Arena
+{
+public:
+  using Offset = uint32_t;
+
+  explicit Arena(size_t capacity = 0);
+  Arena(Arena&&) = default;
+  Arena& operator=(Arena&&) = default;
+
+  Offset allocate(size_t size, size_t align);
+  template <typename T>
+  Offset allocate(size_t count)
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return allocate(sizeof(T) * count, alignof(T));
+  }
+  template <typename T>
+  T* at(Offset offset) { return reinterpret_cast<T*>(data_.get() + offset); }
+  template <typename T>
+  const T* at(Offset offset) const { return reinterpret_cast<const T*>(data_.get() + offset); }
+
+  void reserve(size_t capacity);
+  // Gives back what was reserved but not used
+  void shrink_to_fit();
+  // Bytes handed out
+  size_t size() const { return used_; }
+  size_t capacity() const { return capacity_; }
+  void clear() { used_ = 0; }
+private:
+  void resize(size_t capacity);
+
+  std::unique_ptr<std::byte[]> data_;
+  size_t used_{0};
+  size_t capacity_{0};
+};
+
+#endif // TYSON_ARENA_H__
@@ -0,0 +1,10 @@
+#ifndef TYSON_HASH_H__
+#define TYSON_HASH_H__
+#include <cstdint>
+#include <string_view>
+
+// A fast 64 bit hash of a run of bytes, eight at a time. Good for telling
+// inputs apart, not for anything that needs to resist an attacker.
+uint64_t hash_bytes(std::string_view data, uint64_t seed = 0);
+
+#endif // TYSON_HASH_H__
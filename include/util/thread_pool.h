@@ -0,0 +1,47 @@
+#ifndef TYSON_THREAD_POOL_H__
+#define TYSON_THREAD_POOL_H__
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// A fixed set of worker threads for splitting one job into many parts.
+// run() hands out the parts, works on them from the calling thread too and
+// returns once all are done. A pool of size 1 has no workers and runs
+// everything on the caller.
+class ThreadPool
+{
+public:
+  explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t size() const { return workers_.size() + 1; }
+  // Calls task(i) for every i in [0, count), the first exception thrown by
+  // a task is rethrown here
+  void run(size_t count, const std::function<void(size_t)>& task);
+private:
+  void work();
+  void drain();
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  // the job being run, a new one bumps the generation
+  const std::function<void(size_t)>* task_{nullptr};
+  size_t count_{0};
+  size_t next_{0};
+  size_t finished_{0};
+  size_t generation_{0};
+  size_t busy_{0};
+  std::exception_ptr error_;
+  bool stop_{false};
+};
+
+#endif // TYSON_THREAD_POOL_H__
@@ -0,0 +1,621 @@
+#include "aot/translator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <stdexcept>
+#include <utility>
+#include <unistd.h>
+
+#ifndef TYSON_AOT_COMPILER
+#define TYSON_AOT_COMPILER "c++"
+#endif
+#ifndef TYSON_AOT_INCLUDE
+#define TYSON_AOT_INCLUDE "include"
+#endif
+#ifndef TYSON_AOT_LIBRARIES
+#define TYSON_AOT_LIBRARIES ""
+#endif
+
+namespace
+{
+const char* builtins[][2]{
+  {"+", "add"}, {"-", "sub"}, {"*", "mul"}, {"<", "lt"}, {">", "gt"}, {"=", "eq"}};
+
+// The aot::Builtin a name is bound to at first, nullptr for none
+const char* builtin(const std::string& name)
+{
+  for (const auto& [symbol, op] : builtins)
+  {
+    if (name == symbol)
+    {
+      return op;
+    }
+  }
+  return nullptr;
+}
+
+// Nodes that run no code of their own, reading them has no effect
+bool is_simple(const AST& node)
+{
+  return dynamic_cast<const ASTConstant*>(&node) || dynamic_cast<const ASTLocal*>(&node) ||
+    dynamic_cast<const ASTGlobal*>(&node);
+}
+
+// Temporaries are named v0, v1... nothing else expression() returns starts
+// with a v, so only they are moved from
+std::string take(const std::string& expression)
+{
+  return expression.starts_with("v") ? "std::move(" + expression + ")" : expression;
+}
+
+std::string string_literal(const std::string& text)
+{
+  std::ostringstream out;
+  out << '"';
+  for (unsigned char c : text)
+  {
+    if (c == '"' || c == '\\')
+    {
+      out << '\\' << c;
+    }
+    else if (c < 0x20 || c >= 0x7f)
+    {
+      out << '\\' << std::oct << std::setw(3) << std::setfill('0') << static_cast<int>(c) << std::dec;
+    }
+    else
+    {
+      out << c;
+    }
+  }
+  out << '"';
+  return out.str();
+}
+
+std::string quoted(const std::string& path)
+{
+  std::string ret{"'"};
+  for (char c : path)
+  {
+    ret += c == '\'' ? std::string{"'\\''"} : std::string{c};
+  }
+  return ret + "'";
+}
+
+// The items of a list like $PATH, an empty one is kept
+std::vector<std::string> split(const std::string& list)
+{
+  std::vector<std::string> ret;
+  for (size_t start{0}; start <= list.size();)
+  {
+    size_t end{std::min(list.find(':', start), list.size())};
+    ret.push_back(list.substr(start, end - start));
+    start = end + 1;
+  }
+  return ret;
+}
+
+void visit(const AST& node, const std::function<void(const AST&)>& f)
+{
+  f(node);
+  std::vector<const AST*> children;
+  node.append_children(children);
+  for (const auto* child : children)
+  {
+    visit(*child, f);
+  }
+}
+}
+
+void Translator::Out::line(const std::string& text)
+{
+  code << std::string(indent * 2, ' ') << text << "\n";
+}
+
+Translator::Translator(std::unique_ptr<Env>& env) : env_{env}
+{
+}
+
+std::string Translator::prelude()
+{
+  return "// Generated by tyson-aot\n"
+         "#include \"aot/runtime.h\"\n"
+         "#include <iostream>\n"
+         "#include <limits>\n";
+}
+
+std::string Translator::main(const std::vector<std::string>& names)
+{
+  std::ostringstream out;
+  out << "\nint main()\n{\n  int status{0};\n";
+  for (const auto& name : names)
+  {
+    out << "  {\n"
+        << "    std::unique_ptr<Env> env{std::make_unique<Env>()};\n"
+        << "    try\n    {\n"
+        << "      std::cout << " << name << "::run(env) << std::endl;\n"
+        << "    }\n"
+        << "    catch (const std::runtime_error& err)\n    {\n"
+        << "      std::cerr << \"error: \" << err.what() << std::endl;\n"
+        << "      status = 1;\n"
+        << "    }\n"
+        << "  }\n";
+  }
+  out << "  return status;\n}\n";
+  return out.str();
+}
+
+std::string Translator::entry(const std::string& name)
+{
+  return "\nValue tyson_run(std::unique_ptr<Env>& env)\n{\n  return " + name + "::run(env);\n}\n";
+}
+
+void Translator::find_directs(const AST& program)
+{
+  std::map<AtomTable::Atom, size_t> defines;
+  std::set<AtomTable::Atom> sets;
+  visit(program, [&](const AST& node) {
+    if (auto* define{dynamic_cast<const ASTDefineGlobal*>(&node)})
+    {
+      ++defines[define->name()];
+      changed_.insert(define->name());
+      if (define->version() && !versions_.contains(define->version().get()))
+      {
+        size_t index{versions_.size()};
+        versions_.emplace(define->version().get(), index);
+        declarations_ << "uint32_t version_" << index << "{0};\n";
+      }
+    }
+    else if (auto* set{dynamic_cast<const ASTSetGlobal*>(&node)})
+    {
+      sets.insert(set->name());
+      changed_.insert(set->name());
+    }
+  });
+  std::vector<const AST*> forms;
+  program.append_children(forms);
+  for (const auto* form : forms)
+  {
+    auto* define{dynamic_cast<const ASTDefineGlobal*>(form)};
+    if (define == nullptr || defines[define->name()] != 1 || sets.contains(define->name()))
+    {
+      continue;
+    }
+    if (auto* lambda{dynamic_cast<const ASTProcedure*>(&define->value())})
+    {
+      directs_.emplace(define->name(), Direct{directs_.size(), lambda});
+    }
+  }
+}
+
+std::string Translator::translate(const AST& program, const std::string& name)
+{
+  find_directs(program);
+  for (const auto& [global, direct] : directs_)
+  {
+    size_t parameters{direct.lambda->code()->parameters};
+    std::string function{"global_" + std::to_string(direct.index)};
+    std::string arguments;
+    std::string values;
+    for (size_t i{0}; i < parameters; ++i)
+    {
+      arguments += ", Value a" + std::to_string(i);
+      values += std::string{i == 0 ? "" : ", "} + "std::move(a" + std::to_string(i) + ")";
+    }
+    declarations_ << "bool defined_" << direct.index << "{false};\n"
+                  << "Value " << function << "(std::unique_ptr<Env>& env" << arguments << ");\n";
+    size_t lambda_index{lambda(*direct.lambda)};
+    functions_ << "// " << env_->get_name(global) << "\n"
+               << "Value " << function << "(std::unique_ptr<Env>& env" << arguments << ")\n{\n"
+               << "  if (!defined_" << direct.index << ")\n  {\n"
+               << "    throw std::runtime_error(" << string_literal("Could not find symbol " + env_->get_name(global))
+               << ");\n  }\n"
+               << "  std::array<Value, " << parameters << "> args{" << values << "};\n"
+               << "  return aot::finish(lambda_" << lambda_index << "(aot::enter(nullptr, "
+               << direct.lambda->code()->size << ", " << parameters << ", args), env), env);\n}\n\n";
+  }
+
+  Out run{{}, 1};
+  run.line("std::shared_ptr<Scope> scope;");
+  std::string result{expression(program, run)};
+  run.line("return " + take(result) + ";");
+
+  std::ostringstream out;
+  out << "\nnamespace " << name << "\n{\n";
+  for (const auto& [atom, index] : atoms_)
+  {
+    out << "AtomTable::Atom atom_" << index << ";\n";
+  }
+  for (size_t i{0}; i < constants_.size(); ++i)
+  {
+    out << "Value constant_" << i << ";\n";
+  }
+  out << declarations_.str() << "\n" << functions_.str();
+  out << "Value run(std::unique_ptr<Env>& env)\n{\n";
+  for (const auto& [atom, index] : atoms_)
+  {
+    out << "  atom_" << index << " = env->intern(" << string_literal(env_->get_name(atom)) << ");\n";
+  }
+  for (size_t i{0}; i < constants_.size(); ++i)
+  {
+    out << "  constant_" << i << " = " << constants_[i] << ";\n";
+  }
+  for (const auto& [global, direct] : directs_)
+  {
+    out << "  defined_" << direct.index << " = false;\n";
+  }
+  out << run.code.str() << "}\n}\n";
+  return out.str();
+}
+
+std::string Translator::temporary(const std::string& value, Out& out)
+{
+  std::string name{"v" + std::to_string(temporaries_++)};
+  out.line("Value " + name + "{" + value + "};");
+  return name;
+}
+
+std::string Translator::atom(AtomTable::Atom name)
+{
+  auto found{atoms_.find(name)};
+  if (found == atoms_.end())
+  {
+    found = atoms_.emplace(name, atoms_.size()).first;
+  }
+  return "atom_" + std::to_string(found->second);
+}
+
+std::string Translator::constant(const Value& value)
+{
+  constants_.push_back(value_code(value));
+  return "constant_" + std::to_string(constants_.size() - 1);
+}
+
+std::string Translator::value_code(Value value)
+{
+  if (value.is_nil())
+  {
+    return "Value{Nil{}}";
+  }
+  if (value.is_boolean())
+  {
+    return value.is_true() ? "Value{Boolean{true}}" : "Value{Boolean{false}}";
+  }
+  if (value.is_number())
+  {
+    Number& number{value.as_number()};
+    if (number.is_int())
+    {
+      return "Value{Number{static_cast<int>(" + std::to_string(number.as_int()) + "LL)}}";
+    }
+    double d{number.as_double()};
+    if (std::isnan(d))
+    {
+      return "Value{Number{std::numeric_limits<double>::quiet_NaN()}}";
+    }
+    if (std::isinf(d))
+    {
+      return d > 0 ? "Value{Number{std::numeric_limits<double>::infinity()}}"
+                   : "Value{Number{-std::numeric_limits<double>::infinity()}}";
+    }
+    std::ostringstream out;
+    out << std::hexfloat << d;
+    return "Value{Number{" + out.str() + "}}";
+  }
+  if (value.is_string())
+  {
+    return "Value{String{" + string_literal(value.as_string().value()) + "}}";
+  }
+  if (value.is_symbol())
+  {
+    Symbol& symbol{value.as_symbol()};
+    return "Value{Symbol{" + atom(symbol.id()) + ", " + string_literal(symbol.value()) + "}}";
+  }
+  if (value.is_list())
+  {
+    std::string ret{"Value{List{std::vector<Value>{"};
+    bool first{true};
+    for (auto& element : value.as_list())
+    {
+      ret += (first ? "" : ", ") + value_code(element);
+      first = false;
+    }
+    return ret + "}}}";
+  }
+  std::ostringstream out;
+  out << value;
+  throw std::runtime_error("Cannot translate the constant " + out.str());
+}
+
+std::string Translator::expression(const AST& node, Out& out)
+{
+  if (auto* value{dynamic_cast<const ASTConstant*>(&node)})
+  {
+    return constant(value->value());
+  }
+  if (auto* local{dynamic_cast<const ASTLocal*>(&node)})
+  {
+    std::string index{std::to_string(local->index())};
+    return local->depth() == 0 ? "scope->slot(" + index + ")"
+                               : "scope->up(" + std::to_string(local->depth()) + ")->slot(" + index + ")";
+  }
+  if (auto* global{dynamic_cast<const ASTGlobal*>(&node)})
+  {
+    return "aot::global(env, " + atom(global->name()) + ")";
+  }
+  if (auto* node_call{dynamic_cast<const ASTCall*>(&node)})
+  {
+    return call(*node_call, out);
+  }
+  if (auto* define{dynamic_cast<const ASTDefineGlobal*>(&node)})
+  {
+    std::string value{temporary(take(expression(define->value(), out)), out)};
+    out.line("env->define_global(" + atom(define->name()) + ", " + value + ");");
+    if (define->version())
+    {
+      out.line("version_" + std::to_string(versions_.at(define->version().get())) + " = env->version(" +
+               atom(define->name()) + ");");
+    }
+    auto direct{directs_.find(define->name())};
+    if (direct != directs_.end())
+    {
+      out.line("defined_" + std::to_string(direct->second.index) + " = true;");
+    }
+    return value;
+  }
+  if (auto* set{dynamic_cast<const ASTSetGlobal*>(&node)})
+  {
+    std::string value{temporary(take(expression(set->value(), out)), out)};
+    out.line("aot::set_global(env, " + atom(set->name()) + ", " + value + ");");
+    return value;
+  }
+  if (auto* set{dynamic_cast<const ASTSetLocal*>(&node)})
+  {
+    std::string value{temporary(take(expression(set->value(), out)), out)};
+    out.line("scope->up(" + std::to_string(set->depth()) + ")->slot(" + std::to_string(set->index()) + ") = " +
+             value + ";");
+    return value;
+  }
+  if (auto* block{dynamic_cast<const ASTBlock*>(&node)})
+  {
+    if (block->statements().empty())
+    {
+      return "Value{Nil{}}";
+    }
+    for (size_t i{0}; i + 1 < block->statements().size(); ++i)
+    {
+      const AST& statement{*block->statements()[i]};
+      std::string value{expression(statement, out)};
+      // a global that is not bound is an error even when nothing uses it
+      if (dynamic_cast<const ASTGlobal*>(&statement))
+      {
+        out.line(value + ";");
+      }
+    }
+    return expression(*block->statements().back(), out);
+  }
+  if (auto* let{dynamic_cast<const ASTScope*>(&node)})
+  {
+    std::vector<std::string> values;
+    for (const auto& value : let->values())
+    {
+      values.push_back(temporary(take(expression(*value, out)), out));
+    }
+    std::string scope{"v" + std::to_string(temporaries_++)};
+    out.line("auto " + scope + "{std::make_shared<Scope>(scope, " + std::to_string(let->size()) + ")};");
+    for (size_t i{0}; i < values.size(); ++i)
+    {
+      out.line(scope + "->slot(" + std::to_string(i) + ") = std::move(" + values[i] + ");");
+    }
+    std::string result{temporary("", out)};
+    out.line("{");
+    ++out.indent;
+    out.line("const std::shared_ptr<Scope>& scope{" + scope + "};");
+    out.line(result + " = " + take(expression(let->body(), out)) + ";");
+    --out.indent;
+    out.line("}");
+    return result;
+  }
+  if (auto* procedure{dynamic_cast<const ASTProcedure*>(&node)})
+  {
+    std::string index{std::to_string(lambda(*procedure))};
+    return temporary("Procedure{std::make_shared<lambda_" + index + "_body>(scope)}", out);
+  }
+  if (auto* guard{dynamic_cast<const ASTGuard*>(&node)})
+  {
+    std::string test;
+    for (const auto& [name, version] : guard->guards())
+    {
+      // the version a define leaves is only known once it ran
+      auto defined{versions_.find(version.get())};
+      std::string held{defined == versions_.end() ? std::to_string(*version) + "u"
+                                                  : "version_" + std::to_string(defined->second)};
+      test += std::string{test.empty() ? "" : " && "} +
+        (defined == versions_.end() ? "" : held + " != 0 && ") + "env->version(" + atom(name) + ") == " + held;
+    }
+    std::string result{temporary("", out)};
+    out.line("if (" + (test.empty() ? std::string{"true"} : test) + ")");
+    const AST* parts[]{&guard->fast(), &guard->slow()};
+    for (size_t i{0}; i < 2; ++i)
+    {
+      out.line("{");
+      ++out.indent;
+      out.line(result + " = " + take(expression(*parts[i], out)) + ";");
+      --out.indent;
+      out.line("}");
+      if (i == 0)
+      {
+        out.line("else");
+      }
+    }
+    return result;
+  }
+  if (node.type() == AST::Type::if_t)
+  {
+    std::vector<const AST*> parts;
+    node.append_children(parts);
+    std::string test{expression(*parts[0], out)};
+    std::string result{temporary("", out)};
+    out.line("if (" + test + ".is_true())");
+    for (size_t i{1}; i < 3; ++i)
+    {
+      out.line("{");
+      ++out.indent;
+      out.line(result + " = " + (i < parts.size() ? take(expression(*parts[i], out)) : "Value{Nil{}}") + ";");
+      --out.indent;
+      out.line("}");
+      if (i == 1)
+      {
+        out.line("else");
+      }
+    }
+    return result;
+  }
+  throw std::runtime_error("Cannot translate a " + node.str() + " that was not resolved");
+}
+
+std::string Translator::call(const ASTCall& call, Out& out)
+{
+  auto* global{dynamic_cast<const ASTGlobal*>(&call.callee())};
+  std::vector<const AST*> operands;
+  auto direct{global ? directs_.find(global->name()) : directs_.end()};
+  // a tail call goes through the global, for its caller to make
+  bool is_direct{!call.tail() && direct != directs_.end() &&
+                 direct->second.lambda->code()->parameters == call.arguments().size()};
+  const char* op{global && !changed_.contains(global->name()) && call.arguments().size() == 2 ?
+    builtin(global->str()) : nullptr};
+  // a generic call reads its callee before the arguments
+  if (!is_direct && op == nullptr)
+  {
+    operands.push_back(&call.callee());
+  }
+  for (const auto& argument : call.arguments())
+  {
+    operands.push_back(argument.get());
+  }
+  std::vector<std::string> values;
+  for (size_t i{0}; i < operands.size(); ++i)
+  {
+    std::string value{expression(*operands[i], out)};
+    bool effects_after{false};
+    for (size_t j{i + 1}; j < operands.size(); ++j)
+    {
+      effects_after = effects_after || !is_simple(*operands[j]);
+    }
+    if (!value.starts_with("v") && !dynamic_cast<const ASTConstant*>(operands[i]) && effects_after)
+    {
+      value = temporary(value, out);
+    }
+    values.push_back(value);
+  }
+
+  if (is_direct)
+  {
+    std::string arguments;
+    for (const auto& value : values)
+    {
+      arguments += ", " + take(value);
+    }
+    return temporary("global_" + std::to_string(direct->second.index) + "(env" + arguments + ")", out);
+  }
+  if (op != nullptr)
+  {
+    return temporary(std::string{"aot::builtin<aot::Builtin::"} + op + ">(" + take(values[0]) + ", " + take(values[1]) + ", " +
+                     atom(global->name()) + ", env)", out);
+  }
+  std::string callee{values.front().starts_with("v") ? values.front() : temporary(values.front(), out)};
+  std::string arguments;
+  for (size_t i{1}; i < values.size(); ++i)
+  {
+    arguments += std::string{i == 1 ? "" : ", "} + take(values[i]);
+  }
+  std::string args{"v" + std::to_string(temporaries_++)};
+  out.line("std::array<Value, " + std::to_string(values.size() - 1) + "> " + args + "{" + arguments + "};");
+  return temporary(std::string{call.tail() ? "aot::tail_call(" : "aot::call("} + callee + ", " + args + ", env)", out);
+}
+
+size_t Translator::lambda(const ASTProcedure& lambda)
+{
+  auto found{lambdas_.find(&lambda)};
+  if (found != lambdas_.end())
+  {
+    return found->second;
+  }
+  size_t index{lambdas_.size()};
+  lambdas_[&lambda] = index;
+  std::string name{"lambda_" + std::to_string(index)};
+  Out body{{}, 1};
+  std::string result{expression(*lambda.code()->body, body)};
+  body.line("return " + take(result) + ";");
+  declarations_ << "Value " << name << "(const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env);\n";
+  functions_ << "Value " << name << "(const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env)\n{\n"
+             << body.code.str() << "}\n\n"
+             << "class " << name << "_body final : public Body\n{\n"
+             << "public:\n"
+             << "  " << name << "_body(std::shared_ptr<Scope> scope) : scope_{std::move(scope)} {}\n"
+             << "  virtual Value call(std::span<Value> args, std::unique_ptr<Env>& env) override\n  {\n"
+             << "    return " << name << "(aot::enter(scope_, " << lambda.code()->size << ", "
+             << lambda.code()->parameters << ", args), env);\n  }\n"
+             << "private:\n  std::shared_ptr<Scope> scope_;\n};\n\n";
+  return index;
+}
+
+Toolchain::Toolchain()
+    : compiler_{TYSON_AOT_COMPILER}, flags_{"-O2"}, include_{TYSON_AOT_INCLUDE}, libraries_{TYSON_AOT_LIBRARIES}
+{
+  if (const char* cxx{std::getenv("CXX")})
+  {
+    compiler_ = cxx;
+  }
+  if (const char* include{std::getenv("TYSON_AOT_INCLUDE")})
+  {
+    include_ = include;
+  }
+  if (const char* libraries{std::getenv("TYSON_AOT_LIBRARIES")})
+  {
+    libraries_ = libraries;
+  }
+}
+
+bool Toolchain::available() const
+{
+  std::string program{compiler_.substr(0, compiler_.find(' '))};
+  if (program.find('/') != std::string::npos)
+  {
+    return ::access(program.c_str(), X_OK) == 0;
+  }
+  const char* path{std::getenv("PATH")};
+  for (const auto& directory : split(path != nullptr ? path : ""))
+  {
+    if (::access(((directory.empty() ? "." : directory) + "/" + program).c_str(), X_OK) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Toolchain::build(const std::string& source, const std::string& output, bool shared) const
+{
+  std::string command{compiler_ + " -std=c++2b " + flags_ + " -I" + quoted(include_)};
+  if (shared)
+  {
+    command += " -fPIC -shared " + quoted(source) + " -o " + quoted(output);
+  }
+  else
+  {
+    command += " " + quoted(source) + " -o " + quoted(output);
+    for (const auto& library : split(libraries_))
+    {
+      if (!library.empty())
+      {
+        command += " " + quoted(library);
+      }
+    }
+    command += " -pthread";
+  }
+  if (std::system(command.c_str()) != 0)
+  {
+    throw std::runtime_error("Could not build " + output + ": " + command);
+  }
+}
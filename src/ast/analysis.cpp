@@ -0,0 +1,163 @@
+#include "ast/analysis.h"
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+// Takes the children out of a node that is about to be replaced
+std::vector<std::unique_ptr<AST>> take_children(AST& node)
+{
+  std::vector<std::unique_ptr<AST>> children;
+  node.replace_children([&](std::unique_ptr<AST> child) {
+    children.push_back(std::move(child));
+    return std::unique_ptr<AST>{};
+  });
+  return children;
+}
+
+size_t count_children(const AST& node)
+{
+  std::vector<const AST*> children;
+  node.append_children(children);
+  return children.size();
+}
+
+// An empty list is parsed as nil
+bool is_list(const AST& node)
+{
+  return node.type() == AST::Type::list || node.type() == AST::Type::nil;
+}
+}
+
+Analysis::Analysis(std::unique_ptr<Env>& env, std::function<Position(size_t)> locate) :
+  env_{env}, locate_{std::move(locate)}
+{
+}
+
+void Analysis::error(const std::string& message, const AST& node) const
+{
+  Position at{locate_(node.offset())};
+  throw std::runtime_error(message + " at line " + std::to_string(at.line) +
+    ", column " + std::to_string(at.column));
+}
+
+std::unique_ptr<AST> Analysis::lower(std::unique_ptr<AST> ast)
+{
+  switch (ast->type())
+  {
+  case AST::Type::quote:
+    // what is quoted is data, only the quote itself is checked
+    if (count_children(*ast) != 1)
+    {
+      error("quote takes one form", *ast);
+    }
+    return ast;
+  case AST::Type::if_t:
+    if (count_children(*ast) != 3)
+    {
+      error("if takes a test, a then and an else form", *ast);
+    }
+    lower_children(*ast);
+    return ast;
+  case AST::Type::define:
+    return lower_define(std::move(ast));
+  case AST::Type::set:
+    return lower_set(std::move(ast));
+  case AST::Type::let:
+    return lower_let(std::move(ast));
+  case AST::Type::lambda:
+    return lower_lambda(std::move(ast));
+  default:
+    lower_children(*ast);
+    return ast;
+  }
+}
+
+void Analysis::lower_children(AST& node)
+{
+  node.replace_children([this](std::unique_ptr<AST> child) { return lower(std::move(child)); });
+}
+
+std::unique_ptr<AST> Analysis::lower_define(std::unique_ptr<AST> define)
+{
+  auto children{take_children(*define)};
+  if (children.size() != 2 || children[0]->type() != AST::Type::symbol)
+  {
+    error("define takes a name and a value", *define);
+  }
+  AtomTable::Atom name{env_->intern(children[0]->as_string())};
+  return std::make_unique<ASTLoweredDefine>(*define, name, std::move(children[0]), lower(std::move(children[1])));
+}
+
+std::unique_ptr<AST> Analysis::lower_set(std::unique_ptr<AST> set)
+{
+  auto children{take_children(*set)};
+  if (children.size() != 2 || children[0]->type() != AST::Type::symbol)
+  {
+    error("set takes a name and a value", *set);
+  }
+  AtomTable::Atom name{env_->intern(children[0]->as_string())};
+  return std::make_unique<ASTLoweredSet>(*set, name, std::move(children[0]), lower(std::move(children[1])));
+}
+
+std::unique_ptr<AST> Analysis::lower_let(std::unique_ptr<AST> let)
+{
+  auto children{take_children(*let)};
+  if (children.empty() || !is_list(*children[0]))
+  {
+    error("let takes a list of bindings", *let);
+  }
+  std::vector<AtomTable::Atom> names;
+  std::vector<std::unique_ptr<AST>> values;
+  for (auto& binding : take_children(*children[0]))
+  {
+    auto pair{take_children(*binding)};
+    if (binding->type() != AST::Type::list || pair.size() != 2 || pair[0]->type() != AST::Type::symbol)
+    {
+      error("a let binding is a name and a value", *binding);
+    }
+    names.push_back(env_->intern(pair[0]->as_string()));
+    values.push_back(lower(std::move(pair[1])));
+  }
+
+  std::vector<std::unique_ptr<AST>> statements;
+  for (size_t i{1}; i < children.size(); ++i)
+  {
+    statements.push_back(lower(std::move(children[i])));
+  }
+  return std::make_unique<ASTLoweredLet>(*let, std::move(names), std::move(values), std::move(statements));
+}
+
+std::unique_ptr<AST> Analysis::lower_lambda(std::unique_ptr<AST> lambda)
+{
+  auto children{take_children(*lambda)};
+  if (children.empty() || !is_list(*children[0]))
+  {
+    error("lambda takes a list of parameters", *lambda);
+  }
+  std::vector<const AST*> parameters;
+  children[0]->append_children(parameters);
+  std::vector<AtomTable::Atom> names;
+  for (const AST* parameter : parameters)
+  {
+    if (parameter->type() != AST::Type::symbol)
+    {
+      error("a lambda parameter is a name", *parameter);
+    }
+    names.push_back(env_->intern(parameter->as_string()));
+  }
+
+  // The body runs as quoted data, as ASTLambda::eval makes it, only now it
+  // is made once
+  std::unique_ptr<AST> bindings{std::move(children[0])};
+  std::vector<std::unique_ptr<AST>> statements;
+  Lambda prototype;
+  for (size_t i{1}; i < children.size(); ++i)
+  {
+    statements.push_back(lower(std::move(children[i])));
+    prototype.add_statement(statements.back()->quote(env_));
+  }
+  prototype.add_arg(bindings->type() == AST::Type::nil ? Value{List{}} : bindings->quote(env_));
+  return std::make_unique<ASTLoweredLambda>(*lambda, std::move(prototype), std::move(bindings), std::move(names),
+                                            std::move(statements));
+}
@@ -1,12 +1,13 @@
 #include "ast/ast.h"
 #include "lexer/token.h"
+#include "lexer/keywords.h"
 #include <stdexcept>
 #include <algorithm>
 #include "lisp/runtime_types.h"
 #include <iostream>
 
 AST::AST(Token& token) :
-  line_{token.line()}, column_{token.column()}, type_{Type::unknown}, print_value_{token.string()}
+  offset_{token.offset()}, type_{Type::unknown}, print_value_{token.string()}
 {
 }
 
@@ -62,34 +63,62 @@ std::ostream& AST::output(std::ostream& out) const
 
 void ASTStart::add_child(std::unique_ptr<AST> child)
 {
-  root_ = std::move(child);
+  forms_.push_back(std::move(child));
+}
+
+void ASTStart::append_children(std::vector<const AST*>& out) const
+{
+  for (const auto& form : forms_)
+  {
+    out.push_back(form.get());
+  }
+}
+
+void ASTStart::replace_children(const Replace& replace)
+{
+  for (auto& child : forms_)
+  {
+    child = replace(std::move(child));
+  }
 }
 
 Value ASTStart::eval(std::unique_ptr<Env>& env)
 {
-  return root_->eval(env);
+  if (forms_.empty())
+  {
+    return Value{Nil{}};
+  }
+  for (size_t i{0}; i + 1 < forms_.size(); ++i)
+  {
+    forms_[i]->eval(env).execute(env);
+  }
+  return forms_.back()->eval(env);
 }
 
 Value ASTStart::quote(std::unique_ptr<Env>& env)
 {
-  return root_->quote(env);
+  if (forms_.empty())
+  {
+    return Value{Nil{}};
+  }
+  return forms_.back()->quote(env);
 }
 
 ASTNumber::ASTNumber(Token& token) :
-  AST{token}, value_{token.number()}
+  AST{token}, value_{token.is_integer() ? Number{token.integer()} : Number{token.number()}}
 {
   type_ = AST::Type::number;
 }
 
 std::ostream& ASTNumber::output(std::ostream& out) const
 {
-  AST::output(out) << std::endl << value();
+  AST::output(out) << std::endl << value_;
   return out;
 }
 
 Value ASTNumber::eval(std::unique_ptr<Env>& env)
 {
-  return Value{Number{value_}};
+  return Value{value_};
 }
 
 ASTString::ASTString(Token& token) :
@@ -113,9 +142,7 @@ ASTBool::ASTBool(Token& token) :
   AST{token}, value_{true}
 {
   type_ = AST::Type::boolean;
-  std::string lc{token.string()};
-  std::transform(lc.begin(), lc.end(), lc.begin(), [](char c){return std::tolower(c);});
-  if (lc == "false")
+  if (classify_keyword(token.string(), true) == Keyword::false_t)
   {
     value_ = false;
   }
@@ -138,7 +165,7 @@ ASTList::ASTList(Token& token) :
   type_ = AST::Type::list;
   if (token.type() != Token::Type::open)
   {
-    throw std::runtime_error("Looking for '(', found" + token.string());
+    throw std::runtime_error("Looking for '(', found" + std::string{token.string()});
   }
 }
 
@@ -156,6 +183,22 @@ void ASTList::add_child(std::unique_ptr<AST> child)
   value_.push_back(std::move(child));
 }
 
+void ASTList::append_children(std::vector<const AST*>& out) const
+{
+  for (const auto& child : value_)
+  {
+    out.push_back(child.get());
+  }
+}
+
+void ASTList::replace_children(const Replace& replace)
+{
+  for (auto& child : value_)
+  {
+    child = replace(std::move(child));
+  }
+}
+
 Value ASTList::eval(std::unique_ptr<Env>& env)
 {
   List l;
@@ -213,11 +256,6 @@ ASTNil::ASTNil(Token& token) :
   AST{token}, value_{token.string()}
 {
   type_ = AST::Type::nil;
-  std::string lc{value_};
-  std::transform(lc.begin(), lc.end(), lc.begin(), [](char c){return std::tolower(c);});
-  if (lc != "nil")
-  {
-  }
 }
 
 Value ASTNil::eval(std::unique_ptr<Env>& env)
@@ -236,6 +274,22 @@ void ASTQuote::add_child(std::unique_ptr<AST> child)
   value_ = std::move(child);
 }
 
+void ASTQuote::append_children(std::vector<const AST*>& out) const
+{
+  if (value_)
+  {
+    out.push_back(value_.get());
+  }
+}
+
+void ASTQuote::replace_children(const Replace& replace)
+{
+  if (value_)
+  {
+    value_ = replace(std::move(value_));
+  }
+}
+
 Value ASTQuote::eval(std::unique_ptr<Env>& env)
 {
   Quote ret;
@@ -249,6 +303,12 @@ ASTIf::ASTIf(Token& token) :
   type_ = AST::Type::if_t;
 }
 
+ASTIf::ASTIf(const AST& node) :
+  AST{node}, count_{0}
+{
+  type_ = AST::Type::if_t;
+}
+
 Value ASTIf::eval(std::unique_ptr<Env>& env)
 {
   Value test{test_->eval(env)};
@@ -295,6 +355,28 @@ void ASTIf::add_child(std::unique_ptr<AST> child)
   ++count_;
 }
 
+void ASTIf::append_children(std::vector<const AST*>& out) const
+{
+  for (const auto* child : {&test_, &true_, &else_})
+  {
+    if (*child)
+    {
+      out.push_back(child->get());
+    }
+  }
+}
+
+void ASTIf::replace_children(const Replace& replace)
+{
+  for (auto* child : {&test_, &true_, &else_})
+  {
+    if (*child)
+    {
+      *child = replace(std::move(*child));
+    }
+  }
+}
+
 ASTDefine::ASTDefine(Token& token) :
   AST{token}, count_{0}
 {
@@ -319,6 +401,28 @@ void ASTDefine::add_child(std::unique_ptr<AST> child)
   ++count_;
 }
 
+void ASTDefine::append_children(std::vector<const AST*>& out) const
+{
+  for (const auto* child : {&symbol_, &value_})
+  {
+    if (*child)
+    {
+      out.push_back(child->get());
+    }
+  }
+}
+
+void ASTDefine::replace_children(const Replace& replace)
+{
+  for (auto* child : {&symbol_, &value_})
+  {
+    if (*child)
+    {
+      *child = replace(std::move(*child));
+    }
+  }
+}
+
 Value ASTDefine::eval(std::unique_ptr<Env>& env)
 {
   Value ret = value_->eval(env).execute(env);
@@ -385,6 +489,28 @@ void ASTSet::add_child(std::unique_ptr<AST> child)
   ++count_;
 }
 
+void ASTSet::append_children(std::vector<const AST*>& out) const
+{
+  for (const auto* child : {&symbol_, &value_})
+  {
+    if (*child)
+    {
+      out.push_back(child->get());
+    }
+  }
+}
+
+void ASTSet::replace_children(const Replace& replace)
+{
+  for (auto* child : {&symbol_, &value_})
+  {
+    if (*child)
+    {
+      *child = replace(std::move(*child));
+    }
+  }
+}
+
 ASTLet::ASTLet(Token& token) :
   AST{token}, bindings_{nullptr}
 {
@@ -447,6 +573,30 @@ void ASTLet::add_child(std::unique_ptr<AST> child)
   }
 }
 
+void ASTLet::append_children(std::vector<const AST*>& out) const
+{
+  if (bindings_)
+  {
+    out.push_back(bindings_.get());
+  }
+  for (const auto& statement : statements_)
+  {
+    out.push_back(statement.get());
+  }
+}
+
+void ASTLet::replace_children(const Replace& replace)
+{
+  if (bindings_)
+  {
+    bindings_ = replace(std::move(bindings_));
+  }
+  for (auto& statement : statements_)
+  {
+    statement = replace(std::move(statement));
+  }
+}
+
 ASTLambda::ASTLambda(Token& token) :
   AST{token}, bindings_{nullptr}
 {
@@ -496,6 +646,195 @@ void ASTLambda::add_child(std::unique_ptr<AST> child)
   }
 }
 
+void ASTLambda::append_children(std::vector<const AST*>& out) const
+{
+  if (bindings_)
+  {
+    out.push_back(bindings_.get());
+  }
+  for (const auto& statement : statements_)
+  {
+    out.push_back(statement.get());
+  }
+}
+
+void ASTLambda::replace_children(const Replace& replace)
+{
+  if (bindings_)
+  {
+    bindings_ = replace(std::move(bindings_));
+  }
+  for (auto& statement : statements_)
+  {
+    statement = replace(std::move(statement));
+  }
+}
+
+ASTLoweredDefine::ASTLoweredDefine(const AST& define, AtomTable::Atom name, std::unique_ptr<AST> symbol,
+                                   std::unique_ptr<AST> value) :
+  AST{define}, name_{name}, symbol_{std::move(symbol)}, value_{std::move(value)}
+{
+}
+
+void ASTLoweredDefine::append_children(std::vector<const AST*>& out) const
+{
+  out.push_back(symbol_.get());
+  out.push_back(value_.get());
+}
+
+Value ASTLoweredDefine::eval(std::unique_ptr<Env>& env)
+{
+  Value ret = value_->eval(env).execute(env);
+  env->define(name_, ret);
+  return ret;
+}
+
+Value ASTLoweredDefine::quote(std::unique_ptr<Env>& env)
+{
+  List ret;
+  Value tmp{String{"define"}};
+  ret.push_back(tmp);
+  tmp = symbol_->quote(env);
+  ret.push_back(tmp);
+  tmp = value_->quote(env);
+  ret.push_back(tmp);
+  return Value{ret};
+}
+
+ASTLoweredSet::ASTLoweredSet(const AST& set, AtomTable::Atom name, std::unique_ptr<AST> symbol,
+                             std::unique_ptr<AST> value) :
+  AST{set}, name_{name}, symbol_{std::move(symbol)}, value_{std::move(value)}
+{
+}
+
+void ASTLoweredSet::append_children(std::vector<const AST*>& out) const
+{
+  out.push_back(symbol_.get());
+  out.push_back(value_.get());
+}
+
+Value ASTLoweredSet::eval(std::unique_ptr<Env>& env)
+{
+  Value ret = value_->eval(env);
+  env->set(name_, ret);
+  if (env->error())
+  {
+    throw std::runtime_error("Error trying to set " + symbol_->as_string());
+  }
+  return ret;
+}
+
+Value ASTLoweredSet::quote(std::unique_ptr<Env>& env)
+{
+  List ret;
+  Value tmp{String{"set"}};
+  ret.push_back(tmp);
+  tmp = symbol_->quote(env);
+  ret.push_back(tmp);
+  tmp = value_->quote(env);
+  ret.push_back(tmp);
+  return Value{ret};
+}
+
+ASTLoweredLet::ASTLoweredLet(const AST& let, std::vector<AtomTable::Atom> names,
+                             std::vector<std::unique_ptr<AST>> values, std::vector<std::unique_ptr<AST>> statements) :
+  AST{let}, names_{std::move(names)}, values_{std::move(values)}, statements_{std::move(statements)}
+{
+}
+
+void ASTLoweredLet::append_children(std::vector<const AST*>& out) const
+{
+  for (const auto& value : values_)
+  {
+    out.push_back(value.get());
+  }
+  for (const auto& statement : statements_)
+  {
+    out.push_back(statement.get());
+  }
+}
+
+Value ASTLoweredLet::eval(std::unique_ptr<Env>& env)
+{
+  std::vector<Value> values;
+  values.reserve(values_.size());
+  for (auto& value : values_)
+  {
+    values.push_back(value->eval(env));
+  }
+  env->push();
+  for (size_t i{0}; i < values.size(); ++i)
+  {
+    env->define(names_[i], values[i]);
+  }
+  Value ret;
+  for (auto& ast : statements_)
+  {
+    ret = ast->eval(env);
+  }
+  env->pop();
+  return ret;
+}
+
+Value ASTLoweredLet::quote(std::unique_ptr<Env>& env)
+{
+  List ret;
+  Value tmp{String{"let"}};
+  ret.push_back(tmp);
+  List bindings;
+  for (size_t i{0}; i < names_.size(); ++i)
+  {
+    List binding;
+    binding.push_back(Value{Symbol{names_[i], env->get_name(names_[i])}});
+    binding.push_back(values_[i]->quote(env));
+    bindings.push_back(Value{binding});
+  }
+  ret.push_back(Value{bindings});
+  for (auto& statement : statements_)
+  {
+    tmp = statement->quote(env);
+    ret.push_back(tmp);
+  }
+  return Value{ret};
+}
+
+ASTLoweredLambda::ASTLoweredLambda(const AST& lambda, Lambda prototype, std::unique_ptr<AST> bindings,
+                                   std::vector<AtomTable::Atom> parameters,
+                                   std::vector<std::unique_ptr<AST>> statements) :
+  AST{lambda}, prototype_{std::move(prototype)}, parameters_{std::move(parameters)},
+  bindings_{std::move(bindings)}, statements_{std::move(statements)}
+{
+}
+
+void ASTLoweredLambda::append_children(std::vector<const AST*>& out) const
+{
+  out.push_back(bindings_.get());
+  for (const auto& statement : statements_)
+  {
+    out.push_back(statement.get());
+  }
+}
+
+Value ASTLoweredLambda::eval(std::unique_ptr<Env>& env)
+{
+  return Value{prototype_}.execute(env);
+}
+
+Value ASTLoweredLambda::quote(std::unique_ptr<Env>& env)
+{
+  List ret;
+  Value tmp{String{"lambda"}};
+  ret.push_back(tmp);
+  tmp = bindings_->quote(env);
+  ret.push_back(tmp);
+  for (auto& statement : statements_)
+  {
+    tmp = statement->quote(env);
+    ret.push_back(tmp);
+  }
+  return Value{ret};
+}
+
 std::unique_ptr<AST> AST::factory(Token& token)
 {
   switch (token.type())
@@ -532,50 +871,27 @@ std::unique_ptr<AST> AST::factory(Token& token)
 
 std::unique_ptr<AST> AST::symbol_factory(Token& token)
 {
-  std::string value{token.string()};
-  std::string lc;
-  std::transform(value.begin(), value.end(), lc.begin(), [](char c){return std::tolower(c);});
-
-  if (lc == "true" || lc == "false")
+  switch (classify_keyword(token.string(), true))
   {
+  case Keyword::true_t:
+  case Keyword::false_t:
     return std::make_unique<ASTBool>(token);
-  }
-  
-  if (lc == "set")
-  {
+  case Keyword::set:
     return std::make_unique<ASTSet>(token);
-  }
-
-  if (lc == "define")
-  {
+  case Keyword::define:
     return std::make_unique<ASTDefine>(token);
-  }
-
-  if (lc == "nil")
-  {
+  case Keyword::nil:
     return std::make_unique<ASTNil>(token);
-  }
-
-  if (lc == "quote")
-  {
+  case Keyword::quote:
     return std::make_unique<ASTQuote>(token);
-  }
-
-  if (lc == "if")
-  {
+  case Keyword::if_t:
     return std::make_unique<ASTIf>(token);
-  }
-
-  if (lc == "let")
-  {
+  case Keyword::let:
     return std::make_unique<ASTLet>(token);
-  }
-
-  if (lc == "lambda")
-  {
+  case Keyword::lambda:
     return std::make_unique<ASTLambda>(token);
+  case Keyword::none:
+    break;
   }
-
   return std::make_unique<ASTSymbol>(token);
 }
-
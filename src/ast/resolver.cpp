@@ -0,0 +1,557 @@
+#include "ast/resolver.h"
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+std::vector<std::unique_ptr<AST>> take_children(AST& node)
+{
+  std::vector<std::unique_ptr<AST>> children;
+  node.replace_children([&](std::unique_ptr<AST> child) {
+    children.push_back(std::move(child));
+    return std::unique_ptr<AST>{};
+  });
+  return children;
+}
+}
+
+Resolver::Resolver(std::unique_ptr<Env>& env) : env_{env}
+{
+}
+
+bool Resolver::find(AtomTable::Atom name, Address& address) const
+{
+  for (size_t depth{0}; depth < scopes_.size(); ++depth)
+  {
+    const auto& names{scopes_[scopes_.size() - 1 - depth].names};
+    // the last of two same names is the one in effect
+    for (size_t index{names.size()}; index > 0; --index)
+    {
+      if (names[index - 1] == name)
+      {
+        address = {depth, index - 1};
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+size_t Resolver::declare(AtomTable::Atom name)
+{
+  auto& names{scopes_.back().names};
+  for (size_t index{0}; index < names.size(); ++index)
+  {
+    if (names[index] == name)
+    {
+      return index;
+    }
+  }
+  names.push_back(name);
+  return names.size() - 1;
+}
+
+std::unique_ptr<AST> Resolver::resolve(std::unique_ptr<AST> ast)
+{
+  switch (ast->type())
+  {
+  case AST::Type::number:
+  case AST::Type::string:
+  case AST::Type::boolean:
+  case AST::Type::nil:
+    return std::make_unique<ASTConstant>(*ast, ast->eval(env_));
+  case AST::Type::quote:
+    return std::make_unique<ASTConstant>(*ast, ast->eval(env_).execute(env_));
+  case AST::Type::symbol:
+  {
+    AtomTable::Atom name{env_->intern(ast->as_string())};
+    Address address;
+    if (find(name, address))
+    {
+      return std::make_unique<ASTLocal>(*ast, address.depth, address.index);
+    }
+    return std::make_unique<ASTGlobal>(*ast, name);
+  }
+  case AST::Type::list:
+    return resolve_call(std::move(ast));
+  case AST::Type::start:
+  {
+    auto forms{take_children(*ast)};
+    for (auto& form : forms)
+    {
+      form = resolve(std::move(form));
+    }
+    return std::make_unique<ASTBlock>(*ast, std::move(forms));
+  }
+  case AST::Type::if_t:
+    ast->replace_children([this](std::unique_ptr<AST> child) { return resolve(std::move(child)); });
+    return ast;
+  case AST::Type::define:
+    return resolve_define(std::move(ast));
+  case AST::Type::set:
+    return resolve_set(std::move(ast));
+  case AST::Type::let:
+    return resolve_let(std::move(ast));
+  case AST::Type::lambda:
+    return resolve_lambda(std::move(ast));
+  default:
+    throw std::runtime_error("Cannot resolve a " + ast->str());
+  }
+}
+
+std::unique_ptr<AST> Resolver::resolve_call(std::unique_ptr<AST> list)
+{
+  auto children{take_children(*list)};
+  std::unique_ptr<AST> callee{resolve(std::move(children.front()))};
+  std::vector<std::unique_ptr<AST>> arguments;
+  arguments.reserve(children.size() - 1);
+  for (size_t i{1}; i < children.size(); ++i)
+  {
+    arguments.push_back(resolve(std::move(children[i])));
+  }
+  return std::make_unique<ASTCall>(*list, std::move(callee), std::move(arguments));
+}
+
+std::unique_ptr<AST> Resolver::resolve_define(std::unique_ptr<AST> define)
+{
+  auto* lowered{dynamic_cast<ASTLoweredDefine*>(define.get())};
+  if (lowered == nullptr)
+  {
+    throw std::runtime_error("Only a tree lowered by Analysis can be resolved");
+  }
+  if (scopes_.empty())
+  {
+    return std::make_unique<ASTDefineGlobal>(*define, lowered->name(), resolve(std::move(lowered->value())));
+  }
+  // a define in a body names a slot, the value can already refer to it
+  size_t index{declare(lowered->name())};
+  return std::make_unique<ASTSetLocal>(*define, 0, index, resolve(std::move(lowered->value())));
+}
+
+std::unique_ptr<AST> Resolver::resolve_set(std::unique_ptr<AST> set)
+{
+  auto* lowered{dynamic_cast<ASTLoweredSet*>(set.get())};
+  if (lowered == nullptr)
+  {
+    throw std::runtime_error("Only a tree lowered by Analysis can be resolved");
+  }
+  std::unique_ptr<AST> value{resolve(std::move(lowered->value()))};
+  Address address;
+  if (find(lowered->name(), address))
+  {
+    return std::make_unique<ASTSetLocal>(*set, address.depth, address.index, std::move(value));
+  }
+  return std::make_unique<ASTSetGlobal>(*set, lowered->name(), std::move(value));
+}
+
+std::unique_ptr<AST> Resolver::resolve_body(const AST& node, std::vector<std::unique_ptr<AST>>& statements)
+{
+  for (const auto& statement : statements)
+  {
+    if (auto* define{dynamic_cast<const ASTLoweredDefine*>(statement.get())})
+    {
+      declare(define->name());
+    }
+  }
+  std::vector<std::unique_ptr<AST>> body;
+  body.reserve(statements.size());
+  for (auto& statement : statements)
+  {
+    body.push_back(resolve(std::move(statement)));
+  }
+  return std::make_unique<ASTBlock>(node, std::move(body));
+}
+
+std::unique_ptr<AST> Resolver::resolve_let(std::unique_ptr<AST> let)
+{
+  auto* lowered{dynamic_cast<ASTLoweredLet*>(let.get())};
+  if (lowered == nullptr)
+  {
+    throw std::runtime_error("Only a tree lowered by Analysis can be resolved");
+  }
+  // the values are taken in the scope around the let
+  std::vector<std::unique_ptr<AST>> values;
+  values.reserve(lowered->values().size());
+  for (auto& value : lowered->values())
+  {
+    values.push_back(resolve(std::move(value)));
+  }
+  scopes_.push_back({lowered->names()});
+  std::unique_ptr<AST> body;
+  try
+  {
+    body = resolve_body(*let, lowered->statements());
+  }
+  catch (...)
+  {
+    scopes_.pop_back();
+    throw;
+  }
+  size_t size{scopes_.back().names.size()};
+  scopes_.pop_back();
+  return std::make_unique<ASTScope>(*let, std::move(values), size, std::move(body));
+}
+
+std::unique_ptr<AST> Resolver::resolve_lambda(std::unique_ptr<AST> lambda)
+{
+  auto* lowered{dynamic_cast<ASTLoweredLambda*>(lambda.get())};
+  if (lowered == nullptr)
+  {
+    throw std::runtime_error("Only a tree lowered by Analysis can be resolved");
+  }
+  scopes_.push_back({lowered->parameters()});
+  auto code{std::make_shared<Code>()};
+  code->parameters = lowered->parameters().size();
+  try
+  {
+    code->body = resolve_body(*lambda, lowered->statements());
+  }
+  catch (...)
+  {
+    scopes_.pop_back();
+    throw;
+  }
+  code->size = scopes_.back().names.size();
+  scopes_.pop_back();
+  mark_tail(*code->body);
+  return std::make_unique<ASTProcedure>(*lambda, std::move(code));
+}
+
+void Resolver::mark_tail(AST& node)
+{
+  if (auto* call{dynamic_cast<ASTCall*>(&node)})
+  {
+    call->set_tail(true);
+    return;
+  }
+  // the branches of an if, the last statement of a block, the body of a let
+  std::vector<const AST*> children;
+  node.append_children(children);
+  size_t first{children.size() - 1};
+  if (node.type() == AST::Type::if_t)
+  {
+    first = 1;
+  }
+  else if (!dynamic_cast<ASTBlock*>(&node) && !dynamic_cast<ASTScope*>(&node))
+  {
+    return;
+  }
+  size_t index{0};
+  node.replace_children([&](std::unique_ptr<AST> child) {
+    if (index++ >= first)
+    {
+      mark_tail(*child);
+    }
+    return child;
+  });
+}
+
+ASTConstant::ASTConstant(const AST& node, Value value) :
+  AST{node}, value_{std::move(value)}
+{
+}
+
+ASTLocal::ASTLocal(const AST& symbol, size_t depth, size_t index) :
+  AST{symbol}, depth_{depth}, index_{index}
+{
+}
+
+ASTGlobal::ASTGlobal(const AST& symbol, AtomTable::Atom name) :
+  AST{symbol}, name_{name}
+{
+}
+
+Value ASTGlobal::eval(std::unique_ptr<Env>& env)
+{
+  Value* value{env->global(name_)};
+  if (value == nullptr)
+  {
+    throw std::runtime_error("Could not find symbol " + env->get_name(name_));
+  }
+  return *value;
+}
+
+ASTCall::ASTCall(const AST& list, std::unique_ptr<AST> callee, std::vector<std::unique_ptr<AST>> arguments) :
+  AST{list}, callee_{std::move(callee)}, arguments_{std::move(arguments)}
+{
+}
+
+void ASTCall::append_children(std::vector<const AST*>& out) const
+{
+  out.push_back(callee_.get());
+  for (const auto& argument : arguments_)
+  {
+    out.push_back(argument.get());
+  }
+}
+
+void ASTCall::replace_children(const Replace& replace)
+{
+  callee_ = replace(std::move(callee_));
+  for (auto& argument : arguments_)
+  {
+    argument = replace(std::move(argument));
+  }
+}
+
+Value ASTCall::eval(std::unique_ptr<Env>& env)
+{
+  Value callee{callee_->eval(env)};
+  std::vector<Value> arguments;
+  arguments.reserve(arguments_.size());
+  for (auto& argument : arguments_)
+  {
+    arguments.push_back(argument->eval(env));
+  }
+  if (tail_)
+  {
+    return tail_apply(callee, std::move(arguments), env);
+  }
+  return apply(callee, arguments, env);
+}
+
+Value ASTCall::apply(Value& callee, std::span<Value> arguments, std::unique_ptr<Env>& env)
+{
+  if (callee.is_procedure())
+  {
+    return callee.as_procedure()(arguments, env);
+  }
+  if (callee.is_primitive())
+  {
+    return callee.as_primitive()(arguments);
+  }
+  if (callee.is_closure())
+  {
+    return callee.as_closure()(arguments, env);
+  }
+  std::ostringstream out;
+  out << callee;
+  throw std::runtime_error("Cannot call " + out.str());
+}
+
+Value ASTCall::tail_apply(Value& callee, std::vector<Value> arguments, std::unique_ptr<Env>& env)
+{
+  if (callee.is_procedure())
+  {
+    env->set_tail_call(callee.as_procedure(), std::move(arguments));
+    return Value{Nil{}};
+  }
+  return apply(callee, arguments, env);
+}
+
+ASTDefineGlobal::ASTDefineGlobal(const AST& define, AtomTable::Atom name, std::unique_ptr<AST> value) :
+  AST{define}, name_{name}, value_{std::move(value)}
+{
+}
+
+void ASTDefineGlobal::append_children(std::vector<const AST*>& out) const
+{
+  out.push_back(value_.get());
+}
+
+void ASTDefineGlobal::replace_children(const Replace& replace)
+{
+  value_ = replace(std::move(value_));
+}
+
+Value ASTDefineGlobal::eval(std::unique_ptr<Env>& env)
+{
+  Value ret{value_->eval(env)};
+  env->define_global(name_, ret);
+  if (version_)
+  {
+    *version_ = env->version(name_);
+  }
+  return ret;
+}
+
+ASTSetGlobal::ASTSetGlobal(const AST& set, AtomTable::Atom name, std::unique_ptr<AST> value) :
+  AST{set}, name_{name}, value_{std::move(value)}
+{
+}
+
+void ASTSetGlobal::append_children(std::vector<const AST*>& out) const
+{
+  out.push_back(value_.get());
+}
+
+void ASTSetGlobal::replace_children(const Replace& replace)
+{
+  value_ = replace(std::move(value_));
+}
+
+Value ASTSetGlobal::eval(std::unique_ptr<Env>& env)
+{
+  Value ret{value_->eval(env)};
+  if (!env->set_global(name_, ret))
+  {
+    throw std::runtime_error("Error trying to set " + env->get_name(name_));
+  }
+  return ret;
+}
+
+ASTSetLocal::ASTSetLocal(const AST& set, size_t depth, size_t index, std::unique_ptr<AST> value) :
+  AST{set}, depth_{depth}, index_{index}, value_{std::move(value)}
+{
+}
+
+void ASTSetLocal::append_children(std::vector<const AST*>& out) const
+{
+  out.push_back(value_.get());
+}
+
+void ASTSetLocal::replace_children(const Replace& replace)
+{
+  value_ = replace(std::move(value_));
+}
+
+Value ASTSetLocal::eval(std::unique_ptr<Env>& env)
+{
+  Value ret{value_->eval(env)};
+  env->scope()->up(depth_)->slot(index_) = ret;
+  return ret;
+}
+
+ASTBlock::ASTBlock(const AST& node, std::vector<std::unique_ptr<AST>> statements) :
+  AST{node}, statements_{std::move(statements)}
+{
+}
+
+void ASTBlock::append_children(std::vector<const AST*>& out) const
+{
+  for (const auto& statement : statements_)
+  {
+    out.push_back(statement.get());
+  }
+}
+
+void ASTBlock::replace_children(const Replace& replace)
+{
+  for (auto& statement : statements_)
+  {
+    statement = replace(std::move(statement));
+  }
+}
+
+Value ASTBlock::eval(std::unique_ptr<Env>& env)
+{
+  if (statements_.empty())
+  {
+    return Value{Nil{}};
+  }
+  for (size_t i{0}; i + 1 < statements_.size(); ++i)
+  {
+    statements_[i]->eval(env);
+  }
+  return statements_.back()->eval(env);
+}
+
+ASTScope::ASTScope(const AST& let, std::vector<std::unique_ptr<AST>> values, size_t size,
+                   std::unique_ptr<AST> body) :
+  AST{let}, values_{std::move(values)}, size_{size}, body_{std::move(body)}
+{
+}
+
+void ASTScope::append_children(std::vector<const AST*>& out) const
+{
+  for (const auto& value : values_)
+  {
+    out.push_back(value.get());
+  }
+  out.push_back(body_.get());
+}
+
+void ASTScope::replace_children(const Replace& replace)
+{
+  for (auto& value : values_)
+  {
+    value = replace(std::move(value));
+  }
+  body_ = replace(std::move(body_));
+}
+
+Value ASTScope::eval(std::unique_ptr<Env>& env)
+{
+  auto scope{std::make_shared<Scope>(env->scope(), size_)};
+  for (size_t i{0}; i < values_.size(); ++i)
+  {
+    scope->slot(i) = values_[i]->eval(env);
+  }
+  EnteredScope entered{*env, std::move(scope)};
+  return body_->eval(env);
+}
+
+ASTGuard::ASTGuard(const AST& node, Guards guards, std::unique_ptr<AST> fast, std::unique_ptr<AST> slow) :
+  AST{node}, guards_{std::move(guards)}, fast_{std::move(fast)}, slow_{std::move(slow)}
+{
+}
+
+bool ASTGuard::holds(const Guards& guards, std::unique_ptr<Env>& env)
+{
+  for (const auto& [name, version] : guards)
+  {
+    if (*version == 0 || env->version(name) != *version)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ASTGuard::append_children(std::vector<const AST*>& out) const
+{
+  out.push_back(fast_.get());
+  out.push_back(slow_.get());
+}
+
+void ASTGuard::replace_children(const Replace& replace)
+{
+  fast_ = replace(std::move(fast_));
+  slow_ = replace(std::move(slow_));
+}
+
+Value ASTGuard::eval(std::unique_ptr<Env>& env)
+{
+  return holds(guards_, env) ? fast_->eval(env) : slow_->eval(env);
+}
+
+Value TreeBody::call(std::span<Value> args, std::unique_ptr<Env>& env)
+{
+  if (args.size() != code_->parameters)
+  {
+    throw std::runtime_error("wrong number of arguments passed to lambda");
+  }
+  auto scope{std::make_shared<Scope>(scope_, code_->size)};
+  for (size_t i{0}; i < args.size(); ++i)
+  {
+    scope->slot(i) = std::move(args[i]);
+  }
+  Value ret;
+  do
+  {
+    EnteredScope entered{*env, scope};
+    ret = code_->body->eval(env);
+  } while (env->rerun(*this, scope, code_->parameters));
+  return ret;
+}
+
+ASTProcedure::ASTProcedure(const AST& lambda, std::shared_ptr<Code> code) :
+  AST{lambda}, code_{std::move(code)}
+{
+}
+
+void ASTProcedure::append_children(std::vector<const AST*>& out) const
+{
+  out.push_back(code_->body.get());
+}
+
+void ASTProcedure::replace_children(const Replace& replace)
+{
+  code_->body = replace(std::move(code_->body));
+}
+
+Value ASTProcedure::eval(std::unique_ptr<Env>& env)
+{
+  return Value{Procedure{std::make_shared<TreeBody>(code_, env->scope())}};
+}
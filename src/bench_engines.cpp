@@ -0,0 +1,116 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "engine/engine.h"
+#include "engine/optimizer.h"
+
+// The same programs on every engine: fib and tak for calls and arithmetic,
+// a list built with cons and summed back with car and cdr, a loop written
+// as recursion in tail position, and a loop that calls small helpers.
+// The tail calls are also run a million deep, in one lambda, between two
+// and through a lambda made on every call. They go through the optimizer unless --no-optimize is given.
+// usage: bench_engines [--repeat n] [--no-optimize] [engine...]
+
+namespace
+{
+struct Workload
+{
+  std::string name;
+  std::string setup;
+  std::string run;
+};
+
+const std::vector<Workload> workloads{
+  {"fib",
+   "(define fib (lambda (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))",
+   "(fib 22)"},
+  {"tak",
+   "(define tak (lambda (x y z) (if (< y x) (tak (tak (- x 1) y z) (tak (- y 1) z x) (tak (- z 1) x y)) z)))",
+   "(tak 18 12 6)"},
+  {"list",
+   "(define build (lambda (n acc) (if (= n 0) acc (build (- n 1) (cons n acc)))))"
+   "(define sum (lambda (l acc) (if l (sum (cdr l) (+ acc (car l))) acc)))",
+   "(sum (build 400 (list)) 0)"},
+  {"loop",
+   "(define loop (lambda (n acc) (if (= n 0) acc (loop (- n 1) (+ acc 1)))))",
+   "(loop 20000 0)"},
+  {"helpers",
+   "(define square (lambda (x) (* x x)))"
+   "(define add (lambda (a b) (+ a b)))"
+   "(define zero (lambda (n) (= n 0)))"
+   "(define squares (lambda (n acc) (if (zero n) acc (squares (- n 1) (add acc (square n))))))",
+   "(squares 1000 0)"},
+  {"deep",
+   "(define loop (lambda (n acc) (if (= n 0) acc (loop (- n 1) (+ acc 2)))))",
+   "(loop 1000000 0)"},
+  {"mutual",
+   "(define even (lambda (n) (if (= n 0) true (odd (- n 1)))))"
+   "(define odd (lambda (n) (if (= n 0) false (even (- n 1)))))",
+   "(even 1000001)"},
+  {"through",
+   "(define count (lambda (n) (if (= n 0) 0 ((lambda (m) (count m)) (- n 1)))))",
+   "(count 1000000)"},
+};
+}
+
+int main(int argc, char** argv)
+{
+  size_t repeat{5};
+  bool optimize{true};
+  std::vector<std::string> engines;
+  for (int i{1}; i < argc; ++i)
+  {
+    std::string arg{argv[i]};
+    if (arg == "--repeat" && i + 1 < argc)
+    {
+      repeat = std::strtoul(argv[++i], nullptr, 10);
+    }
+    else if (arg == "--no-optimize")
+    {
+      optimize = false;
+    }
+    else
+    {
+      engines.push_back(arg);
+    }
+  }
+  if (engines.empty())
+  {
+    engines = Engine::names();
+  }
+
+  std::cout << std::left << std::setw(8) << "engine";
+  for (const auto& workload : workloads)
+  {
+    std::cout << std::setw(14) << workload.name + "_ms";
+  }
+  std::cout << std::endl;
+  for (const auto& name : engines)
+  {
+    auto engine{Engine::factory(name)};
+    std::cout << std::setw(8) << name;
+    for (const auto& workload : workloads)
+    {
+      std::unique_ptr<Env> env{std::make_unique<Env>()};
+      Optimizer optimizer{env};
+      compile(workload.setup, *engine, env, optimize ? &optimizer : nullptr)(env);
+      auto program{compile(workload.run, *engine, env, optimize ? &optimizer : nullptr)};
+      // the best of the runs
+      double best{0.0};
+      Value result;
+      for (size_t i{0}; i < repeat; ++i)
+      {
+        auto start{std::chrono::steady_clock::now()};
+        result = program(env);
+        std::chrono::duration<double, std::milli> took{std::chrono::steady_clock::now() - start};
+        best = i == 0 ? took.count() : std::min(best, took.count());
+      }
+      std::cout << std::setw(14) << std::fixed << std::setprecision(1) << best;
+    }
+    std::cout << std::endl;
+  }
+  return 0;
+}
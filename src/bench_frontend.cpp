@@ -0,0 +1,520 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "lexer/keywords.h"
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "parser/syntax_tree.h"
+#include "parser/script.h"
+
+// Lexer and parser throughput on generated corpora, written as JSON. The
+// parser is measured both making AST nodes and making a SyntaxTree, and
+// reloading a library after a one char edit against loading it anew.
+// Keyword classification is timed on its own, against the chain of string
+// compares it replaced.
+//
+// usage: bench_frontend [--scale n] [--min-time seconds] [--save file]
+//                       [--compare file] [--threshold percent]
+//
+// --save writes the results to a baseline file, --compare reads one back and
+// exits with 1 when a corpus got slower, or allocates more, by more than the
+// threshold (10% by default). The startup numbers write a scratch library
+// to the temporary directory and remove it and its .tyc after.
+
+namespace
+{
+std::atomic<size_t> allocations{0};
+std::atomic<size_t> allocated_bytes{0};
+}
+
+void* operator new(std::size_t size)
+{
+  ++allocations;
+  allocated_bytes += size;
+  if (void* p = std::malloc(size ? size : 1))
+  {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+namespace
+{
+// Removes a scratch file when it goes out of scope, a throw included
+struct Scratch
+{
+  std::filesystem::path path;
+  ~Scratch()
+  {
+    std::error_code error;
+    std::filesystem::remove(path, error);
+  }
+};
+
+struct Corpus
+{
+  std::string name;
+  std::string text;
+  size_t forms;
+};
+
+// All corpora are made from a fixed seed so runs can be compared
+class Generator
+{
+public:
+  unsigned next()
+  {
+    state_ = state_ * 1103515245u + 12345u;
+    return state_ >> 8;
+  }
+private:
+  unsigned state_{42};
+};
+
+Corpus deep(size_t scale)
+{
+  Corpus corpus{"deep", "", 0};
+  for (size_t form{0}; form < 4 * scale; ++form)
+  {
+    size_t depth{200};
+    for (size_t i{0}; i < depth; ++i)
+    {
+      corpus.text += "(f ";
+    }
+    corpus.text += "x";
+    corpus.text += std::string(depth, ')');
+    corpus.text += '\n';
+    ++corpus.forms;
+  }
+  return corpus;
+}
+
+Corpus wide(size_t scale)
+{
+  Corpus corpus{"wide", "", 0};
+  for (size_t form{0}; form < scale; ++form)
+  {
+    corpus.text += "(list";
+    for (size_t i{0}; i < 800; ++i)
+    {
+      corpus.text += " item" + std::to_string(i);
+    }
+    corpus.text += ")\n";
+    ++corpus.forms;
+  }
+  return corpus;
+}
+
+Corpus strings(size_t scale)
+{
+  Corpus corpus{"strings", "", 0};
+  Generator random;
+  for (size_t form{0}; form < 40 * scale; ++form)
+  {
+    corpus.text += "(print";
+    for (size_t i{0}; i < 8; ++i)
+    {
+      corpus.text += " \"";
+      size_t length{random.next() % 60};
+      for (size_t c{0}; c < length; ++c)
+      {
+        corpus.text += static_cast<char>('a' + random.next() % 26);
+      }
+      if (random.next() % 4 == 0)
+      {
+        corpus.text += "\\\"quoted\\\"";
+      }
+      corpus.text += '"';
+    }
+    corpus.text += ")\n";
+    ++corpus.forms;
+  }
+  return corpus;
+}
+
+Corpus numbers(size_t scale)
+{
+  Corpus corpus{"numbers", "", 0};
+  Generator random;
+  for (size_t form{0}; form < 40 * scale; ++form)
+  {
+    corpus.text += "(+";
+    for (size_t i{0}; i < 16; ++i)
+    {
+      corpus.text += ' ';
+      switch (random.next() % 3)
+      {
+      case 0:
+        corpus.text += std::to_string(random.next() % 100000);
+        break;
+      case 1:
+        corpus.text += "-" + std::to_string(random.next() % 1000) + "." + std::to_string(random.next() % 1000);
+        break;
+      default:
+        corpus.text += std::to_string(random.next() % 10) + ".5e" + std::to_string(random.next() % 20);
+        break;
+      }
+    }
+    corpus.text += ")\n";
+    ++corpus.forms;
+  }
+  return corpus;
+}
+
+Corpus comments(size_t scale)
+{
+  Corpus corpus{"comments", "", 0};
+  for (size_t form{0}; form < 40 * scale; ++form)
+  {
+    corpus.text += "; a comment line that is about as long as the ones people write\n";
+    corpus.text += "// another one, \"with\" (parens) and quotes in it\n";
+    corpus.text += "# and a third one\n";
+    corpus.text += "(define x" + std::to_string(form) + " nil)\n";
+    ++corpus.forms;
+  }
+  return corpus;
+}
+
+// Symbols as they come in code, one in four a keyword, some differing
+// from one only in case or length
+std::vector<std::string> symbols(size_t scale)
+{
+  static const char* words[]{"define", "lambda", "if", "let", "set", "quote", "nil", "true", "false",
+    "x", "list", "car", "cdr", "cons", "lambdas", "Define", "sets", "item", "counter", "fib", "+", "<="};
+  std::vector<std::string> ret;
+  Generator random;
+  for (size_t i{0}; i < 10000 * scale; ++i)
+  {
+    ret.push_back(random.next() % 4 == 0 ? words[random.next() % 9] : words[9 + random.next() % 13]);
+  }
+  return ret;
+}
+
+// What the lexer did before keywords.h, a string compare per keyword
+Keyword compare_chain(const std::string& text)
+{
+  static const std::pair<std::string, Keyword> chain[]{
+    {"set", Keyword::set}, {"define", Keyword::define}, {"nil", Keyword::nil}, {"if", Keyword::if_t},
+    {"quote", Keyword::quote}, {"let", Keyword::let}, {"lambda", Keyword::lambda},
+    {"true", Keyword::true_t}, {"false", Keyword::false_t}};
+  for (const auto& [name, keyword] : chain)
+  {
+    if (text == name)
+    {
+      return keyword;
+    }
+  }
+  return Keyword::none;
+}
+
+struct Run
+{
+  double seconds;
+  size_t allocations;
+};
+
+// Best time of as many runs as fit in min_time, at least three
+Run measure(const std::function<void()>& work, double min_time)
+{
+  Run best{1e9, 0};
+  double total{0};
+  for (int runs{0}; runs < 3 || total < min_time; ++runs)
+  {
+    size_t before{allocations};
+    auto start{std::chrono::steady_clock::now()};
+    work();
+    std::chrono::duration<double> took{std::chrono::steady_clock::now() - start};
+    best.allocations = allocations - before;
+    best.seconds = std::min(best.seconds, took.count());
+    total += took.count();
+  }
+  return best;
+}
+
+struct Result
+{
+  std::string corpus;
+  std::string metric;
+  double value;
+  // whether a bigger value is better
+  bool higher;
+};
+
+std::string to_json(const std::vector<Corpus>& corpora, const std::vector<Result>& results)
+{
+  std::ostringstream out;
+  out << "{\n  \"results\": [\n";
+  for (size_t i{0}; i < results.size(); ++i)
+  {
+    const Result& result{results[i]};
+    out << "    {\"corpus\": \"" << result.corpus << "\", \"metric\": \"" << result.metric
+      << "\", \"value\": " << result.value << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  out << "  ],\n  \"corpora\": [\n";
+  for (size_t i{0}; i < corpora.size(); ++i)
+  {
+    out << "    {\"name\": \"" << corpora[i].name << "\", \"bytes\": " << corpora[i].text.size()
+      << ", \"forms\": " << corpora[i].forms << "}" << (i + 1 < corpora.size() ? "," : "") << "\n";
+  }
+  out << "  ]\n}\n";
+  return out.str();
+}
+
+// Reads back the results array of a file written by to_json
+std::vector<Result> from_json(std::istream& in)
+{
+  std::vector<Result> results;
+  std::string line;
+  auto field = [&](std::string_view name) {
+    std::string key{"\"" + std::string{name} + "\": "};
+    size_t at{line.find(key)};
+    if (at == std::string::npos)
+    {
+      throw std::runtime_error("bad baseline line: " + line);
+    }
+    at += key.size();
+    if (line[at] == '"')
+    {
+      return line.substr(at + 1, line.find('"', at + 1) - at - 1);
+    }
+    return line.substr(at, line.find_first_of(",}", at) - at);
+  };
+  while (std::getline(in, line))
+  {
+    if (line.find("\"metric\"") == std::string::npos)
+    {
+      continue;
+    }
+    results.push_back({field("corpus"), field("metric"), std::stod(field("value")), true});
+  }
+  return results;
+}
+
+bool compare(const std::vector<Result>& results, const std::vector<Result>& baseline, double threshold)
+{
+  bool ok{true};
+  for (const Result& result : results)
+  {
+    auto old{std::find_if(baseline.begin(), baseline.end(), [&](const Result& r) {
+      return r.corpus == result.corpus && r.metric == result.metric;
+    })};
+    if (old == baseline.end() || old->value == 0)
+    {
+      continue;
+    }
+    double change{(result.value - old->value) / old->value * 100};
+    bool worse{result.higher ? change < -threshold : change > threshold};
+    std::cerr << (worse ? "REGRESSION " : "ok         ") << result.corpus << " " << result.metric
+      << " " << old->value << " -> " << result.value << " (" << (change > 0 ? "+" : "") << change << "%)\n";
+    ok = ok && !worse;
+  }
+  return ok;
+}
+}
+
+int main(int argc, char** argv)
+{
+  size_t scale{20};
+  double min_time{0.2};
+  double threshold{10};
+  std::string save, baseline;
+  for (int i{1}; i < argc; ++i)
+  {
+    std::string arg{argv[i]};
+    if (i + 1 >= argc)
+    {
+      std::cerr << "missing value for " << arg << std::endl;
+      return 2;
+    }
+    std::string value{argv[++i]};
+    if (arg == "--scale")
+    {
+      scale = std::stoul(value);
+    }
+    else if (arg == "--min-time")
+    {
+      min_time = std::stod(value);
+    }
+    else if (arg == "--threshold")
+    {
+      threshold = std::stod(value);
+    }
+    else if (arg == "--save")
+    {
+      save = value;
+    }
+    else if (arg == "--compare")
+    {
+      baseline = value;
+    }
+    else
+    {
+      std::cerr << "unknown option " << arg << std::endl;
+      return 2;
+    }
+  }
+
+  std::vector<Corpus> corpora{deep(scale), wide(scale), strings(scale), numbers(scale), comments(scale)};
+  std::vector<Result> results;
+  for (const Corpus& corpus : corpora)
+  {
+    double mb{corpus.text.size() / 1e6};
+    size_t tokens{0};
+    Run lexed{measure([&] {
+      Lexer lexer{Source::from_view(corpus.text)};
+      tokens = 0;
+      while (lexer.token().type() != Token::Type::END)
+      {
+        ++tokens;
+      }
+    }, min_time)};
+    results.push_back({corpus.name, "lexer_mb_per_s", mb / lexed.seconds, true});
+    results.push_back({corpus.name, "lexer_tokens_per_s", tokens / lexed.seconds, true});
+    results.push_back({corpus.name, "lexer_allocations", static_cast<double>(lexed.allocations), false});
+
+    Run parsed{measure([&] {
+      Parser parser{corpus.text};
+      parser.parse();
+    }, min_time)};
+    results.push_back({corpus.name, "parser_mb_per_s", mb / parsed.seconds, true});
+    results.push_back({corpus.name, "parser_forms_per_s", corpus.forms / parsed.seconds, true});
+    results.push_back({corpus.name, "parser_allocations", static_cast<double>(parsed.allocations), false});
+
+    size_t nodes{0};
+    Run tree{measure([&] {
+      SyntaxTree syntax{corpus.text};
+      nodes = syntax.nodes();
+    }, min_time)};
+    results.push_back({corpus.name, "tree_mb_per_s", mb / tree.seconds, true});
+    results.push_back({corpus.name, "tree_forms_per_s", corpus.forms / tree.seconds, true});
+    results.push_back({corpus.name, "tree_allocations", static_cast<double>(tree.allocations), false});
+
+    // memory of the trees alone, from tokens lexed beforehand
+    auto buffer{std::make_shared<const TokenBuffer>(corpus.text)};
+    size_t before{allocated_bytes};
+    std::unique_ptr<AST> ast{Parser{buffer}.parse()};
+    size_t ast_bytes{allocated_bytes - before};
+    SyntaxTree syntax{buffer};
+    results.push_back({corpus.name, "parser_bytes_per_node", static_cast<double>(ast_bytes) / nodes, false});
+    results.push_back({corpus.name, "tree_bytes_per_node", static_cast<double>(syntax.bytes()) / nodes, false});
+  }
+
+  std::vector<std::string> words{symbols(scale)};
+  size_t keywords{0};
+  Run classified{measure([&] {
+    keywords = 0;
+    for (const auto& word : words)
+    {
+      keywords += classify_keyword(word) != Keyword::none;
+    }
+  }, min_time)};
+  size_t compared{0};
+  Run chained{measure([&] {
+    compared = 0;
+    for (const auto& word : words)
+    {
+      compared += compare_chain(word) != Keyword::none;
+    }
+  }, min_time)};
+  if (keywords != compared)
+  {
+    std::cerr << "keyword classification disagrees with the compare chain" << std::endl;
+    return 1;
+  }
+  results.push_back({"symbols", "keyword_ns_per_symbol", classified.seconds * 1e9 / words.size(), false});
+  results.push_back({"symbols", "compare_chain_ns_per_symbol", chained.seconds * 1e9 / words.size(), false});
+
+  // Startup on a library of all the corpora, cold parses the source and
+  // writes its .tyc, warm maps it back in
+  Scratch source{std::filesystem::temp_directory_path() / "bench_frontend_library.ty"};
+  std::string path{source.path.string()};
+  Scratch tree{SyntaxTree::cache_path(path)};
+  std::string cache{tree.path.string()};
+  std::string library;
+  for (size_t i{0}; i < 4; ++i)
+  {
+    for (const Corpus& corpus : corpora)
+    {
+      library += corpus.text;
+    }
+  }
+  std::ofstream{path} << library;
+  Run cold{measure([&] {
+    std::remove(cache.c_str());
+    SyntaxTree::load_file(path).to_ast();
+  }, min_time)};
+  Run parsed{measure([&] {
+    std::remove(cache.c_str());
+    SyntaxTree::load_file(path);
+  }, min_time)};
+  Run warm{measure([&] {
+    SyntaxTree::load_file(path).to_ast();
+  }, min_time)};
+  Run mapped{measure([&] {
+    SyntaxTree::load_file(path);
+  }, min_time)};
+  results.push_back({"library", "cold_start_ms", cold.seconds * 1000, false});
+  results.push_back({"library", "warm_start_ms", warm.seconds * 1000, false});
+  results.push_back({"library", "cold_tree_ms", parsed.seconds * 1000, false});
+  results.push_back({"library", "warm_tree_ms", mapped.seconds * 1000, false});
+
+  // An edit to one digit in the middle of the library, reloads flip it back
+  // and forth
+  std::string edited{library};
+  size_t digit{edited.find_first_of("0123456789", edited.size() / 2)};
+  edited[digit] = edited[digit] == '1' ? '2' : '1';
+  Script script;
+  script.load(library);
+  bool flip{false};
+  Run reload{measure([&] {
+    flip = !flip;
+    script.load(flip ? edited : library);
+  }, min_time)};
+  Run load{measure([&] {
+    Script{}.load(library);
+  }, min_time)};
+  results.push_back({"library", "script_load_ms", load.seconds * 1000, false});
+  results.push_back({"library", "script_reload_ms", reload.seconds * 1000, false});
+
+  std::string json{to_json(corpora, results)};
+  std::cout << json;
+  if (!save.empty())
+  {
+    std::ofstream{save} << json;
+  }
+  if (!baseline.empty())
+  {
+    std::ifstream in{baseline};
+    if (!in)
+    {
+      std::cerr << "cannot read " << baseline << std::endl;
+      return 2;
+    }
+    if (!compare(results, from_json(in), threshold))
+    {
+      return 1;
+    }
+  }
+}
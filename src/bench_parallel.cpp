@@ -0,0 +1,106 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "lexer/token_buffer.h"
+#include "parser/parser.h"
+#include "util/thread_pool.h"
+
+// Lexing and parsing throughput from 1 to N threads, on a file given as
+// the first argument or on a generated program of 50k top-level forms.
+// usage: bench_parallel [file|-] [max threads]
+
+namespace
+{
+std::string generate(size_t forms)
+{
+  std::string program;
+  for (size_t i{0}; i < forms; ++i)
+  {
+    std::string n{std::to_string(i)};
+    program += "; form " + n + "\n";
+    program += "(define f" + n + " (lambda (x y) (if (< x " + n + ") \"small\n value\" (+ x y 2.5))))\n";
+  }
+  return program;
+}
+
+// 1, 2, 4 ... and then max
+size_t next(size_t threads, size_t max)
+{
+  if (threads < max && threads * 2 > max)
+  {
+    return max;
+  }
+  return threads * 2;
+}
+
+template <typename Work>
+double best_seconds(Work work)
+{
+  double best{1e9};
+  for (int run{0}; run < 5; ++run)
+  {
+    auto start{std::chrono::steady_clock::now()};
+    work();
+    std::chrono::duration<double> took{std::chrono::steady_clock::now() - start};
+    best = std::min(best, took.count());
+  }
+  return best;
+}
+}
+
+int main(int argc, char** argv)
+{
+  std::string text;
+  if (argc > 1 && std::string{argv[1]} != "-")
+  {
+    std::ifstream in{argv[1]};
+    std::stringstream all;
+    all << in.rdbuf();
+    text = all.str();
+  }
+  else
+  {
+    text = generate(50000);
+  }
+  size_t max_threads{std::max(1u, std::thread::hardware_concurrency())};
+  if (argc > 2)
+  {
+    max_threads = std::strtoul(argv[2], nullptr, 10);
+  }
+  double mb{text.size() / 1e6};
+
+  size_t tokens{0};
+  double serial{best_seconds([&] { tokens = TokenBuffer{text}.size(); })};
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << mb << " MB, " << tokens << " tokens" << std::endl;
+  std::cout << "lex serial     " << mb / serial << " MB/s" << std::endl;
+  for (size_t threads{1}; threads <= max_threads; threads = next(threads, max_threads))
+  {
+    ThreadPool pool{threads};
+    double took{best_seconds([&] { TokenBuffer{Source::from_view(text), pool}; })};
+    std::cout << "lex threads " << threads << "  " << mb / took << " MB/s, x"
+      << std::setprecision(2) << serial / took << std::setprecision(1) << std::endl;
+  }
+
+  // parsing alone, from tokens lexed beforehand
+  auto buffer{std::make_shared<const TokenBuffer>(text)};
+  size_t forms{0};
+  serial = best_seconds([&] {
+    auto parsed{Parser{buffer}.parse()};
+    forms = static_cast<ASTStart*>(parsed.get())->size();
+  });
+  std::cout << forms << " forms" << std::endl;
+  std::cout << "parse serial     " << forms / serial / 1000 << " kforms/s" << std::endl;
+  for (size_t threads{1}; threads <= max_threads; threads = next(threads, max_threads))
+  {
+    ThreadPool pool{threads};
+    double took{best_seconds([&] { Parser{buffer}.parse(pool); })};
+    std::cout << "parse threads " << threads << "  " << forms / took / 1000 << " kforms/s, x"
+      << std::setprecision(2) << serial / took << std::setprecision(1) << std::endl;
+  }
+}
@@ -0,0 +1,102 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "lisp/reader.h"
+#include "parser/parser.h"
+
+// Loading an S-expression data file into values, with the reader and the
+// way it was done before it, parsing to an AST and quoting every form.
+// Without a file it writes a generated one of the given size, 100 MB by
+// default, to the temporary directory and removes it after.
+// usage: bench_reader [--mb size] [file]
+
+namespace
+{
+// Removes a scratch file when it goes out of scope, a throw included
+struct Scratch
+{
+  std::filesystem::path path;
+  ~Scratch()
+  {
+    std::error_code error;
+    std::filesystem::remove(path, error);
+  }
+};
+
+void generate(const std::string& path, size_t bytes)
+{
+  std::ofstream out{path};
+  size_t written{0};
+  for (size_t i{0}; written < bytes; ++i)
+  {
+    std::string n{std::to_string(i)};
+    std::string record{"(record " + n + " \"name " + n + "\" (" + n + ".5 -3 2e-1) (tags alpha beta) nil)\n"};
+    out << record;
+    written += record.size();
+  }
+}
+
+template <typename Work>
+double seconds(Work work)
+{
+  auto start{std::chrono::steady_clock::now()};
+  work();
+  std::chrono::duration<double> took{std::chrono::steady_clock::now() - start};
+  return took.count();
+}
+}
+
+int main(int argc, char** argv)
+{
+  size_t mb{100};
+  std::string path;
+  for (int i{1}; i < argc; ++i)
+  {
+    std::string arg{argv[i]};
+    if (arg == "--mb" && i + 1 < argc)
+    {
+      mb = std::strtoul(argv[++i], nullptr, 10);
+    }
+    else
+    {
+      path = arg;
+    }
+  }
+  Scratch generated;
+  if (path.empty())
+  {
+    generated.path = std::filesystem::temp_directory_path() / "bench_reader_data.txt";
+    path = generated.path.string();
+    generate(path, mb * 1024 * 1024);
+  }
+  double size{static_cast<double>(std::ifstream{path, std::ios::ate}.tellg()) / (1024 * 1024)};
+
+  size_t forms{0};
+  // the values are freed after the clock stops, one set at a time
+  List by_quote;
+  Value by_reader;
+  double quoted{seconds([&] {
+    std::unique_ptr<Env> env{std::make_unique<Env>()};
+    Parser parser{Source::from_file(path)};
+    while (auto form{parser.next_form()})
+    {
+      by_quote.push_back(form->quote(env));
+    }
+  })};
+  by_quote = List{};
+  double read{seconds([&] {
+    Env env;
+    by_reader = Reader{Source::from_file(path), env}.all();
+    forms = by_reader.is_list() ? by_reader.as_list().size() : 0;
+  })};
+
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << size << " MB, " << forms << " forms" << std::endl;
+  std::cout << "read   " << read * 1000 << " ms, " << size / read << " MB/s" << std::endl;
+  std::cout << "quote  " << quoted * 1000 << " ms, " << size / quoted << " MB/s" << std::endl;
+  std::cout << "x" << quoted / read << std::endl;
+}
@@ -0,0 +1,90 @@
+#include "engine/builtin.h"
+#include <utility>
+
+Builtin builtin(const std::string& name)
+{
+  static const std::pair<const char*, Builtin> builtins[]{
+    {"+", Builtin::add}, {"-", Builtin::sub}, {"*", Builtin::mul},
+    {"<", Builtin::lt}, {">", Builtin::gt}, {"=", Builtin::eq}};
+  for (const auto& [symbol, op] : builtins)
+  {
+    if (name == symbol)
+    {
+      return op;
+    }
+  }
+  return Builtin::none;
+}
+
+// Whether value is still that primitive, by the name it was made with
+bool is_builtin(Value& value, Builtin op)
+{
+  static const char* names[]{"ADD", "SUB", "NUL", "LT", "GT", "EQ"};
+  return value.is_primitive() && value.as_primitive().name() == names[static_cast<int>(op)];
+}
+
+bool is_comparison(Builtin op)
+{
+  return op == Builtin::lt || op == Builtin::gt || op == Builtin::eq;
+}
+
+bool comparison(Builtin op, Number& a, Number& b)
+{
+  if (a.is_int() && b.is_int())
+  {
+    int x{a.as_int()};
+    int y{b.as_int()};
+    return op == Builtin::lt ? x < y : op == Builtin::gt ? x > y : x == y;
+  }
+  double x{a.as_double()};
+  double y{b.as_double()};
+  return op == Builtin::lt ? x < y : op == Builtin::gt ? x > y : x == y;
+}
+
+Value arithmetic(Builtin op, Number& a, Number& b)
+{
+  if (is_comparison(op))
+  {
+    return Value{Boolean{comparison(op, a, b)}};
+  }
+  if (a.is_int() && b.is_int())
+  {
+    int x{a.as_int()};
+    int y{b.as_int()};
+    int r;
+    switch (op)
+    {
+    case Builtin::add:
+      if (!__builtin_add_overflow(x, y, &r))
+      {
+        return Value{Number{r}};
+      }
+      break;
+    case Builtin::sub:
+      if (!__builtin_sub_overflow(x, y, &r))
+      {
+        return Value{Number{r}};
+      }
+      break;
+    case Builtin::mul:
+      if (!__builtin_mul_overflow(x, y, &r))
+      {
+        return Value{Number{r}};
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  double x{a.as_double()};
+  double y{b.as_double()};
+  switch (op)
+  {
+  case Builtin::add:
+    return Value{Number{x + y}};
+  case Builtin::sub:
+    return Value{Number{x - y}};
+  default:
+    return Value{Number{x * y}};
+  }
+}
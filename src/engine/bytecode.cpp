@@ -0,0 +1,199 @@
+#include "engine/bytecode.h"
+#include "engine/machine.h"
+#include "ast/resolver.h"
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+const char* op_name(Op op)
+{
+  switch (op)
+  {
+  case Op::constant: return "constant";
+  case Op::local: return "local";
+  case Op::global: return "global";
+  case Op::set_local: return "set_local";
+  case Op::set_global: return "set_global";
+  case Op::define_global: return "define_global";
+  case Op::pop: return "pop";
+  case Op::jump: return "jump";
+  case Op::jump_if_false: return "jump_if_false";
+  case Op::call: return "call";
+  case Op::call_global: return "call_global";
+  case Op::tail_call: return "tail_call";
+  case Op::tail_call_global: return "tail_call_global";
+  case Op::ret: return "ret";
+  case Op::closure: return "closure";
+  case Op::enter: return "enter";
+  case Op::leave: return "leave";
+  case Op::guard: return "guard";
+  }
+  return "unknown";
+}
+
+uint32_t operand(size_t value)
+{
+  if (value > UINT32_MAX)
+  {
+    throw std::runtime_error("Too large to compile to bytecode");
+  }
+  return static_cast<uint32_t>(value);
+}
+}
+
+std::ostream& operator<<(std::ostream& out, const Function& function)
+{
+  for (size_t i{0}; i < function.code.size(); ++i)
+  {
+    const Instruction& in{function.code[i]};
+    out << i << ' ' << op_name(in.op) << ' ' << in.a << ' ' << in.b << '\n';
+  }
+  return out;
+}
+
+std::shared_ptr<const Function> Compiler::compile(const AST& form)
+{
+  auto function{std::make_shared<Function>()};
+  emit(*function, form);
+  function->code.push_back({Op::ret, 0, 0});
+  return function;
+}
+
+uint32_t Compiler::add_constant(Function& function, Value value)
+{
+  function.constants.push_back(std::move(value));
+  return operand(function.constants.size() - 1);
+}
+
+void Compiler::emit(Function& function, const AST& node)
+{
+  auto& code{function.code};
+  if (auto* constant{dynamic_cast<const ASTConstant*>(&node)})
+  {
+    code.push_back({Op::constant, add_constant(function, constant->value()), 0});
+  }
+  else if (auto* local{dynamic_cast<const ASTLocal*>(&node)})
+  {
+    code.push_back({Op::local, operand(local->depth()), operand(local->index())});
+  }
+  else if (auto* global{dynamic_cast<const ASTGlobal*>(&node)})
+  {
+    code.push_back({Op::global, operand(global->name()), 0});
+  }
+  else if (auto* call{dynamic_cast<const ASTCall*>(&node)})
+  {
+    auto* callee{dynamic_cast<const ASTGlobal*>(&call->callee())};
+    if (callee == nullptr)
+    {
+      emit(function, call->callee());
+    }
+    for (const auto& argument : call->arguments())
+    {
+      emit(function, *argument);
+    }
+    uint32_t count{operand(call->arguments().size())};
+    if (callee == nullptr)
+    {
+      code.push_back({call->tail() ? Op::tail_call : Op::call, count, 0});
+    }
+    else
+    {
+      code.push_back({call->tail() ? Op::tail_call_global : Op::call_global, count, operand(callee->name())});
+    }
+  }
+  else if (auto* define{dynamic_cast<const ASTDefineGlobal*>(&node)})
+  {
+    emit(function, define->value());
+    if (define->version())
+    {
+      function.versions.push_back(define->version());
+    }
+    code.push_back({Op::define_global, operand(define->name()),
+                    define->version() ? operand(function.versions.size()) : 0});
+  }
+  else if (auto* set{dynamic_cast<const ASTSetGlobal*>(&node)})
+  {
+    emit(function, set->value());
+    code.push_back({Op::set_global, operand(set->name()), 0});
+  }
+  else if (auto* set{dynamic_cast<const ASTSetLocal*>(&node)})
+  {
+    emit(function, set->value());
+    code.push_back({Op::set_local, operand(set->depth()), operand(set->index())});
+  }
+  else if (auto* block{dynamic_cast<const ASTBlock*>(&node)})
+  {
+    const auto& statements{block->statements()};
+    if (statements.empty())
+    {
+      code.push_back({Op::constant, add_constant(function, Value{Nil{}}), 0});
+    }
+    for (size_t i{0}; i < statements.size(); ++i)
+    {
+      emit(function, *statements[i]);
+      if (i + 1 < statements.size())
+      {
+        code.push_back({Op::pop, 0, 0});
+      }
+    }
+  }
+  else if (auto* let{dynamic_cast<const ASTScope*>(&node)})
+  {
+    for (const auto& value : let->values())
+    {
+      emit(function, *value);
+    }
+    code.push_back({Op::enter, operand(let->size()), operand(let->values().size())});
+    emit(function, let->body());
+    code.push_back({Op::leave, 0, 0});
+  }
+  else if (auto* lambda{dynamic_cast<const ASTProcedure*>(&node)})
+  {
+    auto inner{std::make_shared<Function>()};
+    inner->parameters = lambda->code()->parameters;
+    inner->size = lambda->code()->size;
+    emit(*inner, *lambda->code()->body);
+    inner->code.push_back({Op::ret, 0, 0});
+    function.functions.push_back(std::move(inner));
+    code.push_back({Op::closure, operand(function.functions.size() - 1), 0});
+  }
+  else if (auto* guard{dynamic_cast<const ASTGuard*>(&node)})
+  {
+    function.guards.push_back(guard->guards());
+    size_t to_slow{code.size()};
+    code.push_back({Op::guard, 0, operand(function.guards.size() - 1)});
+    emit(function, guard->fast());
+    size_t to_end{code.size()};
+    code.push_back({Op::jump, 0, 0});
+    code[to_slow].a = operand(code.size());
+    emit(function, guard->slow());
+    code[to_end].a = operand(code.size());
+  }
+  else if (node.type() == AST::Type::if_t)
+  {
+    std::vector<const AST*> parts;
+    node.append_children(parts);
+    emit(function, *parts[0]);
+    size_t to_else{code.size()};
+    code.push_back({Op::jump_if_false, 0, 0});
+    emit(function, *parts[1]);
+    size_t to_end{code.size()};
+    code.push_back({Op::jump, 0, 0});
+    code[to_else].a = operand(code.size());
+    emit(function, *parts[2]);
+    code[to_end].a = operand(code.size());
+  }
+  else
+  {
+    throw std::runtime_error("Cannot compile a " + node.str() + " that was not resolved");
+  }
+}
+
+Engine::Program VMEngine::compile(std::unique_ptr<AST> form)
+{
+  std::shared_ptr<const Function> function{Compiler{}.compile(*form)};
+  return [function](std::unique_ptr<Env>& env) {
+    return Machine{}.run(function, env->scope(), {}, env);
+  };
+}
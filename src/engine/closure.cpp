@@ -0,0 +1,446 @@
+#include "engine/closure.h"
+#include "engine/builtin.h"
+#include "ast/resolver.h"
+#include <array>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace
+{
+Value call_global(AtomTable::Atom name, std::span<Value> args, std::unique_ptr<Env>& env)
+{
+  Value* callee{env->global(name)};
+  if (callee == nullptr)
+  {
+    throw std::runtime_error("Could not find symbol " + env->get_name(name));
+  }
+  // a primitive runs in place, anything else may define globals and move
+  // the one it is called from
+  if (callee->is_primitive())
+  {
+    return callee->as_primitive()(args);
+  }
+  if (callee->is_procedure())
+  {
+    Procedure procedure{callee->as_procedure()};
+    return procedure(args, env);
+  }
+  Value copy{*callee};
+  return ASTCall::apply(copy, args, env);
+}
+
+// A global that held a built-in primitive when it was last checked
+struct Guard
+{
+  AtomTable::Atom name;
+  Builtin op;
+  uint32_t checked;
+
+  bool holds(std::unique_ptr<Env>& env)
+  {
+    if (env->version(name) == checked)
+    {
+      return true;
+    }
+    Value* callee{env->global(name)};
+    if (callee == nullptr || !is_builtin(*callee, op))
+    {
+      return false;
+    }
+    checked = env->version(name);
+    return true;
+  }
+};
+
+Value call_operands(AtomTable::Atom name, const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env,
+                    const CompiledOperand& left, const CompiledOperand& right)
+{
+  Value temp;
+  std::array<Value, 2> args{left(scope, env, temp), right(scope, env, temp)};
+  return call_global(name, args, env);
+}
+
+// Whether evaluating node cannot change anything, so a left operand read
+// in place before it still holds its value after
+bool is_simple(const AST& node)
+{
+  return dynamic_cast<const ASTConstant*>(&node) || dynamic_cast<const ASTLocal*>(&node);
+}
+
+// The left operand, copied out of its slot when the right one may set it
+Value& left_operand(const CompiledOperand& left, bool copy, const std::shared_ptr<Scope>& scope,
+                    std::unique_ptr<Env>& env, Value& temp)
+{
+  Value& value{left(scope, env, temp)};
+  if (copy && &value != &temp)
+  {
+    temp = value;
+    return temp;
+  }
+  return value;
+}
+
+Compiled builtin_call(Guard guard, CompiledOperand left, CompiledOperand right, bool copy_left)
+{
+  return [=](const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env) mutable {
+    if (!guard.holds(env))
+    {
+      return call_operands(guard.name, scope, env, left, right);
+    }
+    Value left_temp;
+    Value right_temp;
+    Value& a{left_operand(left, copy_left, scope, env, left_temp)};
+    Value& b{right(scope, env, right_temp)};
+    if (a.is_number() && b.is_number())
+    {
+      return arithmetic(guard.op, a.as_number(), b.as_number());
+    }
+    // the primitive has the error for it
+    std::array<Value, 2> args{a, b};
+    return call_global(guard.name, args, env);
+  };
+}
+
+CompiledTest builtin_test(Guard guard, CompiledOperand left, CompiledOperand right, bool copy_left)
+{
+  return [=](const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env) mutable {
+    if (!guard.holds(env))
+    {
+      return call_operands(guard.name, scope, env, left, right).is_true();
+    }
+    Value left_temp;
+    Value right_temp;
+    Value& a{left_operand(left, copy_left, scope, env, left_temp)};
+    Value& b{right(scope, env, right_temp)};
+    if (a.is_number() && b.is_number())
+    {
+      return comparison(guard.op, a.as_number(), b.as_number());
+    }
+    std::array<Value, 2> args{a, b};
+    return call_global(guard.name, args, env).is_true();
+  };
+}
+
+// The builtin a call is, with two arguments, none for any other call
+Builtin builtin_call_of(const AST& node)
+{
+  auto* call{dynamic_cast<const ASTCall*>(&node)};
+  if (call == nullptr || call->arguments().size() != 2)
+  {
+    return Builtin::none;
+  }
+  auto* global{dynamic_cast<const ASTGlobal*>(&call->callee())};
+  return global == nullptr ? Builtin::none : builtin(global->str());
+}
+
+// Calls with a few arguments keep them on the C++ stack
+template <size_t N>
+Compiled fixed_call(Compiled callee, std::vector<Compiled> arguments)
+{
+  return [callee, arguments](const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env) {
+    Value f{callee(scope, env)};
+    std::array<Value, N> args;
+    for (size_t i{0}; i < N; ++i)
+    {
+      args[i] = arguments[i](scope, env);
+    }
+    return ASTCall::apply(f, args, env);
+  };
+}
+
+template <size_t N>
+Compiled fixed_global_call(AtomTable::Atom name, std::vector<Compiled> arguments)
+{
+  return [name, arguments](const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env) {
+    std::array<Value, N> args;
+    for (size_t i{0}; i < N; ++i)
+    {
+      args[i] = arguments[i](scope, env);
+    }
+    return call_global(name, args, env);
+  };
+}
+}
+
+Compiled ClosureCompiler::compile(const AST& node)
+{
+  if (auto* constant{dynamic_cast<const ASTConstant*>(&node)})
+  {
+    return [value = constant->value()](const std::shared_ptr<Scope>&, std::unique_ptr<Env>&) { return value; };
+  }
+  if (auto* local{dynamic_cast<const ASTLocal*>(&node)})
+  {
+    size_t index{local->index()};
+    switch (local->depth())
+    {
+    case 0:
+      return [index](const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>&) { return scope->slot(index); };
+    case 1:
+      return [index](const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>&) {
+        return scope->parent()->slot(index);
+      };
+    default:
+      return [index, depth = local->depth()](const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>&) {
+        return scope->up(depth)->slot(index);
+      };
+    }
+  }
+  if (auto* global{dynamic_cast<const ASTGlobal*>(&node)})
+  {
+    return [name = global->name()](const std::shared_ptr<Scope>&, std::unique_ptr<Env>& env) {
+      Value* value{env->global(name)};
+      if (value == nullptr)
+      {
+        throw std::runtime_error("Could not find symbol " + env->get_name(name));
+      }
+      return *value;
+    };
+  }
+  if (dynamic_cast<const ASTCall*>(&node))
+  {
+    return compile_call(node);
+  }
+  if (auto* define{dynamic_cast<const ASTDefineGlobal*>(&node)})
+  {
+    return [name = define->name(), value = compile(define->value()), version = define->version()](
+             const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env) {
+      Value ret{value(scope, env)};
+      env->define_global(name, ret);
+      if (version)
+      {
+        *version = env->version(name);
+      }
+      return ret;
+    };
+  }
+  if (auto* set{dynamic_cast<const ASTSetGlobal*>(&node)})
+  {
+    return [name = set->name(), value = compile(set->value())](const std::shared_ptr<Scope>& scope,
+                                                                  std::unique_ptr<Env>& env) {
+      Value ret{value(scope, env)};
+      if (!env->set_global(name, ret))
+      {
+        throw std::runtime_error("Error trying to set " + env->get_name(name));
+      }
+      return ret;
+    };
+  }
+  if (auto* set{dynamic_cast<const ASTSetLocal*>(&node)})
+  {
+    return [depth = set->depth(), index = set->index(), value = compile(set->value())](
+             const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env) {
+      Value ret{value(scope, env)};
+      scope->up(depth)->slot(index) = ret;
+      return ret;
+    };
+  }
+  if (auto* block{dynamic_cast<const ASTBlock*>(&node)})
+  {
+    std::vector<Compiled> statements;
+    for (const auto& statement : block->statements())
+    {
+      statements.push_back(compile(*statement));
+    }
+    if (statements.size() == 1)
+    {
+      return statements.front();
+    }
+    return [statements](const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env) {
+      Value ret{Nil{}};
+      for (const auto& statement : statements)
+      {
+        ret = statement(scope, env);
+      }
+      return ret;
+    };
+  }
+  if (auto* let{dynamic_cast<const ASTScope*>(&node)})
+  {
+    std::vector<Compiled> values;
+    for (const auto& value : let->values())
+    {
+      values.push_back(compile(*value));
+    }
+    return [values, size = let->size(), body = compile(let->body())](const std::shared_ptr<Scope>& scope,
+                                                                        std::unique_ptr<Env>& env) {
+      auto inner{std::make_shared<Scope>(scope, size)};
+      for (size_t i{0}; i < values.size(); ++i)
+      {
+        inner->slot(i) = values[i](scope, env);
+      }
+      return body(inner, env);
+    };
+  }
+  if (auto* lambda{dynamic_cast<const ASTProcedure*>(&node)})
+  {
+    std::shared_ptr<const ClosureCode> code{std::make_shared<ClosureCode>(
+      ClosureCode{lambda->code()->parameters, lambda->code()->size, compile(*lambda->code()->body)})};
+    return [code](const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>&) {
+      return Value{Procedure{std::make_shared<ClosureBody>(code, scope)}};
+    };
+  }
+  if (auto* guard{dynamic_cast<const ASTGuard*>(&node)})
+  {
+    return [guards = guard->guards(), fast = compile(guard->fast()), slow = compile(guard->slow())](
+             const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env) {
+      return ASTGuard::holds(guards, env) ? fast(scope, env) : slow(scope, env);
+    };
+  }
+  if (node.type() == AST::Type::if_t)
+  {
+    std::vector<const AST*> parts;
+    node.append_children(parts);
+    return [test = compile_test(*parts[0]), then = compile(*parts[1]), otherwise = compile(*parts[2])](
+             const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env) {
+      return test(scope, env) ? then(scope, env) : otherwise(scope, env);
+    };
+  }
+  throw std::runtime_error("Cannot compile a " + node.str() + " that was not resolved");
+}
+
+Compiled ClosureCompiler::compile_call(const AST& node)
+{
+  const auto& call{static_cast<const ASTCall&>(node)};
+  Builtin op{builtin_call_of(node)};
+  if (op != Builtin::none)
+  {
+    Guard guard{static_cast<const ASTGlobal&>(call.callee()).name(), op, 0};
+    return builtin_call(guard, compile_operand(*call.arguments()[0]), compile_operand(*call.arguments()[1]),
+                        !is_simple(*call.arguments()[1]));
+  }
+  std::vector<Compiled> arguments;
+  for (const auto& argument : call.arguments())
+  {
+    arguments.push_back(compile(*argument));
+  }
+  if (call.tail())
+  {
+    return [callee = compile(call.callee()), arguments](const std::shared_ptr<Scope>& scope,
+                                                        std::unique_ptr<Env>& env) {
+      Value f{callee(scope, env)};
+      std::vector<Value> args;
+      args.reserve(arguments.size());
+      for (const auto& argument : arguments)
+      {
+        args.push_back(argument(scope, env));
+      }
+      return ASTCall::tail_apply(f, std::move(args), env);
+    };
+  }
+  if (auto* global{dynamic_cast<const ASTGlobal*>(&call.callee())})
+  {
+    AtomTable::Atom name{global->name()};
+    switch (arguments.size())
+    {
+    case 0:
+      return fixed_global_call<0>(name, std::move(arguments));
+    case 1:
+      return fixed_global_call<1>(name, std::move(arguments));
+    case 2:
+      return fixed_global_call<2>(name, std::move(arguments));
+    case 3:
+      return fixed_global_call<3>(name, std::move(arguments));
+    default:
+      return [name, arguments](const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env) {
+        std::vector<Value> args;
+        args.reserve(arguments.size());
+        for (const auto& argument : arguments)
+        {
+          args.push_back(argument(scope, env));
+        }
+        return call_global(name, args, env);
+      };
+    }
+  }
+
+  Compiled callee{compile(call.callee())};
+  switch (arguments.size())
+  {
+  case 0:
+    return fixed_call<0>(std::move(callee), std::move(arguments));
+  case 1:
+    return fixed_call<1>(std::move(callee), std::move(arguments));
+  case 2:
+    return fixed_call<2>(std::move(callee), std::move(arguments));
+  case 3:
+    return fixed_call<3>(std::move(callee), std::move(arguments));
+  default:
+    return [callee, arguments](const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env) {
+      Value f{callee(scope, env)};
+      std::vector<Value> args;
+      args.reserve(arguments.size());
+      for (const auto& argument : arguments)
+      {
+        args.push_back(argument(scope, env));
+      }
+      return ASTCall::apply(f, args, env);
+    };
+  }
+}
+
+CompiledOperand ClosureCompiler::compile_operand(const AST& node)
+{
+  if (auto* constant{dynamic_cast<const ASTConstant*>(&node)})
+  {
+    return [value = constant->value()](const std::shared_ptr<Scope>&, std::unique_ptr<Env>&,
+                                       Value&) mutable -> Value& { return value; };
+  }
+  if (auto* local{dynamic_cast<const ASTLocal*>(&node)})
+  {
+    if (local->depth() == 0)
+    {
+      return [index = local->index()](const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>&,
+                                      Value&) -> Value& { return scope->slot(index); };
+    }
+    return [depth = local->depth(), index = local->index()](const std::shared_ptr<Scope>& scope,
+                                                            std::unique_ptr<Env>&, Value&) -> Value& {
+      return scope->up(depth)->slot(index);
+    };
+  }
+  return [compiled = compile(node)](const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env,
+                                    Value& temp) -> Value& {
+    temp = compiled(scope, env);
+    return temp;
+  };
+}
+
+CompiledTest ClosureCompiler::compile_test(const AST& node)
+{
+  Builtin op{builtin_call_of(node)};
+  if (is_comparison(op))
+  {
+    const auto& call{static_cast<const ASTCall&>(node)};
+    Guard guard{static_cast<const ASTGlobal&>(call.callee()).name(), op, 0};
+    return builtin_test(guard, compile_operand(*call.arguments()[0]), compile_operand(*call.arguments()[1]),
+                        !is_simple(*call.arguments()[1]));
+  }
+  return [compiled = compile(node)](const std::shared_ptr<Scope>& scope, std::unique_ptr<Env>& env) {
+    return compiled(scope, env).is_true();
+  };
+}
+
+Value ClosureBody::call(std::span<Value> args, std::unique_ptr<Env>& env)
+{
+  if (args.size() != code_->parameters)
+  {
+    throw std::runtime_error("wrong number of arguments passed to lambda");
+  }
+  auto scope{std::make_shared<Scope>(scope_, code_->size)};
+  for (size_t i{0}; i < args.size(); ++i)
+  {
+    scope->slot(i) = std::move(args[i]);
+  }
+  Value ret;
+  do
+  {
+    ret = code_->body(scope, env);
+  } while (env->rerun(*this, scope, code_->parameters));
+  return ret;
+}
+
+Engine::Program ClosureEngine::compile(std::unique_ptr<AST> form)
+{
+  Compiled compiled{ClosureCompiler{}.compile(*form)};
+  return [compiled](std::unique_ptr<Env>& env) { return compiled(env->scope(), env); };
+}
@@ -0,0 +1,60 @@
+#include "engine/engine.h"
+#include "ast/analysis.h"
+#include "ast/resolver.h"
+#include "engine/bytecode.h"
+#include "engine/closure.h"
+#include "engine/jit.h"
+#include "engine/optimizer.h"
+#include "engine/quicken.h"
+#include "parser/parser.h"
+#include <stdexcept>
+
+std::unique_ptr<Engine> Engine::factory(const std::string& name)
+{
+  if (name == "tree")
+  {
+    return std::make_unique<TreeEngine>();
+  }
+  if (name == "vm")
+  {
+    return std::make_unique<VMEngine>();
+  }
+  if (name == "closure")
+  {
+    return std::make_unique<ClosureEngine>();
+  }
+  if (name == "quick")
+  {
+    return std::make_unique<QuickEngine>();
+  }
+  if (name == "jit")
+  {
+    return std::make_unique<JitEngine>();
+  }
+  throw std::runtime_error("No engine named " + name);
+}
+
+const std::vector<std::string>& Engine::names()
+{
+  static const std::vector<std::string> names{"tree", "vm", "closure", "quick", "jit"};
+  return names;
+}
+
+std::unique_ptr<AST> prepare(std::unique_ptr<AST> form, std::unique_ptr<Env>& env,
+                             std::function<Position(size_t)> locate, Optimizer* optimizer)
+{
+  auto resolved{Resolver{env}.resolve(Analysis{env, std::move(locate)}.lower(std::move(form)))};
+  return optimizer == nullptr ? std::move(resolved) : optimizer->optimize(std::move(resolved));
+}
+
+Engine::Program compile(const std::string& program, Engine& engine, std::unique_ptr<Env>& env, Optimizer* optimizer)
+{
+  Parser parser{program};
+  return engine.compile(prepare(parser.parse(), env, [&](size_t offset) { return parser.position(offset); }, optimizer));
+}
+
+Engine::Program TreeEngine::compile(std::unique_ptr<AST> form)
+{
+  std::shared_ptr<AST> tree{std::move(form)};
+  return [tree](std::unique_ptr<Env>& env) { return tree->eval(env); };
+}
@@ -0,0 +1,712 @@
+#include "engine/jit.h"
+#include "engine/builtin.h"
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define TYSON_JIT_X86_64 1
+#endif
+
+namespace
+{
+std::atomic<bool> jit_enabled{true};
+std::atomic<size_t> jit_threshold{1000};
+// Native code that gave up more often than this is dropped
+constexpr size_t max_failures{16};
+}
+
+struct JitSite;
+
+// What native code gets besides its arguments. failed goes first, the
+// code tests it at [rbx] after every call. A tail call of another lambda
+// is left in tail for the code that called in.
+struct JitContext
+{
+  bool failed;
+  std::unique_ptr<Env>* env;
+  JitSite* tail{nullptr};
+  std::vector<int64_t> tail_args;
+};
+
+// A call of a global in native code, linked to the lambda the global
+// holds while it keeps the version it had
+struct JitSite
+{
+  AtomTable::Atom name;
+  size_t arity;
+  uint32_t version;
+  JitState* target;
+};
+
+// Pages with the code of one function, executable and no longer writable
+class ExecutableMemory
+{
+public:
+  ExecutableMemory(const std::vector<uint8_t>& code);
+  ~ExecutableMemory();
+  ExecutableMemory(const ExecutableMemory&) = delete;
+  ExecutableMemory& operator=(const ExecutableMemory&) = delete;
+  void* data() const { return data_; }
+private:
+  void* data_;
+  size_t size_;
+};
+
+using JitEntry = int64_t (*)(JitContext* context, int64_t* args);
+
+struct JitFunction
+{
+  std::unique_ptr<ExecutableMemory> memory;
+  JitEntry entry;
+  // the result is an int, a bool otherwise
+  bool integer;
+  // the builtins the code does itself, with the versions of their globals
+  std::vector<std::pair<AtomTable::Atom, uint32_t>> guards;
+  std::vector<std::unique_ptr<JitSite>> sites;
+
+  bool holds(std::unique_ptr<Env>& env) const
+  {
+    for (const auto& [name, version] : guards)
+    {
+      if (env->version(name) != version)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+namespace
+{
+// The native code of the lambda the global of a site holds, nullptr when
+// there is none
+JitFunction* site_function(JitContext* context, JitSite* site)
+{
+  std::unique_ptr<Env>& env{*context->env};
+  if (site->target == nullptr || env->version(site->name) != site->version)
+  {
+    site->target = nullptr;
+    Value* callee{env->global(site->name)};
+    if (callee != nullptr && callee->is_procedure())
+    {
+      auto* body{dynamic_cast<JitBody*>(&callee->as_procedure().body())};
+      if (body != nullptr && body->state().code().parameters == site->arity)
+      {
+        site->target = &body->state();
+        site->version = env->version(site->name);
+      }
+    }
+  }
+  // a callee that is called from native code is hot
+  return site->target == nullptr ? nullptr : site->target->function(env, true);
+}
+
+// Runs native code, then the tail calls it leaves one after the other.
+// function is left at the one that ran last, which has the kind of the
+// result.
+int64_t run_native(JitContext* context, JitFunction*& function, int64_t* args)
+{
+  int64_t result{function->entry(context, args)};
+  // swapped with the arguments of each tail call, neither is allocated again
+  std::vector<int64_t> next;
+  while (context->tail != nullptr && !context->failed)
+  {
+    JitSite* site{std::exchange(context->tail, nullptr)};
+    next.swap(context->tail_args);
+    function = site_function(context, site);
+    if (function == nullptr)
+    {
+      context->failed = true;
+      return 0;
+    }
+    result = function->entry(context, next.data());
+  }
+  context->tail = nullptr;
+  return result;
+}
+}
+
+#ifdef TYSON_JIT_X86_64
+ExecutableMemory::ExecutableMemory(const std::vector<uint8_t>& code)
+{
+  size_t page{static_cast<size_t>(sysconf(_SC_PAGESIZE))};
+  size_ = (code.size() + page - 1) / page * page;
+  data_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (data_ == MAP_FAILED)
+  {
+    throw std::runtime_error("Could not map memory for native code");
+  }
+  std::memcpy(data_, code.data(), code.size());
+  if (mprotect(data_, size_, PROT_READ | PROT_EXEC) != 0)
+  {
+    munmap(data_, size_);
+    throw std::runtime_error("Could not make native code executable");
+  }
+}
+
+ExecutableMemory::~ExecutableMemory()
+{
+  munmap(data_, size_);
+}
+
+namespace
+{
+// How native code calls a global: runs the native code of the lambda the
+// global holds, or gives up
+int64_t call_site(JitContext* context, JitSite* site, int64_t* args)
+{
+  JitFunction* function{site_function(context, site)};
+  if (function == nullptr || !function->integer)
+  {
+    context->failed = true;
+    return 0;
+  }
+  int64_t result{run_native(context, function, args)};
+  if (!function->integer)
+  {
+    context->failed = true;
+  }
+  return result;
+}
+
+// How native code makes a tail call of another global: the arguments are
+// kept for run_native, the code returns right after
+int64_t tail_site(JitContext* context, JitSite* site, int64_t* args)
+{
+  context->tail = site;
+  context->tail_args.assign(args, args + site->arity);
+  return 0;
+}
+
+// Compiles a lambda a node at a time, each node to the same few
+// instructions. A value is computed into rax, a left operand waits on the
+// stack for the right one. rbx holds the context, r12 the arguments,
+// which are in reverse order, the last at [r12].
+class JitCompiler
+{
+public:
+  JitCompiler(const Code& code, std::unique_ptr<Env>& env) : code_{code}, env_{env} {}
+  std::unique_ptr<JitFunction> compile();
+private:
+  enum class Kind
+  {
+    integer,
+    boolean
+  };
+  // false for a node the JIT does not cover
+  bool expression(const AST& node, Kind& kind);
+  bool builtin_call(const ASTCall& call, Builtin op, Kind& kind);
+  bool global_call(const ASTCall& call, AtomTable::Atom name);
+  // A tail call of the lambda itself, it jumps back to the start
+  bool self_call(const ASTCall& call, AtomTable::Atom name);
+  bool branch(const AST& node, Kind& kind);
+
+  void emit(std::initializer_list<uint8_t> bytes) { code_bytes_.insert(code_bytes_.end(), bytes); }
+  void emit32(int32_t value);
+  void emit64(uint64_t value);
+  // A jump with its rel32 left to patch, where that is
+  size_t jump(std::initializer_list<uint8_t> opcode);
+  void patch(size_t at, size_t target);
+  void push();
+  void pop();
+  // Leaves rax if it does not hold an int, after an add, sub or mul
+  void bail_on_overflow();
+
+  const Code& code_;
+  std::unique_ptr<Env>& env_;
+  std::unique_ptr<JitFunction> function_{std::make_unique<JitFunction>()};
+  std::vector<uint8_t> code_bytes_;
+  // values pushed, an odd count leaves the stack off alignment for a call
+  size_t depth_{0};
+  std::vector<size_t> bails_;
+  // where the body starts, after the prologue
+  size_t start_{0};
+};
+
+std::unique_ptr<JitFunction> JitCompiler::compile()
+{
+  // push rbp; mov rbp, rsp; push rbx; push r12; mov rbx, rdi; mov r12, rsi
+  emit({0x55, 0x48, 0x89, 0xe5, 0x53, 0x41, 0x54, 0x48, 0x89, 0xfb, 0x49, 0x89, 0xf4});
+  start_ = code_bytes_.size();
+  Kind kind;
+  if (!code_.body || !expression(*code_.body, kind))
+  {
+    return nullptr;
+  }
+  size_t done{jump({0xe9})};
+  size_t bail{code_bytes_.size()};
+  // mov byte [rbx], 1
+  emit({0xc6, 0x03, 0x01});
+  patch(done, code_bytes_.size());
+  // lea rsp, [rbp - 16]; pop r12; pop rbx; pop rbp; ret
+  emit({0x48, 0x8d, 0x65, 0xf0, 0x41, 0x5c, 0x5b, 0x5d, 0xc3});
+  for (size_t at : bails_)
+  {
+    patch(at, bail);
+  }
+  function_->memory = std::make_unique<ExecutableMemory>(code_bytes_);
+  function_->entry = reinterpret_cast<JitEntry>(function_->memory->data());
+  function_->integer = kind == Kind::integer;
+  return std::move(function_);
+}
+
+bool JitCompiler::expression(const AST& node, Kind& kind)
+{
+  if (auto* constant{dynamic_cast<const ASTConstant*>(&node)})
+  {
+    Value value{constant->value()};
+    if (!value.is_number() || !value.as_number().is_int())
+    {
+      return false;
+    }
+    // mov rax, imm64
+    emit({0x48, 0xb8});
+    emit64(static_cast<uint64_t>(static_cast<int64_t>(value.as_number().as_int())));
+    kind = Kind::integer;
+    return true;
+  }
+  if (auto* local{dynamic_cast<const ASTLocal*>(&node)})
+  {
+    if (local->depth() != 0 || local->index() >= code_.parameters)
+    {
+      return false;
+    }
+    // mov rax, [r12 + disp32]
+    emit({0x49, 0x8b, 0x84, 0x24});
+    emit32(static_cast<int32_t>(8 * (code_.parameters - 1 - local->index())));
+    kind = Kind::integer;
+    return true;
+  }
+  if (auto* call{dynamic_cast<const ASTCall*>(&node)})
+  {
+    auto* global{dynamic_cast<const ASTGlobal*>(&call->callee())};
+    if (global == nullptr)
+    {
+      return false;
+    }
+    Builtin op{builtin(global->str())};
+    if (op != Builtin::none)
+    {
+      return builtin_call(*call, op, kind);
+    }
+    kind = Kind::integer;
+    return global_call(*call, global->name());
+  }
+  if (auto* block{dynamic_cast<const ASTBlock*>(&node)})
+  {
+    if (block->statements().empty())
+    {
+      return false;
+    }
+    for (const auto& statement : block->statements())
+    {
+      if (!expression(*statement, kind))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+  if (auto* guard{dynamic_cast<const ASTGuard*>(&node)})
+  {
+    // native code only runs while its guards hold, one on a define that
+    // did not run yet never does
+    for (const auto& [name, version] : guard->guards())
+    {
+      if (*version == 0)
+      {
+        return false;
+      }
+      function_->guards.emplace_back(name, *version);
+    }
+    return expression(guard->fast(), kind);
+  }
+  if (node.type() == AST::Type::if_t)
+  {
+    return branch(node, kind);
+  }
+  return false;
+}
+
+bool JitCompiler::builtin_call(const ASTCall& call, Builtin op, Kind& kind)
+{
+  const auto& global{static_cast<const ASTGlobal&>(call.callee())};
+  Value* callee{env_->global(global.name())};
+  if (call.arguments().size() != 2 || callee == nullptr || !is_builtin(*callee, op))
+  {
+    return false;
+  }
+  function_->guards.emplace_back(global.name(), env_->version(global.name()));
+  Kind left;
+  Kind right;
+  if (!expression(*call.arguments()[0], left))
+  {
+    return false;
+  }
+  push();
+  if (!expression(*call.arguments()[1], right) || left != Kind::integer || right != Kind::integer)
+  {
+    return false;
+  }
+  // pop rcx, the left operand
+  pop();
+  kind = Kind::integer;
+  switch (op)
+  {
+  case Builtin::add:
+    // add rax, rcx
+    emit({0x48, 0x01, 0xc8});
+    bail_on_overflow();
+    break;
+  case Builtin::sub:
+    // sub rcx, rax; mov rax, rcx
+    emit({0x48, 0x29, 0xc1, 0x48, 0x89, 0xc8});
+    bail_on_overflow();
+    break;
+  case Builtin::mul:
+    // imul rax, rcx
+    emit({0x48, 0x0f, 0xaf, 0xc1});
+    bail_on_overflow();
+    break;
+  default:
+    // cmp rcx, rax; setl/setg/sete al; movzx eax, al
+    emit({0x48, 0x39, 0xc1, 0x0f});
+    emit({op == Builtin::lt ? uint8_t{0x9c} : op == Builtin::gt ? uint8_t{0x9f} : uint8_t{0x94}, 0xc0});
+    emit({0x0f, 0xb6, 0xc0});
+    kind = Kind::boolean;
+    break;
+  }
+  return true;
+}
+
+bool JitCompiler::global_call(const ASTCall& call, AtomTable::Atom name)
+{
+  // a global not bound yet may still get a lambda
+  Value* callee{env_->global(name)};
+  JitBody* body{callee != nullptr && callee->is_procedure() ? dynamic_cast<JitBody*>(&callee->as_procedure().body())
+                                                            : nullptr};
+  if (callee != nullptr && body == nullptr)
+  {
+    return false;
+  }
+  if (call.tail() && body != nullptr && &body->state().code() == &code_)
+  {
+    return self_call(call, name);
+  }
+  size_t count{call.arguments().size()};
+  // the stack is aligned at the call once the arguments are on it
+  size_t pad{(depth_ + count) % 2};
+  if (pad != 0)
+  {
+    // sub rsp, 8
+    emit({0x48, 0x83, 0xec, 0x08});
+    ++depth_;
+  }
+  for (const auto& argument : call.arguments())
+  {
+    Kind kind;
+    if (!expression(*argument, kind) || kind != Kind::integer)
+    {
+      return false;
+    }
+    push();
+  }
+  function_->sites.push_back(std::make_unique<JitSite>(JitSite{name, count, 0, nullptr}));
+  // mov rdi, rbx; mov rsi, site; mov rdx, rsp; mov rax, call_site; call rax
+  emit({0x48, 0x89, 0xdf, 0x48, 0xbe});
+  emit64(reinterpret_cast<uint64_t>(function_->sites.back().get()));
+  emit({0x48, 0x89, 0xe2, 0x48, 0xb8});
+  emit64(reinterpret_cast<uint64_t>(call.tail() ? &tail_site : &call_site));
+  emit({0xff, 0xd0});
+  // add rsp, imm32
+  emit({0x48, 0x81, 0xc4});
+  emit32(static_cast<int32_t>(8 * (count + pad)));
+  depth_ -= count + pad;
+  if (!call.tail())
+  {
+    // cmp byte [rbx], 0; jne bail
+    emit({0x80, 0x3b, 0x00});
+    bails_.push_back(jump({0x0f, 0x85}));
+  }
+  return true;
+}
+
+bool JitCompiler::self_call(const ASTCall& call, AtomTable::Atom name)
+{
+  size_t count{call.arguments().size()};
+  if (count != code_.parameters || depth_ != 0)
+  {
+    return false;
+  }
+  // the global must still hold this lambda for the jump to be right
+  function_->guards.emplace_back(name, env_->version(name));
+  for (const auto& argument : call.arguments())
+  {
+    Kind kind;
+    if (!expression(*argument, kind) || kind != Kind::integer)
+    {
+      return false;
+    }
+    push();
+  }
+  // the new arguments replace the old, the last is on top
+  for (size_t i{0}; i < count; ++i)
+  {
+    // pop rax; mov [r12 + disp32], rax
+    emit({0x58, 0x49, 0x89, 0x84, 0x24});
+    emit32(static_cast<int32_t>(8 * i));
+    --depth_;
+  }
+  // jmp start
+  patch(jump({0xe9}), start_);
+  return true;
+}
+
+bool JitCompiler::branch(const AST& node, Kind& kind)
+{
+  std::vector<const AST*> parts;
+  node.append_children(parts);
+  Kind test;
+  if (parts.size() != 3 || !expression(*parts[0], test) || test != Kind::boolean)
+  {
+    return false;
+  }
+  // test rax, rax; je otherwise
+  emit({0x48, 0x85, 0xc0});
+  size_t otherwise{jump({0x0f, 0x84})};
+  Kind then;
+  if (!expression(*parts[1], then))
+  {
+    return false;
+  }
+  size_t done{jump({0xe9})};
+  patch(otherwise, code_bytes_.size());
+  if (!expression(*parts[2], kind) || kind != then)
+  {
+    return false;
+  }
+  patch(done, code_bytes_.size());
+  return true;
+}
+
+void JitCompiler::emit32(int32_t value)
+{
+  uint8_t bytes[4];
+  std::memcpy(bytes, &value, sizeof(bytes));
+  code_bytes_.insert(code_bytes_.end(), bytes, bytes + sizeof(bytes));
+}
+
+void JitCompiler::emit64(uint64_t value)
+{
+  uint8_t bytes[8];
+  std::memcpy(bytes, &value, sizeof(bytes));
+  code_bytes_.insert(code_bytes_.end(), bytes, bytes + sizeof(bytes));
+}
+
+size_t JitCompiler::jump(std::initializer_list<uint8_t> opcode)
+{
+  emit(opcode);
+  size_t at{code_bytes_.size()};
+  emit32(0);
+  return at;
+}
+
+void JitCompiler::patch(size_t at, size_t target)
+{
+  int32_t offset{static_cast<int32_t>(target - (at + 4))};
+  std::memcpy(code_bytes_.data() + at, &offset, sizeof(offset));
+}
+
+void JitCompiler::push()
+{
+  // push rax
+  emit({0x50});
+  ++depth_;
+}
+
+void JitCompiler::pop()
+{
+  // pop rcx
+  emit({0x59});
+  --depth_;
+}
+
+void JitCompiler::bail_on_overflow()
+{
+  // movsxd rdx, eax; cmp rdx, rax; jne bail
+  emit({0x48, 0x63, 0xd0, 0x48, 0x39, 0xc2});
+  bails_.push_back(jump({0x0f, 0x85}));
+}
+}
+#else
+ExecutableMemory::ExecutableMemory(const std::vector<uint8_t>& code) : data_{nullptr}, size_{0}
+{
+  throw std::runtime_error("No native code on this platform");
+}
+
+ExecutableMemory::~ExecutableMemory()
+{
+}
+#endif
+
+bool Jit::enabled()
+{
+  return jit_enabled;
+}
+
+void Jit::set_enabled(bool enabled)
+{
+  jit_enabled = enabled;
+}
+
+size_t Jit::threshold()
+{
+  return jit_threshold;
+}
+
+void Jit::set_threshold(size_t calls)
+{
+  jit_threshold = calls;
+}
+
+bool Jit::supported()
+{
+#ifdef TYSON_JIT_X86_64
+  return true;
+#else
+  return false;
+#endif
+}
+
+JitState::JitState(std::shared_ptr<Code> code) : code_{std::move(code)}
+{
+}
+
+JitState::~JitState() = default;
+
+JitFunction* JitState::function(std::unique_ptr<Env>& env, bool now)
+{
+  if (rejected_ || !Jit::enabled())
+  {
+    return nullptr;
+  }
+  if (function_)
+  {
+    if (function_->holds(env))
+    {
+      return function_.get();
+    }
+    // a builtin it does itself was redefined
+    retired_.push_back(std::move(function_));
+    rejected_ = true;
+    return nullptr;
+  }
+  if (!now && ++calls_ < Jit::threshold())
+  {
+    return nullptr;
+  }
+#ifdef TYSON_JIT_X86_64
+  try
+  {
+    function_ = JitCompiler{*code_, env}.compile();
+  }
+  catch (const std::runtime_error&)
+  {
+    function_.reset();
+  }
+#endif
+  rejected_ = !function_;
+  return function_.get();
+}
+
+void JitState::failed()
+{
+  if (++failures_ > max_failures)
+  {
+    retired_.push_back(std::move(function_));
+    rejected_ = true;
+  }
+}
+
+Value JitBody::call(std::span<Value> args, std::unique_ptr<Env>& env)
+{
+  const Code& code{state_->code()};
+  if (args.size() != code.parameters)
+  {
+    throw std::runtime_error("wrong number of arguments passed to lambda");
+  }
+  JitFunction* function{state_->function(env, false)};
+  if (function != nullptr)
+  {
+    std::vector<int64_t> native(args.size());
+    bool ints{true};
+    for (size_t i{0}; i < args.size() && ints; ++i)
+    {
+      ints = args[i].is_number() && args[i].as_number().is_int();
+      native[args.size() - 1 - i] = ints ? args[i].as_number().as_int() : 0;
+    }
+    if (ints)
+    {
+      JitContext context{false, &env, nullptr, {}};
+      int64_t result{run_native(&context, function, native.data())};
+      if (!context.failed)
+      {
+        return function->integer ? Value{Number{static_cast<int>(result)}} : Value{Boolean{result != 0}};
+      }
+      state_->failed();
+    }
+  }
+  auto scope{std::make_shared<Scope>(scope_, code.size)};
+  for (size_t i{0}; i < args.size(); ++i)
+  {
+    scope->slot(i) = std::move(args[i]);
+  }
+  // a tail call of itself comes back through call, which counts it and
+  // may run it native
+  EnteredScope entered{*env, std::move(scope)};
+  return code.body->eval(env);
+}
+
+ASTJitProcedure::ASTJitProcedure(const AST& lambda, std::shared_ptr<Code> code) :
+  AST{lambda}, code_{code}, state_{std::make_shared<JitState>(std::move(code))}
+{
+}
+
+void ASTJitProcedure::append_children(std::vector<const AST*>& out) const
+{
+  out.push_back(code_->body.get());
+}
+
+void ASTJitProcedure::replace_children(const Replace& replace)
+{
+  code_->body = replace(std::move(code_->body));
+}
+
+Value ASTJitProcedure::eval(std::unique_ptr<Env>& env)
+{
+  return Value{Procedure{std::make_shared<JitBody>(state_, env->scope())}};
+}
+
+namespace
+{
+std::unique_ptr<AST> jit_procedures(std::unique_ptr<AST> node)
+{
+  node->replace_children([](std::unique_ptr<AST> child) { return jit_procedures(std::move(child)); });
+  if (auto* procedure{dynamic_cast<ASTProcedure*>(node.get())})
+  {
+    return std::make_unique<ASTJitProcedure>(*node, procedure->code());
+  }
+  return node;
+}
+}
+
+Engine::Program JitEngine::compile(std::unique_ptr<AST> form)
+{
+  std::shared_ptr<AST> tree{jit_procedures(std::move(form))};
+  return [tree](std::unique_ptr<Env>& env) { return tree->eval(env); };
+}
@@ -0,0 +1,193 @@
+#include "engine/machine.h"
+#include "ast/resolver.h"
+#include <stdexcept>
+#include <utility>
+
+Value Machine::run(std::shared_ptr<const Function> function, std::shared_ptr<Scope> scope, std::span<Value> args,
+                   std::unique_ptr<Env>& env)
+{
+  enter(std::move(function), std::move(scope), args, false);
+  while (true)
+  {
+    Frame& frame{frames_.back()};
+    const Instruction& in{frame.function->code[frame.pc++]};
+    switch (in.op)
+    {
+    case Op::constant:
+      stack_.push_back(frame.function->constants[in.a]);
+      break;
+    case Op::local:
+      stack_.push_back(frame.scope->up(in.a)->slot(in.b));
+      break;
+    case Op::global:
+    {
+      Value* value{env->global(in.a)};
+      if (value == nullptr)
+      {
+        throw std::runtime_error("Could not find symbol " + env->get_name(in.a));
+      }
+      stack_.push_back(*value);
+      break;
+    }
+    case Op::set_local:
+      frame.scope->up(in.a)->slot(in.b) = stack_.back();
+      break;
+    case Op::set_global:
+      if (!env->set_global(in.a, stack_.back()))
+      {
+        throw std::runtime_error("Error trying to set " + env->get_name(in.a));
+      }
+      break;
+    case Op::define_global:
+      env->define_global(in.a, stack_.back());
+      if (in.b != 0)
+      {
+        *frame.function->versions[in.b - 1] = env->version(in.a);
+      }
+      break;
+    case Op::pop:
+      stack_.pop_back();
+      break;
+    case Op::jump:
+      frame.pc = in.a;
+      break;
+    case Op::jump_if_false:
+    {
+      bool test{stack_.back().is_true()};
+      stack_.pop_back();
+      if (!test)
+      {
+        frame.pc = in.a;
+      }
+      break;
+    }
+    case Op::call:
+    case Op::tail_call:
+    {
+      Value callee{std::move(stack_[stack_.size() - in.a - 1])};
+      call(callee, in.a, 1, in.op == Op::tail_call, env);
+      break;
+    }
+    case Op::call_global:
+    case Op::tail_call_global:
+    {
+      Value* callee{env->global(in.b)};
+      if (callee == nullptr)
+      {
+        throw std::runtime_error("Could not find symbol " + env->get_name(in.b));
+      }
+      // a primitive runs in place, anything else may define globals and
+      // move the one it is called from
+      bool tail{in.op == Op::tail_call_global};
+      if (callee->is_primitive())
+      {
+        call(*callee, in.a, 0, tail, env);
+      }
+      else
+      {
+        Value copy{*callee};
+        call(copy, in.a, 0, tail, env);
+      }
+      break;
+    }
+    case Op::ret:
+    {
+      Value result{std::move(stack_.back())};
+      stack_.pop_back();
+      frames_.pop_back();
+      if (frames_.empty())
+      {
+        return result;
+      }
+      stack_.push_back(std::move(result));
+      break;
+    }
+    case Op::closure:
+      stack_.push_back(Value{Procedure{std::make_shared<MachineBody>(frame.function->functions[in.a], frame.scope)}});
+      break;
+    case Op::enter:
+    {
+      auto scope{std::make_shared<Scope>(frame.scope, in.a)};
+      for (size_t i{0}; i < in.b; ++i)
+      {
+        scope->slot(i) = std::move(stack_[stack_.size() - in.b + i]);
+      }
+      stack_.resize(stack_.size() - in.b);
+      frame.scope = std::move(scope);
+      break;
+    }
+    case Op::leave:
+      frame.scope = frame.scope->parent();
+      break;
+    case Op::guard:
+      if (!ASTGuard::holds(frame.function->guards[in.b], env))
+      {
+        frame.pc = in.a;
+      }
+      break;
+    }
+  }
+}
+
+void Machine::call(Value& callee, size_t count, size_t below, bool tail, std::unique_ptr<Env>& env)
+{
+  std::span<Value> args{stack_.end() - count, stack_.end()};
+  if (callee.is_procedure())
+  {
+    if (auto* body{dynamic_cast<MachineBody*>(&callee.as_procedure().body())})
+    {
+      enter(body->function(), body->scope(), args, tail);
+      stack_.resize(stack_.size() - count - below);
+      return;
+    }
+    // only the Procedure around the first frame can take the call, the
+    // ret that follows a tail call leaves with the nil pushed for it
+    if (tail && frames_.size() == 1)
+    {
+      env->set_tail_call(callee.as_procedure(), {std::make_move_iterator(args.begin()),
+                                                 std::make_move_iterator(args.end())});
+      stack_.resize(stack_.size() - count - below);
+      stack_.push_back(Value{Nil{}});
+      return;
+    }
+  }
+  Value result{ASTCall::apply(callee, args, env)};
+  stack_.resize(stack_.size() - count - below);
+  stack_.push_back(std::move(result));
+}
+
+void Machine::enter(std::shared_ptr<const Function> function, std::shared_ptr<Scope> scope, std::span<Value> args,
+                    bool tail)
+{
+  if (args.size() != function->parameters)
+  {
+    throw std::runtime_error("wrong number of arguments passed to lambda");
+  }
+  if (tail)
+  {
+    Frame& frame{frames_.back()};
+    // the scope of a call of the same function that nothing closed over
+    // is used again
+    if (frame.function == function && frame.scope.use_count() == 1 && frame.scope->parent() == scope)
+    {
+      for (size_t i{0}; i < frame.scope->size(); ++i)
+      {
+        frame.scope->slot(i) = i < args.size() ? std::move(args[i]) : Value{};
+      }
+      frame.pc = 0;
+      return;
+    }
+    frames_.pop_back();
+  }
+  auto inner{std::make_shared<Scope>(std::move(scope), function->size)};
+  for (size_t i{0}; i < args.size(); ++i)
+  {
+    inner->slot(i) = std::move(args[i]);
+  }
+  frames_.push_back({std::move(function), 0, std::move(inner)});
+}
+
+Value MachineBody::call(std::span<Value> args, std::unique_ptr<Env>& env)
+{
+  return Machine{}.run(function_, scope_, args, env);
+}
@@ -0,0 +1,500 @@
+#include "engine/optimizer.h"
+#include "engine/builtin.h"
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace
+{
+std::vector<std::unique_ptr<AST>> take_children(AST& node)
+{
+  std::vector<std::unique_ptr<AST>> children;
+  node.replace_children([&](std::unique_ptr<AST> child) {
+    children.push_back(std::move(child));
+    return std::unique_ptr<AST>{};
+  });
+  return children;
+}
+
+// Adds a guard unless guards already has it
+void add_guard(ASTGuard::Guards& guards, const ASTGuard::Guards::value_type& guard)
+{
+  for (const auto& [name, version] : guards)
+  {
+    if (name == guard.first && (version == guard.second || (*version != 0 && *version == *guard.second)))
+    {
+      return;
+    }
+  }
+  guards.push_back(guard);
+}
+
+// The value of a constant, or of a fold, whose guards then go in guards
+bool constant(const AST& node, Value& value, ASTGuard::Guards& guards)
+{
+  if (auto* guard{dynamic_cast<const ASTGuard*>(&node)})
+  {
+    if (!constant(guard->fast(), value, guards))
+    {
+      return false;
+    }
+    for (const auto& held : guard->guards())
+    {
+      add_guard(guards, held);
+    }
+    return true;
+  }
+  if (auto* literal{dynamic_cast<const ASTConstant*>(&node)})
+  {
+    value = literal->value();
+    return true;
+  }
+  return false;
+}
+
+// The slots of the scope depth levels up that are set in node
+void assigned(const AST& node, size_t depth, std::set<size_t>& slots)
+{
+  if (auto* set{dynamic_cast<const ASTSetLocal*>(&node)}; set != nullptr && set->depth() == depth)
+  {
+    slots.insert(set->index());
+  }
+  bool lambda{dynamic_cast<const ASTProcedure*>(&node) != nullptr};
+  bool let{dynamic_cast<const ASTScope*>(&node) != nullptr};
+  std::vector<const AST*> children;
+  node.append_children(children);
+  for (size_t i{0}; i < children.size(); ++i)
+  {
+    bool inner{lambda || (let && i + 1 == children.size())};
+    assigned(*children[i], depth + (inner ? 1 : 0), slots);
+  }
+}
+
+// Whether node can be copied into a call of the global self, size counts
+// its nodes
+bool inlinable(const AST& node, AtomTable::Atom self, size_t& size)
+{
+  ++size;
+  if (auto* local{dynamic_cast<const ASTLocal*>(&node)})
+  {
+    return local->depth() == 0;
+  }
+  if (auto* global{dynamic_cast<const ASTGlobal*>(&node)})
+  {
+    return global->name() != self;
+  }
+  if (auto* set{dynamic_cast<const ASTSetGlobal*>(&node)}; set != nullptr && set->name() == self)
+  {
+    return false;
+  }
+  if (!dynamic_cast<const ASTConstant*>(&node) && !dynamic_cast<const ASTCall*>(&node) &&
+      !dynamic_cast<const ASTSetGlobal*>(&node) && !dynamic_cast<const ASTBlock*>(&node) &&
+      !dynamic_cast<const ASTGuard*>(&node) && node.type() != AST::Type::if_t)
+  {
+    return false;
+  }
+  std::vector<const AST*> children;
+  node.append_children(children);
+  for (const auto* child : children)
+  {
+    if (!inlinable(*child, self, size))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A copy of a node of the kinds inlinable() takes. With arguments, the
+// parameters are replaced with copies of them, and calls in tail position
+// only stay so when tail is.
+std::unique_ptr<AST> copy(const AST& node, const std::vector<std::unique_ptr<AST>>* arguments = nullptr,
+                          bool tail = true)
+{
+  if (auto* local{dynamic_cast<const ASTLocal*>(&node)})
+  {
+    if (arguments != nullptr)
+    {
+      return copy(*(*arguments)[local->index()]);
+    }
+    return std::make_unique<ASTLocal>(node, local->depth(), local->index());
+  }
+  if (auto* constant{dynamic_cast<const ASTConstant*>(&node)})
+  {
+    return std::make_unique<ASTConstant>(node, constant->value());
+  }
+  if (auto* global{dynamic_cast<const ASTGlobal*>(&node)})
+  {
+    return std::make_unique<ASTGlobal>(node, global->name());
+  }
+  if (auto* call{dynamic_cast<const ASTCall*>(&node)})
+  {
+    std::vector<std::unique_ptr<AST>> values;
+    for (const auto& argument : call->arguments())
+    {
+      values.push_back(copy(*argument, arguments, tail));
+    }
+    auto ret{std::make_unique<ASTCall>(node, copy(call->callee(), arguments, tail), std::move(values))};
+    ret->set_tail(call->tail() && tail);
+    return ret;
+  }
+  if (auto* set{dynamic_cast<const ASTSetGlobal*>(&node)})
+  {
+    return std::make_unique<ASTSetGlobal>(node, set->name(), copy(set->value(), arguments, tail));
+  }
+  if (auto* block{dynamic_cast<const ASTBlock*>(&node)})
+  {
+    std::vector<std::unique_ptr<AST>> statements;
+    for (const auto& statement : block->statements())
+    {
+      statements.push_back(copy(*statement, arguments, tail));
+    }
+    return std::make_unique<ASTBlock>(node, std::move(statements));
+  }
+  if (auto* guard{dynamic_cast<const ASTGuard*>(&node)})
+  {
+    return std::make_unique<ASTGuard>(node, guard->guards(), copy(guard->fast(), arguments, tail),
+                                      copy(guard->slow(), arguments, tail));
+  }
+  if (node.type() == AST::Type::if_t)
+  {
+    auto ret{std::make_unique<ASTIf>(node)};
+    std::vector<const AST*> parts;
+    node.append_children(parts);
+    for (const auto* part : parts)
+    {
+      ret->add_child(copy(*part, arguments, tail));
+    }
+    return ret;
+  }
+  throw std::runtime_error("Cannot inline a " + node.str());
+}
+
+// Whether the body reads each of the parameters in once exactly one time,
+// in that order, before anything that can have an effect or fail. Then
+// its arguments can be evaluated where it reads them.
+class ReadsInOrder
+{
+public:
+  ReadsInOrder(std::unique_ptr<Env>& env, const std::vector<size_t>& once) : env_{env}, once_{once} {}
+  bool operator()(const AST& body)
+  {
+    visit(body, true);
+    return ok_ && next_ == once_.size();
+  }
+private:
+  void visit(const AST& node, bool strict);
+
+  std::unique_ptr<Env>& env_;
+  const std::vector<size_t>& once_;
+  size_t next_{0};
+  // something that can have an effect or fail was evaluated
+  bool blocked_{false};
+  bool ok_{true};
+};
+
+void ReadsInOrder::visit(const AST& node, bool strict)
+{
+  if (auto* local{dynamic_cast<const ASTLocal*>(&node)})
+  {
+    bool once{false};
+    for (size_t parameter : once_)
+    {
+      once = once || parameter == local->index();
+    }
+    if (once)
+    {
+      ok_ = ok_ && strict && !blocked_ && next_ < once_.size() && once_[next_] == local->index();
+      ++next_;
+    }
+    return;
+  }
+  if (auto* global{dynamic_cast<const ASTGlobal*>(&node)})
+  {
+    // a global that is bound stays so
+    blocked_ = blocked_ || env_->global(global->name()) == nullptr;
+    return;
+  }
+  std::vector<const AST*> children;
+  node.append_children(children);
+  bool branches{node.type() == AST::Type::if_t || dynamic_cast<const ASTGuard*>(&node) != nullptr};
+  for (size_t i{0}; i < children.size(); ++i)
+  {
+    // only the test of an if is always evaluated
+    visit(*children[i], strict && (!branches || (node.type() == AST::Type::if_t && i == 0)));
+  }
+  if (dynamic_cast<const ASTCall*>(&node) || dynamic_cast<const ASTSetGlobal*>(&node))
+  {
+    blocked_ = true;
+  }
+}
+
+// Whether evaluating node can have no effect and cannot fail
+bool pure(const AST& node)
+{
+  if (dynamic_cast<const ASTConstant*>(&node) || dynamic_cast<const ASTLocal*>(&node) ||
+      dynamic_cast<const ASTProcedure*>(&node))
+  {
+    return true;
+  }
+  if (node.type() == AST::Type::if_t || dynamic_cast<const ASTBlock*>(&node))
+  {
+    std::vector<const AST*> children;
+    node.append_children(children);
+    for (const auto* child : children)
+    {
+      if (!pure(*child))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+  return false;
+}
+}
+
+Optimizer::Optimizer(std::unique_ptr<Env>& env) : env_{env}
+{
+}
+
+std::unique_ptr<AST> Optimizer::optimize(std::unique_ptr<AST> form)
+{
+  return drop(prune(fold(inline_calls(std::move(form)))), false);
+}
+
+std::unique_ptr<AST> Optimizer::inline_calls(std::unique_ptr<AST> node)
+{
+  bool lambda{dynamic_cast<ASTProcedure*>(node.get()) != nullptr};
+  bool let{dynamic_cast<ASTScope*>(node.get()) != nullptr};
+  std::vector<const AST*> children;
+  node->append_children(children);
+  size_t index{0};
+  node->replace_children([&](std::unique_ptr<AST> child) {
+    // the body of a lambda or let is a scope of its own
+    bool inner{lambda || (let && index + 1 == children.size())};
+    ++index;
+    if (inner)
+    {
+      assigned_.emplace_back();
+      assigned(*child, 0, assigned_.back());
+    }
+    child = inline_calls(std::move(child));
+    if (inner)
+    {
+      assigned_.pop_back();
+    }
+    return child;
+  });
+  if (auto* define{dynamic_cast<ASTDefineGlobal*>(node.get())})
+  {
+    learn(*define);
+    return node;
+  }
+  if (dynamic_cast<ASTCall*>(node.get()) == nullptr)
+  {
+    return node;
+  }
+  return inline_call(std::move(node));
+}
+
+std::unique_ptr<AST> Optimizer::inline_call(std::unique_ptr<AST> node)
+{
+  auto& call{static_cast<ASTCall&>(*node)};
+  auto* global{dynamic_cast<const ASTGlobal*>(&call.callee())};
+  auto known{global == nullptr ? inlinable_.end() : inlinable_.find(global->name())};
+  if (known == inlinable_.end() || known->second.parameters != call.arguments().size())
+  {
+    return node;
+  }
+  const Inlinable& lambda{known->second};
+  ASTGuard::Guards guards{{global->name(), lambda.version}};
+  std::vector<std::unique_ptr<AST>> arguments;
+  // the parameters whose arguments are evaluated where the body reads them
+  std::vector<size_t> once;
+  for (size_t i{0}; i < call.arguments().size(); ++i)
+  {
+    const AST& argument{*call.arguments()[i]};
+    if (trivial(argument))
+    {
+      arguments.push_back(copy(argument));
+      continue;
+    }
+    auto fast{simple(argument, guards)};
+    if (!fast)
+    {
+      return node;
+    }
+    arguments.push_back(std::move(fast));
+    once.push_back(i);
+  }
+  if (!ReadsInOrder{env_, once}(*lambda.body))
+  {
+    return node;
+  }
+  ++stats_.inlined;
+  auto body{copy(*lambda.body, &arguments, call.tail())};
+  return std::make_unique<ASTGuard>(*node, std::move(guards), std::move(body), std::move(node));
+}
+
+void Optimizer::learn(ASTDefineGlobal& define)
+{
+  inlinable_.erase(define.name());
+  auto* lambda{dynamic_cast<const ASTProcedure*>(&define.value())};
+  if (lambda == nullptr)
+  {
+    return;
+  }
+  // a body with defines of its own has slots beyond its parameters
+  const Code& code{*lambda->code()};
+  size_t size{0};
+  if (code.size != code.parameters || !inlinable(*code.body, define.name(), size) || size > inline_budget)
+  {
+    return;
+  }
+  auto version{std::make_shared<uint32_t>(0)};
+  define.set_version(version);
+  // a body of one statement is that statement, so a call of it can fold
+  auto* block{dynamic_cast<const ASTBlock*>(code.body.get())};
+  const AST& body{block != nullptr && block->statements().size() == 1 ? *block->statements()[0] : *code.body};
+  inlinable_.emplace(define.name(), Inlinable{code.parameters, copy(body), std::move(version)});
+}
+
+bool Optimizer::trivial(const AST& argument) const
+{
+  if (dynamic_cast<const ASTConstant*>(&argument))
+  {
+    return true;
+  }
+  // a local that nothing sets reads the same after the body made calls
+  auto* local{dynamic_cast<const ASTLocal*>(&argument)};
+  return local != nullptr && local->depth() < assigned_.size() &&
+    !assigned_[assigned_.size() - 1 - local->depth()].contains(local->index());
+}
+
+std::unique_ptr<AST> Optimizer::simple(const AST& argument, ASTGuard::Guards& guards) const
+{
+  if (dynamic_cast<const ASTConstant*>(&argument) || dynamic_cast<const ASTLocal*>(&argument))
+  {
+    return copy(argument);
+  }
+  if (auto* guard{dynamic_cast<const ASTGuard*>(&argument)})
+  {
+    for (const auto& held : guard->guards())
+    {
+      add_guard(guards, held);
+    }
+    return simple(guard->fast(), guards);
+  }
+  auto* call{dynamic_cast<const ASTCall*>(&argument)};
+  auto* global{call == nullptr ? nullptr : dynamic_cast<const ASTGlobal*>(&call->callee())};
+  Builtin op{global == nullptr ? Builtin::none : builtin(global->str())};
+  Value* callee{op == Builtin::none ? nullptr : env_->global(global->name())};
+  if (callee == nullptr || !is_builtin(*callee, op) || call->arguments().size() != 2)
+  {
+    return nullptr;
+  }
+  add_guard(guards, {global->name(), std::make_shared<const uint32_t>(env_->version(global->name()))});
+  std::vector<std::unique_ptr<AST>> values;
+  for (const auto& value : call->arguments())
+  {
+    values.push_back(simple(*value, guards));
+    if (!values.back())
+    {
+      return nullptr;
+    }
+  }
+  return std::make_unique<ASTCall>(argument, copy(call->callee()), std::move(values));
+}
+
+std::unique_ptr<AST> Optimizer::fold(std::unique_ptr<AST> node)
+{
+  node->replace_children([this](std::unique_ptr<AST> child) { return fold(std::move(child)); });
+  auto* call{dynamic_cast<ASTCall*>(node.get())};
+  if (call == nullptr || call->arguments().size() != 2)
+  {
+    return node;
+  }
+  auto* global{dynamic_cast<const ASTGlobal*>(&call->callee())};
+  Builtin op{global == nullptr ? Builtin::none : builtin(global->str())};
+  Value* callee{op == Builtin::none ? nullptr : env_->global(global->name())};
+  if (callee == nullptr || !is_builtin(*callee, op))
+  {
+    return node;
+  }
+  ASTGuard::Guards guards{{global->name(), std::make_shared<const uint32_t>(env_->version(global->name()))}};
+  Value a;
+  Value b;
+  if (!constant(*call->arguments()[0], a, guards) || !constant(*call->arguments()[1], b, guards) ||
+      !a.is_number() || !b.is_number())
+  {
+    return node;
+  }
+  ++stats_.folded;
+  auto value{std::make_unique<ASTConstant>(*node, arithmetic(op, a.as_number(), b.as_number()))};
+  return std::make_unique<ASTGuard>(*node, std::move(guards), std::move(value), std::move(node));
+}
+
+std::unique_ptr<AST> Optimizer::prune(std::unique_ptr<AST> node)
+{
+  node->replace_children([this](std::unique_ptr<AST> child) { return prune(std::move(child)); });
+  if (node->type() != AST::Type::if_t)
+  {
+    return node;
+  }
+  // a folded test is left, its guards may yet fail
+  std::vector<const AST*> parts;
+  node->append_children(parts);
+  auto* test{dynamic_cast<const ASTConstant*>(parts[0])};
+  if (test == nullptr)
+  {
+    return node;
+  }
+  Value value{test->value()};
+  auto children{take_children(*node)};
+  ++stats_.pruned;
+  return std::move(children[value.is_true() ? 1 : 2]);
+}
+
+std::unique_ptr<AST> Optimizer::drop(std::unique_ptr<AST> node, bool body)
+{
+  bool lambda{dynamic_cast<ASTProcedure*>(node.get()) != nullptr};
+  bool let{dynamic_cast<ASTScope*>(node.get()) != nullptr};
+  std::vector<const AST*> children;
+  node->append_children(children);
+  size_t index{0};
+  node->replace_children([&](std::unique_ptr<AST> child) {
+    // the body of a let comes after its values
+    bool inner{lambda || (let && index + 1 == children.size())};
+    ++index;
+    return drop(std::move(child), inner);
+  });
+  auto* block{dynamic_cast<ASTBlock*>(node.get())};
+  if (!body || block == nullptr)
+  {
+    return node;
+  }
+  auto statements{take_children(*node)};
+  std::vector<std::unique_ptr<AST>> kept;
+  for (size_t i{0}; i < statements.size(); ++i)
+  {
+    if (i + 1 < statements.size() && pure(*statements[i]))
+    {
+      ++stats_.dropped;
+    }
+    else
+    {
+      kept.push_back(std::move(statements[i]));
+    }
+  }
+  return std::make_unique<ASTBlock>(*node, std::move(kept));
+}
+
+std::ostream& operator<<(std::ostream& out, const Optimizer::Stats& stats)
+{
+  out << "inline: " << stats.inlined << " calls inlined\n"
+      << "fold: " << stats.folded << " calls folded\n"
+      << "prune: " << stats.pruned << " branches pruned\n"
+      << "drop: " << stats.dropped << " statements dropped\n";
+  return out;
+}
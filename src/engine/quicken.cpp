@@ -0,0 +1,299 @@
+#include "engine/quicken.h"
+#include <array>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+Value global_value(AtomTable::Atom name, std::unique_ptr<Env>& env)
+{
+  Value* value{env->global(name)};
+  if (value == nullptr)
+  {
+    throw std::runtime_error("Could not find symbol " + env->get_name(name));
+  }
+  return *value;
+}
+
+bool is_int(Value& value)
+{
+  return value.is_number() && value.as_number().is_int();
+}
+
+bool is_double(Value& value)
+{
+  return value.is_number() && !value.as_number().is_int();
+}
+
+// Evaluates arguments in order and passes them to f, a few of them stay
+// on the C++ stack
+template <typename F>
+Value with_arguments(std::vector<std::unique_ptr<AST>>& arguments, std::unique_ptr<Env>& env, F f)
+{
+  if (arguments.size() <= 4)
+  {
+    std::array<Value, 4> args;
+    for (size_t i{0}; i < arguments.size(); ++i)
+    {
+      args[i] = arguments[i]->eval(env);
+    }
+    return f(std::span<Value>{args.data(), arguments.size()});
+  }
+  std::vector<Value> args;
+  args.reserve(arguments.size());
+  for (auto& argument : arguments)
+  {
+    args.push_back(argument->eval(env));
+  }
+  return f(std::span<Value>{args});
+}
+
+std::vector<Value> evaluate(std::vector<std::unique_ptr<AST>>& arguments, std::unique_ptr<Env>& env)
+{
+  std::vector<Value> args;
+  args.reserve(arguments.size());
+  for (auto& argument : arguments)
+  {
+    args.push_back(argument->eval(env));
+  }
+  return args;
+}
+}
+
+std::unique_ptr<AST> Quickener::quicken(std::unique_ptr<AST> node)
+{
+  node->replace_children([this](std::unique_ptr<AST> child) { return quicken(std::move(child)); });
+  auto* call{dynamic_cast<ASTCall*>(node.get())};
+  if (call == nullptr)
+  {
+    return node;
+  }
+  auto* global{dynamic_cast<const ASTGlobal*>(&call->callee())};
+  if (global == nullptr)
+  {
+    return node;
+  }
+  AtomTable::Atom name{global->name()};
+  Builtin op{builtin(global->str())};
+  std::vector<std::unique_ptr<AST>> arguments;
+  call->replace_children([&](std::unique_ptr<AST> child) {
+    arguments.push_back(std::move(child));
+    return std::unique_ptr<AST>{};
+  });
+  // the first is the callee
+  arguments.erase(arguments.begin());
+  if (op != Builtin::none && arguments.size() == 2)
+  {
+    return std::make_unique<ASTQuickBuiltin>(*node, name, op, std::move(arguments[0]), std::move(arguments[1]));
+  }
+  return std::make_unique<ASTQuickCall>(*node, name, std::move(arguments), call->tail());
+}
+
+ASTQuickBuiltin::ASTQuickBuiltin(const AST& call, AtomTable::Atom name, Builtin op, std::unique_ptr<AST> left,
+                                 std::unique_ptr<AST> right) :
+  AST{call}, name_{name}, op_{op}, left_{std::move(left)}, right_{std::move(right)}, state_{State::unknown},
+  checked_{0}
+{
+}
+
+void ASTQuickBuiltin::append_children(std::vector<const AST*>& out) const
+{
+  out.push_back(left_.get());
+  out.push_back(right_.get());
+}
+
+void ASTQuickBuiltin::replace_children(const Replace& replace)
+{
+  left_ = replace(std::move(left_));
+  right_ = replace(std::move(right_));
+}
+
+ASTQuickBuiltin::State ASTQuickBuiltin::widen(Value& a, Value& b) const
+{
+  if (!a.is_number() || !b.is_number())
+  {
+    return State::generic;
+  }
+  State wanted{is_int(a) && is_int(b) ? State::ints : is_double(a) && is_double(b) ? State::doubles : State::numbers};
+  if (state_ == State::unknown || state_ == wanted)
+  {
+    return wanted;
+  }
+  // ints and doubles seen both take numbers
+  return state_ == State::generic ? State::generic : State::numbers;
+}
+
+Value ASTQuickBuiltin::call(Value& a, Value& b, std::unique_ptr<Env>& env)
+{
+  Value callee{global_value(name_, env)};
+  std::array<Value, 2> args{a, b};
+  return ASTCall::apply(callee, args, env);
+}
+
+Value ASTQuickBuiltin::eval(std::unique_ptr<Env>& env)
+{
+  if (state_ == State::generic)
+  {
+    // the callee is read before the arguments, like ASTCall does
+    Value callee{global_value(name_, env)};
+    std::array<Value, 2> args{left_->eval(env), right_->eval(env)};
+    return ASTCall::apply(callee, args, env);
+  }
+  if (env->version(name_) != checked_)
+  {
+    Value* callee{env->global(name_)};
+    if (callee == nullptr || !is_builtin(*callee, op_))
+    {
+      state_ = State::generic;
+      return eval(env);
+    }
+    checked_ = env->version(name_);
+  }
+  Value a{left_->eval(env)};
+  Value b{right_->eval(env)};
+  switch (state_)
+  {
+  case State::ints:
+    if (is_int(a) && is_int(b))
+    {
+      int x{a.as_number().as_int()};
+      int y{b.as_number().as_int()};
+      int r;
+      switch (op_)
+      {
+      case Builtin::add:
+        if (!__builtin_add_overflow(x, y, &r))
+        {
+          return Value{Number{r}};
+        }
+        break;
+      case Builtin::sub:
+        if (!__builtin_sub_overflow(x, y, &r))
+        {
+          return Value{Number{r}};
+        }
+        break;
+      case Builtin::mul:
+        if (!__builtin_mul_overflow(x, y, &r))
+        {
+          return Value{Number{r}};
+        }
+        break;
+      case Builtin::lt:
+        return Value{Boolean{x < y}};
+      case Builtin::gt:
+        return Value{Boolean{x > y}};
+      default:
+        return Value{Boolean{x == y}};
+      }
+      // an int that overflowed carries on as a double
+      state_ = State::numbers;
+      return arithmetic(op_, a.as_number(), b.as_number());
+    }
+    break;
+  case State::doubles:
+    if (is_double(a) && is_double(b))
+    {
+      double x{a.as_number().as_double()};
+      double y{b.as_number().as_double()};
+      switch (op_)
+      {
+      case Builtin::add:
+        return Value{Number{x + y}};
+      case Builtin::sub:
+        return Value{Number{x - y}};
+      case Builtin::mul:
+        return Value{Number{x * y}};
+      case Builtin::lt:
+        return Value{Boolean{x < y}};
+      case Builtin::gt:
+        return Value{Boolean{x > y}};
+      default:
+        return Value{Boolean{x == y}};
+      }
+    }
+    break;
+  case State::numbers:
+    if (a.is_number() && b.is_number())
+    {
+      return arithmetic(op_, a.as_number(), b.as_number());
+    }
+    break;
+  default:
+    break;
+  }
+  state_ = widen(a, b);
+  if (state_ == State::generic)
+  {
+    // the primitive has the error for it
+    return call(a, b, env);
+  }
+  return arithmetic(op_, a.as_number(), b.as_number());
+}
+
+ASTQuickCall::ASTQuickCall(const AST& call, AtomTable::Atom name, std::vector<std::unique_ptr<AST>> arguments,
+                           bool tail) :
+  AST{call}, name_{name}, arguments_{std::move(arguments)}, tail_{tail}, state_{State::unknown}, checked_{0}
+{
+}
+
+void ASTQuickCall::append_children(std::vector<const AST*>& out) const
+{
+  for (const auto& argument : arguments_)
+  {
+    out.push_back(argument.get());
+  }
+}
+
+void ASTQuickCall::replace_children(const Replace& replace)
+{
+  for (auto& argument : arguments_)
+  {
+    argument = replace(std::move(argument));
+  }
+}
+
+Value ASTQuickCall::eval(std::unique_ptr<Env>& env)
+{
+  if (state_ == State::procedure)
+  {
+    if (env->version(name_) == checked_)
+    {
+      // a copy, a call under this one may go generic and drop it
+      Procedure procedure{*procedure_};
+      if (tail_)
+      {
+        env->set_tail_call(std::move(procedure), evaluate(arguments_, env));
+        return Value{Nil{}};
+      }
+      return with_arguments(arguments_, env, [&](std::span<Value> args) { return procedure(args, env); });
+    }
+    state_ = State::generic;
+    procedure_.reset();
+  }
+  Value callee{global_value(name_, env)};
+  if (state_ == State::unknown)
+  {
+    if (callee.is_procedure())
+    {
+      procedure_ = callee.as_procedure();
+      checked_ = env->version(name_);
+      state_ = State::procedure;
+    }
+    else
+    {
+      state_ = State::generic;
+    }
+  }
+  if (tail_)
+  {
+    return ASTCall::tail_apply(callee, evaluate(arguments_, env), env);
+  }
+  return with_arguments(arguments_, env, [&](std::span<Value> args) { return ASTCall::apply(callee, args, env); });
+}
+
+Engine::Program QuickEngine::compile(std::unique_ptr<AST> form)
+{
+  std::shared_ptr<AST> tree{Quickener{}.quicken(std::move(form))};
+  return [tree](std::unique_ptr<Env>& env) { return tree->eval(env); };
+}
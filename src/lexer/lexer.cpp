@@ -1,9 +1,18 @@
 #include "lexer/lexer.h"
-#include <sstream>
+#include "lexer/keywords.h"
+#include <charconv>
+#include <cctype>
 #include <cstdlib>
+#include <string>
+#include <system_error>
 #include <iostream>
+#include <utility>
 
-Lexer::Lexer(std::string src) : StringHandler(src)
+Lexer::Lexer(std::string src) : StringHandler(std::move(src))
+{
+}
+
+Lexer::Lexer(std::unique_ptr<Source> source) : StringHandler(std::move(source))
 {
 }
 
@@ -23,52 +32,57 @@ bool Lexer::is_coment_start() const
 
 void Lexer::skip_non_tokens()
 {
-  if (is_coment_start())
+  skip_space();
+  while (!eof() && is_coment_start())
   {
-    while (!eof() && peek() != '\n')
-    {
-      next();
-    }
+    skip_line();
+    skip_space();
   }
-  skip_space();
 }
 
 Token Lexer::token()
 {
   if (!stack_.empty())
   {
-    Token ret = stack_.back();
+    Token ret{std::move(stack_.back())};
     stack_.pop_back();
     return ret;
   }
+  mark();
   skip_non_tokens();
+  mark();
+  return finish(read_token());
+}
+
+Token Lexer::read_token()
+{
   if (eof())
   {
-    return {Token::Type::END, "", line(), column()};
+    return {Token::Type::END, "", index()};
   }
   char current{peek()};
 
   if (current == '(')
   {
-    Token ret{Token::Type::open, "(", line(), column()};
+    Token ret{Token::Type::open, "(", index()};
     next();
     return ret;
   }
   if (current == ')')
   {
-    Token ret{Token::Type::close, ")", line(), column()};
+    Token ret{Token::Type::close, ")", index()};
     next();
     return ret;
   }
   if (current == '\'')
   {
-    Token ret{Token::Type::quote, "\'", line(), column()};
+    Token ret{Token::Type::quote, "\'", index()};
     next();
     return ret;
   }
   if (current == '.' && !std::isdigit(peek(1)))
   {
-    Token ret{Token::Type::dot, ".", line(), column()};
+    Token ret{Token::Type::dot, ".", index()};
     next();
     return ret;
   }
@@ -88,42 +102,70 @@ Token Lexer::token()
   return get_symbol();
 }
 
+Token Lexer::finish(Token token) const
+{
+  if (!stable() && !token.owns_text())
+  {
+    token.set_owned(std::string{token.string()});
+  }
+  return token;
+}
+
 void Lexer::push_back(Token token)
 {
-  stack_.push_back(token);
+  stack_.push_back(std::move(token));
 }
 
 Token Lexer::get_string()
 {
-  size_t l{line()}, c{column()};
+  size_t offset{index()};
   next(); // get rid of the open parenthesis
 
-  std::stringstream ss;
-  while (!eof())
+  // Most literals have no escapes, those are returned as a view of the source
+  // and only the rest pay for building their own unescaped copy.
+  size_t start{index()};
+  std::string unescaped;
+  bool escaped{false};
+  while (true)
   {
-    char c{peek()};
-    if (c == '"')
+    size_t run{index()};
+    skip_string_chars();
+    if (escaped)
+    {
+      unescaped += slice(run, index());
+    }
+    if (eof() || peek() == '"')
     {
       break;
     }
-    if (c == '\\')
+    // an escape, the char after the '\\' is taken as is
+    if (!escaped)
     {
-      next();
-      c = peek();
+      escaped = true;
+      unescaped = slice(start, index());
     }
-    ss << c;
     next();
+    if (!eof())
+    {
+      unescaped += next();
+    }
   }
 
-  return {Token::Type::string, ss.str(), l, c};
+  Token ret{Token::Type::string, slice(start, index()), offset};
+  if (escaped)
+  {
+    ret.set_owned(std::move(unescaped));
+  }
+  return ret;
 }
 
 Token Lexer::get_number()
 {
-  size_t l{line()}, c{column()};
-  std::stringstream ss;
+  size_t offset{index()};
+  size_t start{index()};
   bool exp{false}, dot{false};
-  ss << next();
+  char first{next()};
+  dot = first == '.';
   while (!eof())
   {
     if (is_space())
@@ -133,76 +175,79 @@ Token Lexer::get_number()
     char current{peek()};
     if (std::isdigit(current))
     {
-      ss << next();
+      next();
       continue;
     }
     if ((current == 'e' || current == 'E') && !exp)
     {
       exp = true;
-      ss << next();
+      next();
+      if (peek() == '-' || peek() == '+')
+      {
+        next();
+      }
     }
     else if (current == '.' && !dot)
     {
       dot = true;
-      ss << next();
+      next();
     }
     else
     {
       break;
     }
   }
-  char* end;
-  double d = std::strtod(ss.str().c_str(), &end);
-  return {Token::Type::number, "", l, c, d};
-}
-
-Token Lexer::get_symbol()
-{
-  size_t l{line()}, c{column()};
-  std::stringstream ss;
-  while (!eof())
+  std::string_view text{slice(start, index())};
+  // from_chars does not take a leading '+'
+  std::string_view digits{first == '+' ? text.substr(1) : text};
+  const char* begin{digits.data()};
+  const char* end{digits.data() + digits.size()};
+  if (!exp && !dot)
   {
-    if (is_space())
+    int i{0};
+    if (std::from_chars(begin, end, i).ec == std::errc{})
     {
-      break;
-    }
-    char c{peek()};
-    if (c == ')')
-    {
-      break;
+      return {Token::Type::number, text, offset, i};
     }
-    ss << next();
-  }
-  std::string compare{ss.str()};
-  if (compare == "set")
-  {
-    return {Token::Type::set, compare, l, c};
+    // too big for an int, it is still a fine double
   }
-  if (compare == "define")
+  double d{0.0};
+  if (std::from_chars(begin, end, d).ec == std::errc::result_out_of_range)
   {
-    return {Token::Type::define, compare, l, c};
+    // from_chars leaves d alone, strtod gives inf or 0 as it always did
+    d = std::strtod(std::string{digits}.c_str(), nullptr);
   }
-  if (compare == "nil")
-  {
-    return {Token::Type::nil, compare, l, c};
-  }
-  if (compare == "if")
-  {
-    return {Token::Type::if_t, compare, l, c};
-  }
-  if (compare == "quote")
-  {
-    return {Token::Type::quote, compare, l, c};
-  }
-  if (compare == "let")
-  {
-    return {Token::Type::let, compare, l, c};
-  }
-  if (compare == "lambda")
+  return {Token::Type::number, text, offset, d};
+}
+
+Token Lexer::get_symbol()
+{
+  size_t offset{index()};
+  size_t start{index()};
+  skip_symbol();
+  std::string_view text{slice(start, index())};
+  switch (classify_keyword(text))
   {
-    return {Token::Type::lambda, compare, l, c};
+  case Keyword::set:
+    return {Token::Type::set, text, offset};
+  case Keyword::define:
+    return {Token::Type::define, text, offset};
+  case Keyword::nil:
+    return {Token::Type::nil, text, offset};
+  case Keyword::if_t:
+    return {Token::Type::if_t, text, offset};
+  case Keyword::quote:
+    return {Token::Type::quote, text, offset};
+  case Keyword::let:
+    return {Token::Type::let, text, offset};
+  case Keyword::lambda:
+    return {Token::Type::lambda, text, offset};
+  case Keyword::true_t:
+  case Keyword::false_t:
+  case Keyword::none:
+    break;
   }
-  return {Token::Type::symbol, compare, l, c};
+  return {Token::Type::symbol, text, offset};
 }
 
 bool Lexer::is_number_start() const
@@ -0,0 +1,40 @@
+#include "lexer/line_index.h"
+#include "lexer/scan.h"
+#include <algorithm>
+
+void LineIndex::add(std::string_view text, size_t base)
+{
+  if (base + text.size() <= end_)
+  {
+    return;
+  }
+  size_t from{end_ > base ? end_ - base : 0};
+  const scan::Kernels& kernels{scan::kernels()};
+  if (newlines_.empty())
+  {
+    // a whole input is usually added in one go, size the table for it once
+    newlines_.reserve(kernels.count_lines(text.data() + from, text.size() - from).count);
+  }
+  while (from < text.size())
+  {
+    size_t at{from + kernels.newline(text.data() + from, text.size() - from)};
+    if (at == text.size())
+    {
+      break;
+    }
+    newlines_.push_back(base + at);
+    from = at + 1;
+  }
+  end_ = base + text.size();
+}
+
+Position LineIndex::position(size_t offset) const
+{
+  auto at{std::lower_bound(newlines_.begin(), newlines_.end(), offset)};
+  size_t before{static_cast<size_t>(at - newlines_.begin())};
+  if (before == 0)
+  {
+    return {1, offset + 1};
+  }
+  return {before + 1, offset - newlines_[before - 1]};
+}
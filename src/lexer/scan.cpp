@@ -0,0 +1,316 @@
+#include "lexer/scan.h"
+#include <cstdint>
+#include <initializer_list>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TYSON_SCAN_X86 1
+#endif
+
+namespace
+{
+bool is_space(unsigned char c)
+{
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+size_t scalar_skip_space(const char* data, size_t size)
+{
+  size_t i{0};
+  while (i < size && is_space(data[i]))
+  {
+    ++i;
+  }
+  return i;
+}
+
+size_t scalar_symbol_end(const char* data, size_t size)
+{
+  size_t i{0};
+  while (i < size && data[i] != ')' && !is_space(data[i]))
+  {
+    ++i;
+  }
+  return i;
+}
+
+size_t scalar_string_end(const char* data, size_t size)
+{
+  size_t i{0};
+  while (i < size && data[i] != '"' && data[i] != '\\')
+  {
+    ++i;
+  }
+  return i;
+}
+
+size_t scalar_newline(const char* data, size_t size)
+{
+  size_t i{0};
+  while (i < size && data[i] != '\n')
+  {
+    ++i;
+  }
+  return i;
+}
+
+scan::Lines scalar_count_lines(const char* data, size_t size)
+{
+  scan::Lines ret{0, 0};
+  for (size_t i{0}; i < size; ++i)
+  {
+    if (data[i] == '\n')
+    {
+      ++ret.count;
+      ret.last = i;
+    }
+  }
+  return ret;
+}
+
+const scan::Kernels scalar_kernels{
+  "scalar", scalar_skip_space, scalar_symbol_end, scalar_string_end,
+  scalar_newline, scalar_count_lines
+};
+
+#ifdef TYSON_SCAN_X86
+// Every kernel builds a bit mask of the interesting chars in a block and
+// looks at its lowest set bit, the tail shorter than a block is scalar.
+
+__m128i sse2_space_mask(__m128i v)
+{
+  // '\t'..'\r' are the five chars from 9, check them with one unsigned compare
+  __m128i shifted{_mm_sub_epi8(v, _mm_set1_epi8('\t'))};
+  __m128i control{_mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted)};
+  return _mm_or_si128(control, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+}
+
+size_t sse2_skip_space(const char* data, size_t size)
+{
+  size_t i{0};
+  for (; i + 16 <= size; i += 16)
+  {
+    __m128i v{_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))};
+    unsigned mask{~static_cast<unsigned>(_mm_movemask_epi8(sse2_space_mask(v))) & 0xffff};
+    if (mask != 0)
+    {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i + scalar_skip_space(data + i, size - i);
+}
+
+size_t sse2_symbol_end(const char* data, size_t size)
+{
+  size_t i{0};
+  for (; i + 16 <= size; i += 16)
+  {
+    __m128i v{_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))};
+    __m128i hit{_mm_or_si128(sse2_space_mask(v), _mm_cmpeq_epi8(v, _mm_set1_epi8(')')))};
+    unsigned mask{static_cast<unsigned>(_mm_movemask_epi8(hit))};
+    if (mask != 0)
+    {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i + scalar_symbol_end(data + i, size - i);
+}
+
+size_t sse2_string_end(const char* data, size_t size)
+{
+  size_t i{0};
+  for (; i + 16 <= size; i += 16)
+  {
+    __m128i v{_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))};
+    __m128i hit{_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                             _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')))};
+    unsigned mask{static_cast<unsigned>(_mm_movemask_epi8(hit))};
+    if (mask != 0)
+    {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i + scalar_string_end(data + i, size - i);
+}
+
+size_t sse2_newline(const char* data, size_t size)
+{
+  size_t i{0};
+  for (; i + 16 <= size; i += 16)
+  {
+    __m128i v{_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))};
+    unsigned mask{static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))))};
+    if (mask != 0)
+    {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i + scalar_newline(data + i, size - i);
+}
+
+scan::Lines sse2_count_lines(const char* data, size_t size)
+{
+  scan::Lines ret{0, 0};
+  size_t i{0};
+  for (; i + 16 <= size; i += 16)
+  {
+    __m128i v{_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))};
+    unsigned mask{static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))))};
+    if (mask != 0)
+    {
+      ret.count += __builtin_popcount(mask);
+      ret.last = i + 31 - __builtin_clz(mask);
+    }
+  }
+  scan::Lines tail{scalar_count_lines(data + i, size - i)};
+  if (tail.count > 0)
+  {
+    ret.count += tail.count;
+    ret.last = i + tail.last;
+  }
+  return ret;
+}
+
+const scan::Kernels sse2_kernels{
+  "sse2", sse2_skip_space, sse2_symbol_end, sse2_string_end,
+  sse2_newline, sse2_count_lines
+};
+
+#define TYSON_AVX2 __attribute__((target("avx2,popcnt")))
+
+TYSON_AVX2 __m256i avx2_space_mask(__m256i v)
+{
+  __m256i shifted{_mm256_sub_epi8(v, _mm256_set1_epi8('\t'))};
+  __m256i control{_mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(4)), shifted)};
+  return _mm256_or_si256(control, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+}
+
+TYSON_AVX2 size_t avx2_skip_space(const char* data, size_t size)
+{
+  size_t i{0};
+  for (; i + 32 <= size; i += 32)
+  {
+    __m256i v{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i))};
+    uint32_t mask{~static_cast<uint32_t>(_mm256_movemask_epi8(avx2_space_mask(v)))};
+    if (mask != 0)
+    {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i + sse2_skip_space(data + i, size - i);
+}
+
+TYSON_AVX2 size_t avx2_symbol_end(const char* data, size_t size)
+{
+  size_t i{0};
+  for (; i + 32 <= size; i += 32)
+  {
+    __m256i v{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i))};
+    __m256i hit{_mm256_or_si256(avx2_space_mask(v), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(')')))};
+    uint32_t mask{static_cast<uint32_t>(_mm256_movemask_epi8(hit))};
+    if (mask != 0)
+    {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i + sse2_symbol_end(data + i, size - i);
+}
+
+TYSON_AVX2 size_t avx2_string_end(const char* data, size_t size)
+{
+  size_t i{0};
+  for (; i + 32 <= size; i += 32)
+  {
+    __m256i v{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i))};
+    __m256i hit{_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')))};
+    uint32_t mask{static_cast<uint32_t>(_mm256_movemask_epi8(hit))};
+    if (mask != 0)
+    {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i + sse2_string_end(data + i, size - i);
+}
+
+TYSON_AVX2 size_t avx2_newline(const char* data, size_t size)
+{
+  size_t i{0};
+  for (; i + 32 <= size; i += 32)
+  {
+    __m256i v{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i))};
+    uint32_t mask{static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))))};
+    if (mask != 0)
+    {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i + sse2_newline(data + i, size - i);
+}
+
+TYSON_AVX2 scan::Lines avx2_count_lines(const char* data, size_t size)
+{
+  scan::Lines ret{0, 0};
+  size_t i{0};
+  for (; i + 32 <= size; i += 32)
+  {
+    __m256i v{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i))};
+    uint32_t mask{static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))))};
+    if (mask != 0)
+    {
+      ret.count += __builtin_popcount(mask);
+      ret.last = i + 31 - __builtin_clz(mask);
+    }
+  }
+  scan::Lines tail{sse2_count_lines(data + i, size - i)};
+  if (tail.count > 0)
+  {
+    ret.count += tail.count;
+    ret.last = i + tail.last;
+  }
+  return ret;
+}
+
+const scan::Kernels avx2_kernels{
+  "avx2", avx2_skip_space, avx2_symbol_end, avx2_string_end,
+  avx2_newline, avx2_count_lines
+};
+#endif
+}
+
+const scan::Kernels* scan::kernels(Isa isa)
+{
+  switch (isa)
+  {
+  case Isa::scalar:
+    return &scalar_kernels;
+#ifdef TYSON_SCAN_X86
+  case Isa::sse2:
+    return &sse2_kernels;
+  case Isa::avx2:
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+    {
+      return &avx2_kernels;
+    }
+    return nullptr;
+#else
+  default:
+    return nullptr;
+#endif
+  }
+  return nullptr;
+}
+
+const scan::Kernels& scan::kernels()
+{
+  static const Kernels& best{[]() -> const Kernels& {
+    for (Isa isa : {Isa::avx2, Isa::sse2})
+    {
+      if (const Kernels* k{kernels(isa)})
+      {
+        return *k;
+      }
+    }
+    return scalar_kernels;
+  }()};
+  return best;
+}
@@ -0,0 +1,127 @@
+#include "lexer/source.h"
+#include <stdexcept>
+#include <utility>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::unique_ptr<Source> Source::from_string(std::string text)
+{
+  return std::make_unique<StringSource>(std::move(text));
+}
+
+std::unique_ptr<Source> Source::from_view(std::string_view text, size_t base)
+{
+  return std::make_unique<ViewSource>(text, base);
+}
+
+std::unique_ptr<Source> Source::from_file(const std::string& path)
+{
+  return std::make_unique<MappedSource>(path);
+}
+
+std::unique_ptr<Source> Source::from_stream(std::istream& in, size_t chunk)
+{
+  return std::make_unique<StreamSource>([&in](char* buffer, size_t size) -> size_t {
+      in.read(buffer, size);
+      return in.gcount();
+    }, chunk);
+}
+
+std::unique_ptr<Source> Source::from_fd(int fd, size_t chunk)
+{
+  return std::make_unique<StreamSource>([fd](char* buffer, size_t size) -> size_t {
+      while (true)
+      {
+        ssize_t n{::read(fd, buffer, size)};
+        if (n >= 0)
+        {
+          return n;
+        }
+        if (errno != EINTR)
+        {
+          throw std::runtime_error(std::string{"read failed: "} + std::strerror(errno));
+        }
+      }
+    }, chunk);
+}
+
+StringSource::StringSource(std::string text) : text_{std::move(text)}
+{
+  window_ = text_;
+}
+
+ViewSource::ViewSource(std::string_view text, size_t base)
+{
+  window_ = text;
+  base_ = base;
+}
+
+MappedSource::MappedSource(const std::string& path) :
+  data_{nullptr}, size_{0}
+{
+  int fd{::open(path.c_str(), O_RDONLY)};
+  if (fd < 0)
+  {
+    throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0)
+  {
+    ::close(fd);
+    throw std::runtime_error("Could not stat " + path + ": " + std::strerror(errno));
+  }
+  size_ = st.st_size;
+  if (size_ > 0)
+  {
+    data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data_ == MAP_FAILED)
+    {
+      ::close(fd);
+      throw std::runtime_error("Could not map " + path + ": " + std::strerror(errno));
+    }
+    ::madvise(data_, size_, MADV_SEQUENTIAL);
+    window_ = {static_cast<const char*>(data_), size_};
+  }
+  ::close(fd);
+}
+
+MappedSource::~MappedSource()
+{
+  if (data_ != nullptr)
+  {
+    ::munmap(data_, size_);
+  }
+}
+
+StreamSource::StreamSource(Reader reader, size_t chunk) :
+  reader_{std::move(reader)}, chunk_{chunk == 0 ? 1 : chunk}, done_{false}
+{
+}
+
+bool StreamSource::fill(size_t keep)
+{
+  if (done_)
+  {
+    return false;
+  }
+  size_t drop{keep > base_ ? keep - base_ : 0};
+  drop = std::min(drop, buffer_.size());
+  buffer_.erase(0, drop);
+  base_ += drop;
+
+  size_t old{buffer_.size()};
+  buffer_.resize(old + chunk_);
+  size_t n{reader_(buffer_.data() + old, chunk_)};
+  buffer_.resize(old + n);
+  window_ = buffer_;
+  if (n == 0)
+  {
+    done_ = true;
+    return false;
+  }
+  return true;
+}
@@ -1,17 +1,47 @@
 #include "lexer/string_handler.h"
 #include <utility>
 #include <cctype>
+#include <algorithm>
 
 StringHandler::StringHandler(std::string text) :
-  text_{std::move(text)}, index_{0}, line_{1}, column_{1}
+  StringHandler{Source::from_string(std::move(text))}
 {
 }
 
-
+StringHandler::StringHandler(std::unique_ptr<Source> source) :
+  source_{std::move(source)}, text_{source_->window()}, index_{0}, mark_{0},
+  kernels_{&scan::kernels()}
+{
+}
 
 bool StringHandler::eof(size_t forward) const
 {
-  return index_ + forward >= text_.size();
+  if (index_ + forward < text_.size())
+  {
+    return false;
+  }
+  return !fill(forward);
+}
+
+bool StringHandler::fill(size_t forward) const
+{
+  while (index_ + forward >= text_.size())
+  {
+    size_t base{source_->base()};
+    // a sliding window drops text, get its newlines while it is still here
+    if (!source_->stable())
+    {
+      lines_.add(text_, base);
+    }
+    bool more{source_->fill(std::min(mark_, base + index_))};
+    index_ -= source_->base() - base;
+    text_ = source_->window();
+    if (!more)
+    {
+      return index_ + forward < text_.size();
+    }
+  }
+  return true;
 }
 
 char StringHandler::peek(size_t forward) const
@@ -27,15 +57,14 @@ char StringHandler::next()
 {
   char ret{peek()};
   ++index_;
-  ++column_;
-  if (ret == '\n')
-  {
-    ++line_;
-    column_ = 1;
-  }
   return ret;
 }
 
+std::string_view StringHandler::slice(size_t from, size_t to) const
+{
+  return text_.substr(from - source_->base(), to - from);
+}
+
 bool StringHandler::is_space() const
 {
   char c{peek()};
@@ -43,15 +72,26 @@ bool StringHandler::is_space() const
 }
 
 void StringHandler::skip_space()
+{
+  skip(kernels_->skip_space);
+}
+
+void StringHandler::skip(size_t (*find)(const char* data, size_t size))
 {
   while (!eof())
   {
-    if (is_space())
+    size_t available{text_.size() - index_};
+    size_t count{find(text_.data() + index_, available)};
+    index_ += count;
+    if (count < available)
     {
-      next();
-      continue;
+      break;
     }
-    break;
   }
 }
 
+Position StringHandler::position(size_t offset) const
+{
+  lines_.add(text_, source_->base());
+  return lines_.position(offset);
+}
@@ -1,7 +1,27 @@
 #include "lexer/token.h"
+#include <utility>
+#include <cmath>
 
-Token::Token(Type type, const std::string& text, size_t line, size_t column,
-             std::optional<double> num) :
-  type_{type}, text_{text}, number_{num}, line_{line}, column_{column}
+Token::Token(Type type, std::string_view text, size_t offset, Numeric num) :
+  type_{type}, text_{text}, owns_text_{false}, number_{num}, offset_{offset}
 {
 }
+
+void Token::set_owned(std::string text)
+{
+  owned_ = std::move(text);
+  owns_text_ = true;
+}
+
+double Token::number() const
+{
+  if (std::holds_alternative<int>(number_))
+  {
+    return std::get<int>(number_);
+  }
+  if (std::holds_alternative<double>(number_))
+  {
+    return std::get<double>(number_);
+  }
+  return std::nan("no number");
+}
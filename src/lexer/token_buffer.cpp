@@ -0,0 +1,263 @@
+#include "lexer/token_buffer.h"
+#include "lexer/lexer.h"
+#include "util/thread_pool.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+constexpr uint32_t no_extra{std::numeric_limits<uint32_t>::max()};
+// a guess at the density of tokens, most programs have one every 4 to 8 chars
+constexpr size_t chars_per_token{6};
+}
+
+TokenBuffer::TokenBuffer(std::string text) :
+  TokenBuffer{Source::from_string(std::move(text))}
+{
+}
+
+TokenBuffer::TokenBuffer(std::unique_ptr<Source> source) :
+  source_{std::move(source)}
+{
+  load();
+  tokenize();
+  lines_.add(text_, 0);
+}
+
+TokenBuffer::TokenBuffer(std::unique_ptr<Source> source, ThreadPool& pool, size_t chunk) :
+  source_{std::move(source)}
+{
+  load();
+  tokenize(pool, chunk);
+  lines_.add(text_, 0);
+}
+
+void TokenBuffer::load()
+{
+  if (!source_->stable())
+  {
+    // keeping everything from the start makes the window the whole input
+    while (source_->fill(source_->base()))
+    {
+    }
+  }
+  text_ = source_->window();
+  if (text_.size() >= std::numeric_limits<uint32_t>::max())
+  {
+    throw std::runtime_error("input too large for a token buffer");
+  }
+}
+
+void TokenBuffer::tokenize()
+{
+  tokens_.reserve(text_.size() / chars_per_token + 1);
+  Lexer lexer{Source::from_view(text_)};
+  while (true)
+  {
+    Token token{lexer.token()};
+    tokens_.add(token);
+    if (token.type() == Token::Type::END)
+    {
+      break;
+    }
+  }
+}
+
+namespace
+{
+// What a chunk lexed on its own, from the start of its first line
+struct Chunk
+{
+  size_t begin;
+  size_t end;
+  // the offset of the first token past the chunk, where the next one picks up
+  size_t resume;
+};
+}
+
+// The chunks start at line starts, so each one can be lexed on its own as
+// long as its first line is not in the middle of a multi-line string. The
+// lexer is the same from any token start on, so the stitching checks that
+// the token the previous chunk ended before is one the chunk found too and
+// takes its tokens from there. When it is not, the chunk is lexed again
+// from the right place until it runs into one of its own tokens.
+void TokenBuffer::tokenize(ThreadPool& pool, size_t chunk)
+{
+  if (chunk == 0)
+  {
+    chunk = 1;
+  }
+  std::vector<Chunk> chunks;
+  size_t begin{0};
+  while (begin < text_.size())
+  {
+    size_t end{text_.size()};
+    if (text_.size() - begin > chunk)
+    {
+      end = text_.find('\n', begin + chunk);
+      end = end == std::string_view::npos ? text_.size() : end + 1;
+    }
+    chunks.push_back({begin, end, end});
+    begin = end;
+  }
+  if (chunks.size() < 2)
+  {
+    tokenize();
+    return;
+  }
+
+  std::vector<Columns> parts(chunks.size());
+  pool.run(chunks.size(), [&](size_t i) {
+    Chunk& part{chunks[i]};
+    parts[i].reserve((part.end - part.begin) / chars_per_token + 1);
+    // lexing runs past the end to finish the last token
+    Lexer lexer{Source::from_view(text_.substr(part.begin), part.begin)};
+    while (true)
+    {
+      Token token{lexer.token()};
+      if (token.type() == Token::Type::END || token.offset() >= part.end)
+      {
+        part.resume = token.offset();
+        break;
+      }
+      parts[i].add(token);
+    }
+  });
+
+  tokens_.reserve(text_.size() / chars_per_token + 1);
+  tokens_.append(parts[0], 0, parts[0].types.size());
+  size_t expected{chunks[0].resume};
+  for (size_t i{1}; i < chunks.size(); ++i)
+  {
+    const Chunk& part{chunks[i]};
+    const Columns& speculative{parts[i]};
+    if (expected >= part.end)
+    {
+      // a token from before covers the whole chunk
+      continue;
+    }
+    auto sync = [&](size_t offset) {
+      auto found{std::lower_bound(speculative.offsets.begin(), speculative.offsets.end(), offset)};
+      if (found == speculative.offsets.end() || *found != offset)
+      {
+        return false;
+      }
+      tokens_.append(speculative, found - speculative.offsets.begin(), speculative.offsets.size());
+      expected = part.resume;
+      return true;
+    };
+    if (sync(expected))
+    {
+      continue;
+    }
+    Lexer lexer{Source::from_view(text_.substr(expected), expected)};
+    while (true)
+    {
+      Token token{lexer.token()};
+      if (token.type() == Token::Type::END || token.offset() >= part.end)
+      {
+        expected = token.offset();
+        break;
+      }
+      if (sync(token.offset()))
+      {
+        break;
+      }
+      tokens_.add(token);
+    }
+  }
+  // the last chunk always runs into END, an unclosed string leaves it one
+  // past the end of the input
+  tokens_.add(Token{Token::Type::END, "", expected});
+}
+
+void TokenBuffer::Columns::reserve(size_t count)
+{
+  types.reserve(count);
+  offsets.reserve(count);
+  lengths.reserve(count);
+  extra.reserve(count);
+}
+
+void TokenBuffer::Columns::add(const Token& token)
+{
+  // Every other token is its length many chars of the input from its offset,
+  // or from right after the quote for strings
+  std::string_view text{token.string()};
+  uint32_t index{no_extra};
+  uint32_t length{static_cast<uint32_t>(text.size())};
+  if (token.type() == Token::Type::number)
+  {
+    index = numbers.size();
+    numbers.push_back(token.is_integer() ? Token::Numeric{token.integer()} : Token::Numeric{token.number()});
+  }
+  else if (token.owns_text())
+  {
+    index = strings.size();
+    strings.emplace_back(text);
+  }
+  types.push_back(static_cast<uint8_t>(token.type()));
+  offsets.push_back(token.offset());
+  lengths.push_back(length);
+  extra.push_back(index);
+}
+
+void TokenBuffer::Columns::append(const Columns& other, size_t from, size_t to)
+{
+  types.insert(types.end(), other.types.begin() + from, other.types.begin() + to);
+  offsets.insert(offsets.end(), other.offsets.begin() + from, other.offsets.begin() + to);
+  lengths.insert(lengths.end(), other.lengths.begin() + from, other.lengths.begin() + to);
+  for (size_t i{from}; i < to; ++i)
+  {
+    uint32_t index{other.extra[i]};
+    if (index != no_extra)
+    {
+      if (other.types[i] == static_cast<uint8_t>(Token::Type::number))
+      {
+        index = numbers.size();
+        numbers.push_back(other.numbers[other.extra[i]]);
+      }
+      else
+      {
+        index = strings.size();
+        strings.push_back(other.strings[other.extra[i]]);
+      }
+    }
+    extra.push_back(index);
+  }
+}
+
+std::string_view TokenBuffer::text(size_t index) const
+{
+  if (type(index) == Token::Type::END)
+  {
+    // after an unclosed string END is past the end of the input
+    return {};
+  }
+  if (type(index) == Token::Type::string)
+  {
+    if (tokens_.extra[index] != no_extra)
+    {
+      return tokens_.strings[tokens_.extra[index]];
+    }
+    // skip the opening quote
+    return text_.substr(tokens_.offsets[index] + 1, tokens_.lengths[index]);
+  }
+  return text_.substr(tokens_.offsets[index], tokens_.lengths[index]);
+}
+
+Token TokenBuffer::token(size_t index) const
+{
+  if (index >= size())
+  {
+    index = size() - 1;
+  }
+  Token::Numeric number{};
+  if (type(index) == Token::Type::number)
+  {
+    number = tokens_.numbers[tokens_.extra[index]];
+  }
+  return {type(index), text(index), tokens_.offsets[index], number};
+}
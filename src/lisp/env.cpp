@@ -1,14 +1,19 @@
 #include "lisp/env.h"
 
 Env::Env(std::shared_ptr<Frame> current) :
-  current_{current}, had_error_{false}
+  current_{current}, global_{current}, had_error_{false}
 {
+  while (global_->parent() != nullptr)
+  {
+    global_ = global_->parent();
+  }
 }
 
 Env::Env() :
   current_{nullptr}, had_error_{false}
 {
   current_ = std::make_shared<Frame>(symbols_, nullptr, true);
+  global_ = current_;
   load_primitives();
 }
 
@@ -34,6 +39,11 @@ void Env::define(const std::string& name, Value val)
   current_->define(name, val);
 }
 
+void Env::define(AtomTable::Atom id, Value val)
+{
+  current_->define(id, val);
+}
+
 void Env::set(const std::string& name, Value val)
 {
   auto id{current_->symbols().intern(name)};
@@ -66,6 +76,34 @@ void Env::pop()
   }
 }
 
+void Env::set_tail_call(Procedure callee, std::vector<Value> args)
+{
+  tail_call_.emplace(TailCall{std::move(callee), std::move(args)});
+}
+
+TailCall Env::take_tail_call()
+{
+  TailCall call{std::move(*tail_call_)};
+  tail_call_.reset();
+  return call;
+}
+
+bool Env::rerun(const Body& body, const std::shared_ptr<Scope>& scope, size_t parameters)
+{
+  if (!tail_call_ || &tail_call_->callee.body() != &body || tail_call_->args.size() != parameters ||
+      scope.use_count() != 1)
+  {
+    return false;
+  }
+  auto& args{tail_call_->args};
+  for (size_t i{0}; i < scope->size(); ++i)
+  {
+    scope->slot(i) = i < args.size() ? std::move(args[i]) : Value{};
+  }
+  tail_call_.reset();
+  return true;
+}
+
 AtomTable::Atom Env::intern(const std::string& symbol)
 {
   return symbols_.intern(symbol);
@@ -86,3 +124,14 @@ ScopedEnv::~ScopedEnv()
   env_.pop();
 }
 
+
+EnteredScope::EnteredScope(Env& env, std::shared_ptr<Scope> scope) :
+  env_{env}, outer_{env.scope()}
+{
+  env_.set_scope(std::move(scope));
+}
+
+EnteredScope::~EnteredScope()
+{
+  env_.set_scope(std::move(outer_));
+}
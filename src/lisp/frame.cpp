@@ -11,19 +11,41 @@ Frame::Frame(AtomTable& symbols, std::shared_ptr<Frame> parent, bool is_global)
 
 void Frame::define(const std::string& name, Value v)
 {
-  AtomTable::Atom id{symbols_.intern(name)};
+  define(symbols_.intern(name), v);
+}
+
+void Frame::define(AtomTable::Atom id, Value v)
+{
+  if (is_global_)
+  {
+    if (id >= globals_.size())
+    {
+      globals_.resize(id + 1);
+      versions_.resize(id + 1);
+    }
+    globals_[id] = std::move(v);
+    ++versions_[id];
+    return;
+  }
   bindings_[id] = v;
 }
 
 bool Frame::set(AtomTable::Atom id, Value val)
 {
-  if (bindings_.find(id) == bindings_.end())
+  if (is_global_)
   {
-    if (!is_global_)
+    Value* value{global(id)};
+    if (value == nullptr)
     {
-      return parent_->set(id, val);
+      return false;
     }
-    return false;
+    *value = std::move(val);
+    ++versions_[id];
+    return true;
+  }
+  if (bindings_.find(id) == bindings_.end())
+  {
+    return parent_->set(id, val);
   }
 
   bindings_[id] = val;
@@ -38,14 +60,14 @@ Value Frame::lookup(const std::string& name, bool& ret) const
 
 Value Frame::lookup(AtomTable::Atom id, bool& ret) const
 {
+  if (is_global_)
+  {
+    ret = version(id) != 0;
+    return ret ? globals_[id] : Value();
+  }
   auto at = bindings_.find(id);
   if (at == bindings_.end())
   {
-    if (is_global_)
-    {
-      ret = false;
-      return Value();
-    }
     return parent_->lookup(id, ret);
   }
   ret = true;
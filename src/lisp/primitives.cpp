@@ -1,87 +1,118 @@
 #include "lisp/env.h"
+#include "lisp/reader.h"
 #include <sstream>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+// Arithmetic stays on ints while every argument is an int and no result
+// overflows, from the first double on it carries on in double.
+template <typename IntOp, typename DoubleOp>
+Value accumulate(std::span<Value> args, Number start, IntOp int_op, DoubleOp double_op,
+                 const std::string& error)
+{
+  Number accumulator{start};
+  for (auto& v : args)
+  {
+    if (!v.is_number())
+    {
+      throw std::runtime_error(error);
+    }
+    Number& n{v.as_number()};
+    if (accumulator.is_int() && n.is_int())
+    {
+      int result;
+      if (int_op(accumulator.as_int(), n.as_int(), result))
+      {
+        accumulator = result;
+        continue;
+      }
+    }
+    accumulator = double_op(accumulator.as_double(), n.as_double());
+  }
+  return Value{accumulator};
+}
+
+template <typename Compare>
+Value compare(std::span<Value> args, Compare cmp)
+{
+  for (auto& v : args)
+  {
+    if (!v.is_number())
+    {
+        throw std::runtime_error("Comparing non numbers");
+    }
+  }
+  for (size_t i{1}; i < args.size(); ++i)
+  {
+    Number& left{args[i - 1].as_number()};
+    Number& right{args[i].as_number()};
+    bool ok{left.is_int() && right.is_int() ?
+      cmp(left.as_int(), right.as_int()) :
+      cmp(left.as_double(), right.as_double())};
+    if (!ok)
+    {
+      return Value{Boolean{false}};
+    }
+  }
+  return Value{Boolean{true}};
+}
+}
 
 void Env::load_primitives()
 {
   define("+", Primitive{"ADD",
     [](std::span<Value> args) -> Value {
-      double accumulator{0.0};
-      for (auto& v : args)
-      {
-        if (v.is_number())
-        {
-          accumulator += v.as_number().as_double();
-        }
-        else
-        {
-          throw std::runtime_error("trying to add not a number");
-        }
-      }
-      return Value{Number{accumulator}};
+      return accumulate(args, Number{0},
+        [](int a, int b, int& r) { return !__builtin_add_overflow(a, b, &r); },
+        [](double a, double b) { return a + b; },
+        "trying to add not a number");
     }
   });
   define("-", Primitive{"SUB",
     [](std::span<Value> args) -> Value {
-      double accumulator{0.0};
-      bool first{true};
-      for (auto& v : args)
+      auto int_sub = [](int a, int b, int& r) { return !__builtin_sub_overflow(a, b, &r); };
+      auto double_sub = [](double a, double b) { return a - b; };
+      if (args.size() == 1)
       {
-        if (first)
-        {
-          first = false;
-          accumulator = v.as_number().as_double();
-          continue;
-        }
-        if (v.is_number())
-        {
-          accumulator -= v.as_number().as_double();
-        }
-        else
-        {
-          throw std::runtime_error("trying to subtract not a number");
-        }
+        return accumulate(args, Number{0}, int_sub, double_sub, "trying to subtract not a number");
       }
-      if (args.size() == 1)
+      if (args.empty() || !args[0].is_number())
       {
-        return Value{Number{-accumulator}};
+        throw std::runtime_error("trying to subtract not a number");
       }
-      return Value{Number{accumulator}};
+      return accumulate(args.subspan(1), args[0].as_number(), int_sub, double_sub,
+        "trying to subtract not a number");
     }
   });
   define("*", Primitive{"NUL",
     [](std::span<Value> args) -> Value {
-      double accumulator{1.0};
-      for (auto& v : args)
-      {
-        if (v.is_number())
-        {
-          accumulator *= v.as_number().as_double();
-        }
-        else
-        {
-          throw std::runtime_error("trying to multiply not a number");
-        }
-      }
-      return Value{Number{accumulator}};
+      return accumulate(args, Number{1},
+        [](int a, int b, int& r) { return !__builtin_mul_overflow(a, b, &r); },
+        [](double a, double b) { return a * b; },
+        "trying to multiply not a number");
     }
   });
   define("/", Primitive{"DIV",
     [](std::span<Value> args) -> Value {
-      double accumulator{args[0].as_number().as_double()};
-      for (size_t i{1}; i < args.size(); ++i)
-      {
-        Value& v{args[i]};
-        if (v.is_number())
-        {
-          accumulator /= v.as_number().as_double();
-        }
-        else
-        {
-          throw std::runtime_error("trying to devide not a number");
-        }
-      }
-      return Value{Number{accumulator}};
+      if (args.empty() || !args[0].is_number())
+      {
+        throw std::runtime_error("trying to devide not a number");
+      }
+      // ints only divide into ints when there is no remainder
+      return accumulate(args.subspan(1), args[0].as_number(),
+        [](int a, int b, int& r) {
+          if (b == 0 || a % b != 0 || (a == std::numeric_limits<int>::min() && b == -1))
+          {
+            return false;
+          }
+          r = a / b;
+          return true;
+        },
+        [](double a, double b) { return a / b; },
+        "trying to devide not a number");
     }
   });
   define("list", Primitive{"LIST",
@@ -162,80 +193,39 @@ void Env::load_primitives()
   });
   define("<", Primitive{"LT",
     [](std::span<Value> args) -> Value {
-      bool first{true};
-      double current;
-      for (auto& v : args)
-      {
-        if (!v.is_number())
-        {
-            throw std::runtime_error("Comparing non numbers");
-        }
-        if (first)
-        {
-          first = false;
-          current = v.as_number().as_double();
-          continue;
-        }
-        double compare_to = v.as_number().as_double();
-        if (current >= compare_to)
-        {
-          return Value{Boolean{false}};
-        }
-        current = compare_to;
-      }
-      return Value{Boolean{true}};
+      return compare(args, [](auto a, auto b) { return a < b; });
     }
   });
   define(">", Primitive{"GT",
     [](std::span<Value> args) -> Value {
-      bool first{true};
-      double current;
-      for (auto& v : args)
-      {
-        if (!v.is_number())
-        {
-            throw std::runtime_error("Comparing non numbers");
-        }
-        if (first)
-        {
-          first = false;
-          current = v.as_number().as_double();
-          continue;
-        }
-        double compare_to = v.as_number().as_double();
-        if (current <= compare_to)
-        {
-          return Value{Boolean{false}};
-        }
-        current = compare_to;
-      }
-      return Value{Boolean{true}};
+      return compare(args, [](auto a, auto b) { return a > b; });
     }
   });
   define("=", Primitive{"EQ",
     [](std::span<Value> args) -> Value {
-      bool first{true};
-      double current;
-      for (auto& v : args)
+      return compare(args, [](auto a, auto b) { return a == b; });
+    }
+  });
+  // Data goes straight from the text to values, the symbols in it are
+  // interned here
+  define("read", Primitive{"READ",
+    [this](std::span<Value> args) -> Value {
+      if (args.size() != 1 || !args[0].is_string())
       {
-        if (!v.is_number())
-        {
-            throw std::runtime_error("Comparing non numbers");
-        }
-        if (first)
-        {
-          first = false;
-          current = v.as_number().as_double();
-          continue;
-        }
-        double compare_to = v.as_number().as_double();
-        if (current != compare_to)
-        {
-          return Value{Boolean{false}};
-        }
-        current = compare_to;
+        throw std::runtime_error("read takes a string");
+      }
+      Reader reader{args[0].as_string().value(), *this};
+      auto value{reader.next()};
+      return value ? *value : Value{Nil{}};
+    }
+  });
+  define("read-file", Primitive{"READ_FILE",
+    [this](std::span<Value> args) -> Value {
+      if (args.size() != 1 || !args[0].is_string())
+      {
+        throw std::runtime_error("read-file takes a path");
       }
-      return Value{Boolean{true}};
+      return Reader{Source::from_file(args[0].as_string().value()), *this}.all();
     }
   });
 }
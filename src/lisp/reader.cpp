@@ -0,0 +1,143 @@
+#include "lisp/reader.h"
+#include "lexer/keywords.h"
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+Reader::Reader(std::string text, Env& env) : lexer_{std::move(text)}, env_{env}, quote_{env.intern("quote")}
+{
+}
+
+Reader::Reader(std::unique_ptr<Source> source, Env& env) :
+  lexer_{std::move(source)}, env_{env}, quote_{env.intern("quote")}
+{
+}
+
+void Reader::error(const std::string& message, size_t offset) const
+{
+  Position at{lexer_.position(Token{Token::Type::END, "", offset})};
+  throw std::runtime_error(message + " at line " + std::to_string(at.line) +
+    ", column " + std::to_string(at.column));
+}
+
+Value Reader::symbol(std::string_view name)
+{
+  std::string text{name};
+  AtomTable::Atom id{env_.intern(text)};
+  return Value{Symbol{id, text}};
+}
+
+std::optional<Value> Reader::next()
+{
+  // The lists being read, innermost last, kept on the heap as the parser
+  // does so nesting depth does not use the C++ stack. Their items wait on
+  // one stack until the list closes and takes them in one allocation.
+  struct Open
+  {
+    size_t first;
+    size_t offset;
+    // made by a ' and done after one datum
+    bool quote_char;
+  };
+  std::vector<Open> open;
+  items_.clear();
+  auto close = [&]() {
+    std::vector<Value> list(std::make_move_iterator(items_.begin() + open.back().first),
+                            std::make_move_iterator(items_.end()));
+    items_.erase(items_.begin() + open.back().first, items_.end());
+    open.pop_back();
+    return list.empty() ? Value{Nil{}} : Value{List{std::move(list)}};
+  };
+  while (true)
+  {
+    Token token{lexer_.token()};
+    Value value;
+    switch (token.type())
+    {
+    case Token::Type::END:
+      if (!open.empty())
+      {
+        const Open& last{open.back()};
+        error(last.quote_char ? "nothing to quote after '" : "missing ')' for the '(' opened", last.offset);
+      }
+      return std::nullopt;
+    case Token::Type::open:
+      open.push_back({items_.size(), token.offset(), false});
+      continue;
+    case Token::Type::close:
+      if (open.empty() || open.back().quote_char)
+      {
+        error("unexpected ')'", token.offset());
+      }
+      value = close();
+      break;
+    case Token::Type::dot:
+      error("dotted pairs are not supported", token.offset());
+    case Token::Type::quote:
+      if (token.string() == "'")
+      {
+        open.push_back({items_.size(), token.offset(), true});
+        items_.push_back(Value{Symbol{quote_, "quote"}});
+        continue;
+      }
+      value = symbol(token.string());
+      break;
+    case Token::Type::number:
+      value = token.is_integer() ? Value{Number{token.integer()}} : Value{Number{token.number()}};
+      break;
+    case Token::Type::string:
+      value = Value{String{std::string{token.string()}}};
+      break;
+    case Token::Type::nil:
+      value = Value{Nil{}};
+      break;
+    case Token::Type::symbol:
+      switch (classify_keyword(token.string(), true))
+      {
+      case Keyword::true_t:
+        value = Value{Boolean{true}};
+        break;
+      case Keyword::false_t:
+        value = Value{Boolean{false}};
+        break;
+      case Keyword::nil:
+        value = Value{Nil{}};
+        break;
+      default:
+        value = symbol(token.string());
+        break;
+      }
+      break;
+    default:
+      // define, if and the other keywords are plain symbols in data
+      value = symbol(token.string());
+      break;
+    }
+
+    // a datum goes in the innermost list, and closes the ' around it
+    while (true)
+    {
+      if (open.empty())
+      {
+        return value;
+      }
+      items_.push_back(std::move(value));
+      if (!open.back().quote_char)
+      {
+        break;
+      }
+      value = close();
+    }
+  }
+}
+
+Value Reader::all()
+{
+  List ret;
+  while (auto value{next()})
+  {
+    ret.push_back(std::move(*value));
+  }
+  return ret.size() == 0 ? Value{Nil{}} : Value{std::move(ret)};
+}
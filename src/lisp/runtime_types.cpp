@@ -2,6 +2,8 @@
 #include "lisp/env.h"
 #include "lisp/value.h"
 #include <iostream>
+#include <stdexcept>
+#include <utility>
 
 Value Object::execute(std::unique_ptr<Env>& env)
 {
@@ -60,18 +62,26 @@ Number& Number::operator=(int value)
 
 int Number::as_int() const
 {
+  // a double need not fit an int, callers check is_int() first
+  if (!is_int())
+  {
+    throw std::runtime_error("Number is not an int");
+  }
   return std::get<int>(value_);
 }
 
 double Number::as_double() const
 {
+  if (is_int())
+  {
+    return std::get<int>(value_);
+  }
   return std::get<double>(value_);
 }
 
 Value Number::execute(std::unique_ptr<Env>& env)
 {
-  Number n{as_double()};
-  return n;
+  return *this;
 }
 
 std::ostream& String::output(std::ostream& out) const
@@ -114,11 +124,20 @@ std::ostream& List::output(std::ostream& out) const
   return out;
 }
 
+List::List(std::vector<Value> values) : values_{std::move(values)}
+{
+}
+
 void List::push_back(Value& val)
 {
   values_.push_back(val);
 }
 
+void List::push_back(Value&& val)
+{
+  values_.push_back(std::move(val));
+}
+
 Value& List::operator[](size_t index)
 {
   return values_[index];
@@ -171,7 +190,7 @@ Value List::execute(std::unique_ptr<Env>& env)
   {
     return first.execute(env);
   }
-  if (first.is_closure())
+  if (first.is_closure() || first.is_procedure())
   {
     std::span<Value> args{begin() + 1, end()};
     std::vector<Value> arguments{};
@@ -179,6 +198,10 @@ Value List::execute(std::unique_ptr<Env>& env)
     {
       arguments.push_back(arg.execute(env));
     }
+    if (first.is_procedure())
+    {
+      return first.as_procedure()(arguments, env);
+    }
     return first.as_closure()(arguments, env);
   }
   Nil nil{};
@@ -232,7 +255,7 @@ Value Lambda::operator()(std::span<Value> args, std::unique_ptr<Env>& env)
   env->push();
   for (size_t i{0}; i < args.size(); ++i)
   {
-    env->define(args_[i].as_symbol().value(), args[i]);
+    env->define(args_[i].as_symbol().id(), args[i]);
   }
   for (auto s : statements_)
   {
@@ -302,3 +325,25 @@ void Quote::add_value(Value v)
   value_.push_back(v);
 }
 
+
+std::ostream& Procedure::output(std::ostream& out) const
+{
+  out << "Procedure";
+  return out;
+}
+
+Value Procedure::execute(std::unique_ptr<Env>& env)
+{
+  return *this;
+}
+
+Value Procedure::operator()(std::span<Value> args, std::unique_ptr<Env>& env)
+{
+  Value ret{body_->call(args, env)};
+  while (env->has_tail_call())
+  {
+    TailCall next{env->take_tail_call()};
+    ret = next.callee.body().call(next.args, env);
+  }
+  return ret;
+}
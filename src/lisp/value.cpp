@@ -1,54 +1,60 @@
 #include "lisp/value.h"
 #include "lisp/env.h"
+#include <utility>
 
 Value::Value(Nil nil)
 {
-  value_ = nil;
+  value_ = std::move(nil);
 }
 
 Value::Value(Boolean boolean)
 {
-  value_ = boolean;
+  value_ = std::move(boolean);
 }
 
 Value::Value(Number number)
 {
-  value_ = number;
+  value_ = std::move(number);
 }
 
 Value::Value(String string)
 {
-  value_ = string;
+  value_ = std::move(string);
 }
 
 Value::Value(Symbol symbol)
 {
-  value_ = symbol;
+  value_ = std::move(symbol);
 }
 
 Value::Value(List list)
 {
-  value_ = list;
+  value_ = std::move(list);
 }
 
 Value::Value(Primitive primitive)
 {
-  value_ = primitive;
+  value_ = std::move(primitive);
 }
 
 Value::Value(Lambda lambda)
 {
-  value_ = lambda;
+  value_ = std::move(lambda);
 }
 
 Value::Value(Closure closure)
 {
-  value_ = closure;
+  value_ = std::move(closure);
 }
 
 Value::Value(Quote quote)
 {
-  value_ = quote;
+  value_ = std::move(quote);
+}
+
+Value::Value(Procedure procedure)
+{
+  value_ = std::move(procedure);
 }
 
 template<class... Ts> struct Overloaded : Ts... { using Ts::operator()...; };
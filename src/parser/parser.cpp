@@ -1,99 +1,306 @@
 #include "parser/parser.h"
+#include "util/thread_pool.h"
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
 #include <utility>
 #include <vector>
-#include <iostream>
 
-Parser::Parser(std::string src) : lexer_{std::move(src)}
+Parser::Parser(std::string src) : lexer_{std::move(src)}, position_{0}, end_{0}
 {
 }
 
-Parser::Parser(Lexer& lexer) : lexer_{lexer.source()}
+Parser::Parser(std::unique_ptr<Source> source) : lexer_{std::move(source)}, position_{0}, end_{0}
 {
 }
 
+Parser::Parser(Lexer&& lexer) : lexer_{std::move(lexer)}, position_{0}, end_{0}
+{
+}
+
+Parser::Parser(std::shared_ptr<const TokenBuffer> tokens) :
+  tokens_{std::move(tokens)}, position_{0}, end_{tokens_->size()}
+{
+}
+
+Parser::Parser(std::shared_ptr<const TokenBuffer> tokens, size_t begin, size_t end) :
+  tokens_{std::move(tokens)}, position_{begin}, end_{end}
+{
+}
+
+Token Parser::token()
+{
+  if (tokens_)
+  {
+    // past the end of the range is the END of the buffer
+    size_t index{position_++};
+    return tokens_->token(index < end_ ? index : tokens_->size());
+  }
+  return lexer_->token();
+}
+
+void Parser::push_back(Token token)
+{
+  if (tokens_)
+  {
+    // the buffer still has it, stepping back is all it takes
+    --position_;
+    return;
+  }
+  lexer_->push_back(std::move(token));
+}
+
+Position Parser::position(size_t offset) const
+{
+  Token token{Token::Type::END, "", offset};
+  return tokens_ ? tokens_->position(token) : lexer_->position(token);
+}
+
+void Parser::error(const std::string& message, size_t offset)
+{
+  Position at{position(offset)};
+  open_.clear();
+  pending_.reset();
+  throw std::runtime_error(message + " at line " + std::to_string(at.line) +
+    ", column " + std::to_string(at.column));
+}
+
 std::unique_ptr<AST> Parser::parse()
 {
-  Token t{Token::Type::symbol, "BEGIN", 0, 0};
+  Token t{Token::Type::symbol, "BEGIN", 0};
   std::unique_ptr<AST> ret = std::make_unique<ASTStart>(t);
-  std::vector<AST*> stack;
-  stack.push_back(ret.get());
-  parse_form(stack);
+  while (auto form{next_form()})
+  {
+    ret->add_child(std::move(form));
+  }
   return ret;
 }
 
-void Parser::parse_form(std::vector<AST*>& stack)
+std::vector<size_t> Parser::form_starts() const
 {
-  Token current = token();
-  if (current.type() == Token::Type::END)
+  // Only parens decide where a form ends, strings and comments are already
+  // single tokens. A ' belongs to the form after it.
+  std::vector<size_t> starts;
+  size_t depth{0};
+  bool quoted{false};
+  size_t last{tokens_->size() - 1};
+  for (size_t i{position_}; i < last; ++i)
   {
-    if (stack.size() != 1)
+    Token::Type type{tokens_->type(i)};
+    if (depth == 0 && !quoted)
     {
+      starts.push_back(i);
+    }
+    quoted = false;
+    if (type == Token::Type::open)
+    {
+      ++depth;
+    }
+    else if (type == Token::Type::close)
+    {
+      // a stray ')' is a form of its own, parsing it reports the error
+      depth -= depth > 0;
+    }
+    else if (depth == 0 && type == Token::Type::quote && tokens_->text(i) == "'")
+    {
+      quoted = true;
     }
-    return;
   }
-  std::unique_ptr<AST> next{nullptr};
-  
-  if (current.type() == Token::Type::open)
+  starts.push_back(last);
+  return starts;
+}
+
+std::unique_ptr<AST> Parser::parse(ThreadPool& pool)
+{
+  if (!tokens_)
   {
-    Token next_token = token();
-    switch (next_token.type())
+    return parse();
+  }
+  std::vector<size_t> starts{form_starts()};
+  size_t count{starts.size() - 1};
+  std::vector<std::unique_ptr<AST>> forms(count);
+  // a few tasks per thread keep them busy when forms differ in size
+  size_t tasks{std::min(count, pool.size() * 8)};
+  std::vector<std::exception_ptr> errors(tasks);
+  pool.run(tasks, [&](size_t task) {
+    size_t first{count * task / tasks};
+    size_t last{count * (task + 1) / tasks};
+    try
     {
-    case Token::Type::lambda:
-      next = std::make_unique<ASTLambda>(next_token);
-      break;
-    case Token::Type::let:
-      next = std::make_unique<ASTLet>(next_token);
-      break;
-    case Token::Type::set:
-      next = std::make_unique<ASTSet>(next_token);
-      break;
-    case Token::Type::define:
-      next = std::make_unique<ASTDefine>(next_token);
-      break;
-    case Token::Type::if_t:
-      next = std::make_unique<ASTIf>(next_token);
-      break;
-    case Token::Type::quote:
-      next = std::make_unique<ASTQuote>(next_token);
-      break;
-    case Token::Type::open:
+      // a form that is not closed runs to the end of the input
+      size_t end{last == count ? tokens_->size() : starts[last]};
+      Parser parser{tokens_, starts[first], end};
+      for (size_t i{first}; i < last; ++i)
       {
-        push_back(next_token);
-        next = std::make_unique<ASTList>(current); // TODO
+        forms[i] = parser.next_form();
       }
-      break;
+    }
+    catch (...)
+    {
+      errors[task] = std::current_exception();
+    }
+  });
+  // the first error in the input, as parsing in order would report it
+  for (auto& error : errors)
+  {
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+  position_ = tokens_->size();
+
+  Token t{Token::Type::symbol, "BEGIN", 0};
+  std::unique_ptr<AST> ret = std::make_unique<ASTStart>(t);
+  for (auto& form : forms)
+  {
+    ret->add_child(std::move(form));
+  }
+  return ret;
+}
+
+std::unique_ptr<AST> Parser::next_form()
+{
+  while (true)
+  {
+    Token current{token()};
+    std::unique_ptr<AST> form;
+    switch (current.type())
+    {
+    case Token::Type::END:
+      if (!open_.empty())
+      {
+        const Open& last{open_.back()};
+        error(last.quote_char ? "nothing to quote after '" : "missing ')' for the '(' opened", last.offset);
+      }
+      return nullptr;
     case Token::Type::close:
+      if (open_.empty() || open_.back().quote_char)
       {
-        AST* root = stack.back();
-        root->add_child(std::make_unique<ASTNil>(next_token));
+        error("unexpected ')'", current.offset());
       }
+      form = close();
       break;
-    default:
+    case Token::Type::open:
+      form = open_list(current);
+      break;
+    case Token::Type::dot:
+      error("dotted pairs are not supported", current.offset());
+    case Token::Type::quote:
+      if (current.string() == "'")
       {
-        next = std::make_unique<ASTList>(current); // TODO
-        AST* root = stack.back();
-        stack.push_back(next.get());
-        root->add_child(std::move(next));
-        next = nullptr;
-        stack.back()->add_child(std::move(AST::factory(next_token))); // TODO
+        open(std::make_unique<ASTQuote>(current), current.offset(), true);
+        break;
       }
+      form = add(AST::factory(current));
+      break;
+    default:
+      form = add(AST::factory(current));
       break;
     }
-    if (next != nullptr)
+    if (form)
     {
-      AST* root = stack.back();
-      stack.push_back(next.get());
-      root->add_child(std::move(next));
+      return form;
     }
   }
-  else if (current.type() == Token::Type::close)
+}
+
+size_t Parser::next_offset()
+{
+  Token next{token()};
+  size_t offset{next.offset()};
+  push_back(std::move(next));
+  return offset;
+}
+
+size_t Parser::offset() const
+{
+  if (tokens_)
+  {
+    return tokens_->offset(position_ < end_ ? position_ : tokens_->size());
+  }
+  return lexer_->offset();
+}
+
+std::unique_ptr<AST> Parser::open_list(Token current)
+{
+  // a special form is known by its first token, any other list starts with
+  // its first element
+  Token head{token()};
+  switch (head.type())
+  {
+  case Token::Type::lambda:
+    open(std::make_unique<ASTLambda>(head), current.offset());
+    return nullptr;
+  case Token::Type::let:
+    open(std::make_unique<ASTLet>(head), current.offset());
+    return nullptr;
+  case Token::Type::set:
+    open(std::make_unique<ASTSet>(head), current.offset());
+    return nullptr;
+  case Token::Type::define:
+    open(std::make_unique<ASTDefine>(head), current.offset());
+    return nullptr;
+  case Token::Type::if_t:
+    open(std::make_unique<ASTIf>(head), current.offset());
+    return nullptr;
+  case Token::Type::quote:
+    if (head.string() != "'")
+    {
+      open(std::make_unique<ASTQuote>(head), current.offset());
+      return nullptr;
+    }
+    break;
+  case Token::Type::close:
+    return add(std::make_unique<ASTNil>(head));
+  case Token::Type::END:
+    error("missing ')' for the '(' opened", current.offset());
+  case Token::Type::number:
+  case Token::Type::string:
+  case Token::Type::symbol:
+  case Token::Type::nil:
+    // the usual call, the head is added right away
+    open(std::make_unique<ASTList>(current), current.offset());
+    open_.back().node->add_child(AST::factory(head));
+    return nullptr;
+  default:
+    break;
+  }
+  push_back(head);
+  open(std::make_unique<ASTList>(current), current.offset());
+  return nullptr;
+}
+
+void Parser::open(std::unique_ptr<AST> node, size_t offset, bool quote_char)
+{
+  AST* raw{node.get()};
+  if (open_.empty())
   {
-    stack.pop_back();
+    pending_ = std::move(node);
   }
   else
   {
-    stack.back()->add_child(std::move(AST::factory(current)));
+    open_.back().node->add_child(std::move(node));
+  }
+  open_.push_back({raw, offset, quote_char});
+}
+
+std::unique_ptr<AST> Parser::add(std::unique_ptr<AST> node)
+{
+  if (open_.empty())
+  {
+    return node;
   }
-  parse_form(stack);
+  open_.back().node->add_child(std::move(node));
+  return open_.back().quote_char ? close() : nullptr;
 }
 
+std::unique_ptr<AST> Parser::close()
+{
+  // closing a node also closes the ' in front of it
+  do
+  {
+    open_.pop_back();
+  } while (!open_.empty() && open_.back().quote_char);
+  return open_.empty() ? std::move(pending_) : nullptr;
+}
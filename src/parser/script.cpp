@@ -0,0 +1,167 @@
+#include "parser/script.h"
+#include "parser/parser.h"
+#include "util/hash.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+Script::Form Script::make_form(std::unique_ptr<AST> ast, std::string_view text, size_t start, size_t end)
+{
+  Form form{start, end, hash_bytes(text.substr(start, end - start)), std::move(ast), {}, {}, true};
+  std::vector<const AST*> nodes{form.ast.get()};
+  while (!nodes.empty())
+  {
+    const AST* node{nodes.back()};
+    nodes.pop_back();
+    if (node->type() == AST::Type::symbol)
+    {
+      form.uses.push_back(static_cast<const ASTSymbol*>(node)->value());
+    }
+    node->append_children(nodes);
+  }
+  std::sort(form.uses.begin(), form.uses.end());
+  form.uses.erase(std::unique(form.uses.begin(), form.uses.end()), form.uses.end());
+
+  if (form.ast->type() == AST::Type::define)
+  {
+    std::vector<const AST*> children;
+    form.ast->append_children(children);
+    if (!children.empty())
+    {
+      form.defines = children.front()->as_string();
+    }
+  }
+  return form;
+}
+
+Script::Stats Script::load(std::string text)
+{
+  std::string_view before{text_};
+  std::string_view after{text};
+  size_t common{std::min(before.size(), after.size())};
+  size_t prefix{static_cast<size_t>(std::mismatch(before.begin(), before.begin() + common, after.begin()).first - before.begin())};
+  size_t suffix{static_cast<size_t>(std::mismatch(before.rbegin(), before.rbegin() + (common - prefix), after.rbegin()).first - before.rbegin())};
+
+  // A form that ends before the first change, with the char that ended its
+  // last token, lexes the same. Lexing picks up right after the last of them.
+  size_t first{static_cast<size_t>(std::partition_point(forms_.begin(), forms_.end(),
+    [&](const Form& form) { return form.end < prefix; }) - forms_.begin())};
+  size_t from{first > 0 ? forms_[first - 1].end : 0};
+  // Forms that start after the last change can be taken over as they are if
+  // parsing the new text reaches a form start at one of them.
+  size_t tail{static_cast<size_t>(std::partition_point(forms_.begin() + first, forms_.end(),
+    [&](const Form& form) { return form.start < before.size() - suffix; }) - forms_.begin())};
+
+  std::vector<Form> edited;
+  size_t resume{forms_.size()};
+  size_t to{after.size()};
+  try
+  {
+    Parser parser{Source::from_view(after.substr(from), from)};
+    while (true)
+    {
+      size_t start{parser.next_offset()};
+      if (start >= after.size() - suffix)
+      {
+        size_t old{start - after.size() + before.size()};
+        auto found{std::lower_bound(forms_.begin() + tail, forms_.end(), old,
+          [](const Form& form, size_t offset) { return form.start < offset; })};
+        if (found != forms_.end() && found->start == old)
+        {
+          resume = found - forms_.begin();
+          to = start;
+          break;
+        }
+      }
+      auto ast{parser.next_form()};
+      if (!ast)
+      {
+        break;
+      }
+      edited.push_back(make_form(std::move(ast), after, start, parser.offset()));
+    }
+  }
+  catch (const std::runtime_error&)
+  {
+    // the same error again, with lines and columns counted from the start
+    Parser{std::string{after}}.parse();
+    throw;
+  }
+
+  // Forms in the edited span that read the same as one that was there keep
+  // their AST and do not need to run again
+  std::unordered_multimap<uint64_t, size_t> replaced;
+  for (size_t i{first}; i < resume; ++i)
+  {
+    replaced.emplace(forms_[i].hash, i);
+  }
+  Stats stats{0, edited.size(), 0, to - from};
+  for (auto& form : edited)
+  {
+    auto [match, last]{replaced.equal_range(form.hash)};
+    for (; match != last; ++match)
+    {
+      const Form& old{forms_[match->second]};
+      if (before.substr(old.start, old.end - old.start) == after.substr(form.start, form.end - form.start))
+      {
+        break;
+      }
+    }
+    if (match == last)
+    {
+      ++stats.changed;
+      continue;
+    }
+    Form& old{forms_[match->second]};
+    form.ast = std::move(old.ast);
+    form.pending = old.pending;
+    replaced.erase(match);
+  }
+  for (const auto& [hash, index] : replaced)
+  {
+    if (!forms_[index].defines.empty())
+    {
+      changed_.insert(forms_[index].defines);
+    }
+  }
+
+  std::vector<Form> forms;
+  forms.reserve(first + edited.size() + forms_.size() - resume);
+  std::move(forms_.begin(), forms_.begin() + first, std::back_inserter(forms));
+  std::move(edited.begin(), edited.end(), std::back_inserter(forms));
+  for (size_t i{resume}; i < forms_.size(); ++i)
+  {
+    forms.push_back(std::move(forms_[i]));
+    forms.back().start = forms.back().start - before.size() + after.size();
+    forms.back().end = forms.back().end - before.size() + after.size();
+  }
+  forms_ = std::move(forms);
+  text_ = std::move(text);
+  stats.forms = forms_.size();
+  return stats;
+}
+
+size_t Script::run(std::unique_ptr<Env>& env)
+{
+  size_t count{0};
+  for (auto& form : forms_)
+  {
+    bool stale{form.pending || std::any_of(form.uses.begin(), form.uses.end(),
+      [&](const std::string& name) { return changed_.count(name) > 0; })};
+    if (!stale)
+    {
+      continue;
+    }
+    form.ast->eval(env).execute(env);
+    form.pending = false;
+    if (!form.defines.empty())
+    {
+      changed_.insert(form.defines);
+    }
+    ++count;
+  }
+  changed_.clear();
+  return count;
+}
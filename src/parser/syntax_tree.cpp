@@ -0,0 +1,735 @@
+#include "parser/syntax_tree.h"
+#include "lexer/keywords.h"
+#include "util/hash.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(SyntaxTree::Node) == 16);
+
+SyntaxTree::SyntaxTree(std::string text) :
+  SyntaxTree{std::make_shared<const TokenBuffer>(std::move(text))}
+{
+}
+
+SyntaxTree::SyntaxTree(std::shared_ptr<const TokenBuffer> tokens) :
+  tokens_{std::move(tokens)}
+{
+  parse();
+  base_ = arena_.at<std::byte>(0);
+  text_ = tokens_->source();
+}
+
+namespace
+{
+// A node that still takes children, they are on the scratch stack from
+// first on
+struct Open
+{
+  SyntaxTree::Node node;
+  size_t first;
+  // the '(' for error messages
+  size_t paren;
+};
+
+AST::Type keyword_type(Token::Type type)
+{
+  switch (type)
+  {
+  case Token::Type::lambda:
+    return AST::Type::lambda;
+  case Token::Type::let:
+    return AST::Type::let;
+  case Token::Type::set:
+    return AST::Type::set;
+  case Token::Type::define:
+    return AST::Type::define;
+  case Token::Type::if_t:
+    return AST::Type::if_t;
+  case Token::Type::quote:
+    return AST::Type::quote;
+  default:
+    break;
+  }
+  return AST::Type::unknown;
+}
+
+[[noreturn]] void fail(const TokenBuffer& tokens, const std::string& message, size_t offset)
+{
+  Position at{tokens.position(Token{Token::Type::END, "", offset})};
+  throw std::runtime_error(message + " at line " + std::to_string(at.line) +
+    ", column " + std::to_string(at.column));
+}
+
+// What AST::factory makes of a symbol
+AST::Type symbol_type(std::string_view text)
+{
+  switch (classify_keyword(text, true))
+  {
+  case Keyword::true_t:
+  case Keyword::false_t:
+    return AST::Type::boolean;
+  case Keyword::set:
+    return AST::Type::set;
+  case Keyword::define:
+    return AST::Type::define;
+  case Keyword::nil:
+    return AST::Type::nil;
+  case Keyword::quote:
+    return AST::Type::quote;
+  case Keyword::if_t:
+    return AST::Type::if_t;
+  case Keyword::let:
+    return AST::Type::let;
+  case Keyword::lambda:
+    return AST::Type::lambda;
+  case Keyword::none:
+    break;
+  }
+  return AST::Type::symbol;
+}
+}
+
+// The same walk as Parser::next_form, finished nodes go on a scratch stack
+// and a node that closes moves its children from there into the arena
+void SyntaxTree::parse()
+{
+  const TokenBuffer& tokens{*tokens_};
+  std::string_view source{tokens.source()};
+  // no more nodes than tokens, so the arena rarely has to grow, what is
+  // left over is given back at the end
+  arena_.reserve(tokens.size() * sizeof(Node) + 64);
+
+  std::vector<Node> scratch;
+  std::vector<Open> open;
+  auto container = [](AST::Type type, size_t offset, size_t length, uint8_t flags = 0) {
+    return Node{type, flags, static_cast<uint16_t>(length), static_cast<uint32_t>(offset), 0, 0};
+  };
+  auto close = [&]() {
+    Open last{open.back()};
+    open.pop_back();
+    Node node{last.node};
+    size_t count{scratch.size() - last.first};
+    node.data = arena_.allocate<Node>(count);
+    node.size = count;
+    std::copy(scratch.begin() + last.first, scratch.end(), arena_.at<Node>(node.data));
+    scratch.resize(last.first);
+    return node;
+  };
+  // a finished node may finish the ' in front of it
+  auto complete = [&](Node node) {
+    ++nodes_;
+    scratch.push_back(node);
+    while (!open.empty() && (open.back().node.flags & Node::quote_char))
+    {
+      scratch.push_back(close());
+      ++nodes_;
+    }
+  };
+  auto atom = [&](size_t i) {
+    Token::Type type{tokens.type(i)};
+    uint32_t offset{static_cast<uint32_t>(tokens.offset(i))};
+    std::string_view text{tokens.text(i)};
+    Node node{AST::Type::unknown, 0, 0, offset, 0, static_cast<uint32_t>(text.size())};
+    switch (type)
+    {
+    case Token::Type::number:
+      {
+        node.type = AST::Type::number;
+        Token token{tokens.token(i)};
+        if (token.is_integer())
+        {
+          node.flags = Node::integer;
+          node.data = static_cast<uint32_t>(token.integer());
+        }
+        else
+        {
+          node.data = arena_.allocate<double>(1);
+          *arena_.at<double>(node.data) = token.number();
+        }
+      }
+      break;
+    case Token::Type::string:
+      node.type = AST::Type::string;
+      if (text.data() == source.data() + offset + 1)
+      {
+        node.data = offset + 1;
+      }
+      else
+      {
+        node.flags = Node::unescaped;
+        node.data = arena_.allocate<char>(text.size());
+        std::memcpy(arena_.at<char>(node.data), text.data(), text.size());
+      }
+      break;
+    case Token::Type::nil:
+      node.type = AST::Type::nil;
+      break;
+    case Token::Type::symbol:
+      node.type = symbol_type(text);
+      break;
+    default:
+      // a keyword that does not start a form is a node with no children
+      node.type = keyword_type(type);
+      node.length = static_cast<uint16_t>(text.size());
+      node.size = 0;
+      break;
+    }
+    return node;
+  };
+
+  for (size_t i{0}; ; ++i)
+  {
+    Token::Type type{tokens.type(i)};
+    size_t offset{tokens.offset(i)};
+    switch (type)
+    {
+    case Token::Type::END:
+      if (!open.empty())
+      {
+        const Open& last{open.back()};
+        if (last.node.flags & Node::quote_char)
+        {
+          fail(tokens, "nothing to quote after '", last.paren);
+        }
+        fail(tokens, "missing ')' for the '(' opened", last.paren);
+      }
+      forms_.data = arena_.allocate<Node>(scratch.size());
+      forms_.size = scratch.size();
+      std::copy(scratch.begin(), scratch.end(), arena_.at<Node>(forms_.data));
+      arena_.shrink_to_fit();
+      return;
+    case Token::Type::close:
+      if (open.empty() || (open.back().node.flags & Node::quote_char))
+      {
+        fail(tokens, "unexpected ')'", offset);
+      }
+      complete(close());
+      break;
+    case Token::Type::dot:
+      fail(tokens, "dotted pairs are not supported", offset);
+    case Token::Type::quote:
+      if (tokens.text(i) == "'")
+      {
+        open.push_back({container(AST::Type::quote, offset, 1, Node::quote_char), scratch.size(), offset});
+        break;
+      }
+      complete(atom(i));
+      break;
+    case Token::Type::open:
+      {
+        Token::Type head{tokens.type(i + 1)};
+        AST::Type keyword{keyword_type(head)};
+        if (head == Token::Type::quote && tokens.text(i + 1) == "'")
+        {
+          keyword = AST::Type::unknown;
+        }
+        if (keyword != AST::Type::unknown)
+        {
+          ++i;
+          open.push_back({container(keyword, tokens.offset(i), tokens.text(i).size()), scratch.size(), offset});
+        }
+        else if (head == Token::Type::close)
+        {
+          ++i;
+          complete(Node{AST::Type::nil, 0, 0, static_cast<uint32_t>(tokens.offset(i)), 0, 1});
+        }
+        else if (head == Token::Type::END)
+        {
+          fail(tokens, "missing ')' for the '(' opened", offset);
+        }
+        else
+        {
+          open.push_back({container(AST::Type::list, offset, 1), scratch.size(), offset});
+        }
+      }
+      break;
+    default:
+      complete(atom(i));
+      break;
+    }
+  }
+}
+
+namespace
+{
+bool is_container(AST::Type type)
+{
+  switch (type)
+  {
+  case AST::Type::list:
+  case AST::Type::start:
+  case AST::Type::quote:
+  case AST::Type::if_t:
+  case AST::Type::define:
+  case AST::Type::set:
+  case AST::Type::let:
+  case AST::Type::lambda:
+    return true;
+  default:
+    break;
+  }
+  return false;
+}
+
+std::string_view spelling(const SyntaxTree::Node& node)
+{
+  switch (node.type)
+  {
+  case AST::Type::list:
+    return "(";
+  case AST::Type::quote:
+    return node.flags & SyntaxTree::Node::quote_char ? "'" : "quote";
+  case AST::Type::if_t:
+    return "if";
+  case AST::Type::define:
+    return "define";
+  case AST::Type::set:
+    return "set";
+  case AST::Type::let:
+    return "let";
+  case AST::Type::lambda:
+    return "lambda";
+  default:
+    break;
+  }
+  return "";
+}
+}
+
+std::span<const SyntaxTree::Node> SyntaxTree::children(const Node& node) const
+{
+  if (!is_container(node.type) || node.size == 0)
+  {
+    return {};
+  }
+  return {at<Node>(node.data), node.size};
+}
+
+std::string_view SyntaxTree::text(const Node& node) const
+{
+  if (is_container(node.type))
+  {
+    return cached() ? spelling(node) : text_.substr(node.offset, node.length);
+  }
+  if (node.type == AST::Type::string)
+  {
+    if (node.flags & Node::unescaped)
+    {
+      return {at<char>(node.data), node.size};
+    }
+    return text_.substr(node.data, node.size);
+  }
+  if (node.flags & Node::atom)
+  {
+    return text_.substr(atoms_[2 * node.data], atoms_[2 * node.data + 1]);
+  }
+  // a saved number keeps only its value
+  return cached() ? std::string_view{} : text_.substr(node.offset, node.size);
+}
+
+Token::Numeric SyntaxTree::number(const Node& node) const
+{
+  if (node.type != AST::Type::number)
+  {
+    return {};
+  }
+  if (node.flags & Node::integer)
+  {
+    return static_cast<int>(node.data);
+  }
+  return *at<double>(node.data);
+}
+
+Position SyntaxTree::position(size_t offset) const
+{
+  if (!cached())
+  {
+    return tokens_->position(Token{Token::Type::END, "", offset});
+  }
+  auto after{std::upper_bound(newlines_.begin(), newlines_.end(), offset)};
+  size_t line{static_cast<size_t>(after - newlines_.begin())};
+  size_t start{line ? newlines_[line - 1] + 1 : 0};
+  return {line + 1, offset - start + 1};
+}
+
+std::unique_ptr<AST> SyntaxTree::to_ast(const Node& node) const
+{
+  std::unique_ptr<AST> ret;
+  switch (node.type)
+  {
+  case AST::Type::number:
+    {
+      Token token{Token::Type::number, text(node), node.offset, number(node)};
+      return std::make_unique<ASTNumber>(token);
+    }
+  case AST::Type::string:
+    {
+      Token token{Token::Type::string, text(node), node.offset};
+      return std::make_unique<ASTString>(token);
+    }
+  case AST::Type::list:
+    {
+      Token token{Token::Type::open, text(node), node.offset};
+      ret = std::make_unique<ASTList>(token);
+    }
+    break;
+  case AST::Type::quote:
+    {
+      Token token{Token::Type::quote, text(node), node.offset};
+      ret = std::make_unique<ASTQuote>(token);
+    }
+    break;
+  default:
+    {
+      // atoms and special forms, the factory knows them by their text
+      Token token{node.type == AST::Type::nil ? Token::Type::nil : Token::Type::symbol, text(node), node.offset};
+      ret = AST::factory(token);
+    }
+    break;
+  }
+  for (const Node& child : children(node))
+  {
+    ret->add_child(to_ast(child));
+  }
+  return ret;
+}
+
+std::unique_ptr<AST> SyntaxTree::to_ast() const
+{
+  Token t{Token::Type::symbol, "BEGIN", 0};
+  std::unique_ptr<AST> ret = std::make_unique<ASTStart>(t);
+  for (const Node& form : forms())
+  {
+    ret->add_child(to_ast(form));
+  }
+  return ret;
+}
+
+namespace
+{
+// The start of a .tyc file. The sections after it are the nodes, a copy of
+// the arena, then the atom table as offset and length pairs into the text,
+// the text and the newline offsets of the source. Everything is in the byte
+// order of the machine that wrote it, the file is a local cache.
+struct Header
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t hash;
+  uint64_t nodes;
+  SyntaxTree::Node forms;
+  uint32_t nodes_size;
+  uint32_t atom_count;
+  uint32_t text_size;
+  uint32_t line_count;
+  uint64_t reserved;
+};
+static_assert(sizeof(Header) == 64);
+
+constexpr char magic[4]{'T', 'Y', 'C', '\0'};
+// bumped whenever Node or the layout changes
+constexpr uint32_t version{1};
+
+struct Layout
+{
+  size_t nodes;
+  size_t atoms;
+  size_t text;
+  size_t lines;
+  size_t end;
+};
+
+Layout layout(const Header& header)
+{
+  auto align = [](size_t offset, size_t to) { return (offset + to - 1) & ~(to - 1); };
+  Layout ret;
+  ret.nodes = sizeof(Header);
+  ret.atoms = align(ret.nodes + header.nodes_size, 8);
+  ret.text = ret.atoms + size_t{header.atom_count} * 2 * sizeof(uint32_t);
+  ret.lines = align(ret.text + header.text_size, 4);
+  ret.end = ret.lines + size_t{header.line_count} * sizeof(uint32_t);
+  return ret;
+}
+
+// Whether every offset in a mapped file stays inside its section, so a
+// corrupted file is a cache miss rather than reads out of bounds. A file
+// whose children loop back has more nodes than fit and is refused.
+bool valid(const std::byte* image, const Header& header, const Layout& sections)
+{
+  const uint32_t* atoms{reinterpret_cast<const uint32_t*>(image + sections.atoms)};
+  for (size_t i{0}; i < header.atom_count; ++i)
+  {
+    if (size_t{atoms[2 * i]} + atoms[2 * i + 1] > header.text_size)
+    {
+      return false;
+    }
+  }
+  const uint32_t* newlines{reinterpret_cast<const uint32_t*>(image + sections.lines)};
+  if (!std::is_sorted(newlines, newlines + header.line_count))
+  {
+    return false;
+  }
+  auto block = [&](size_t offset, size_t count, size_t align) {
+    return offset % align == 0 && offset + count <= header.nodes_size;
+  };
+  size_t visited{0};
+  std::vector<SyntaxTree::Node> open{header.forms};
+  while (!open.empty())
+  {
+    SyntaxTree::Node node{open.back()};
+    open.pop_back();
+    if (++visited > header.nodes_size / sizeof(SyntaxTree::Node) + 1)
+    {
+      return false;
+    }
+    if (is_container(node.type))
+    {
+      if (node.size != 0 && !block(node.data, size_t{node.size} * sizeof(SyntaxTree::Node), alignof(SyntaxTree::Node)))
+      {
+        return false;
+      }
+      const auto* children{reinterpret_cast<const SyntaxTree::Node*>(image + sections.nodes + node.data)};
+      open.insert(open.end(), children, children + node.size);
+      continue;
+    }
+    switch (node.type)
+    {
+    case AST::Type::number:
+      if (!(node.flags & SyntaxTree::Node::integer) && !block(node.data, sizeof(double), alignof(double)))
+      {
+        return false;
+      }
+      break;
+    case AST::Type::string:
+      if ((node.flags & SyntaxTree::Node::unescaped) || size_t{node.data} + node.size > header.text_size)
+      {
+        return false;
+      }
+      break;
+    case AST::Type::symbol:
+    case AST::Type::boolean:
+    case AST::Type::nil:
+      if (!(node.flags & SyntaxTree::Node::atom) || node.data >= header.atom_count)
+      {
+        return false;
+      }
+      break;
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+uint64_t SyntaxTree::hash(std::string_view source)
+{
+  return hash_bytes(source, version);
+}
+
+void SyntaxTree::save(const std::string& path) const
+{
+  if (cached())
+  {
+    throw std::runtime_error("a tree loaded from a file has no source to save");
+  }
+  // The nodes are written as they are, except that symbols become atoms
+  // and all string text moves into the text section
+  std::vector<std::byte> nodes(base_, base_ + arena_.size());
+  std::vector<uint32_t> atoms;
+  std::string text;
+  std::unordered_map<std::string_view, uint32_t> interned;
+  std::vector<std::pair<uint32_t, uint32_t>> blocks{{forms_.data, forms_.size}};
+  while (!blocks.empty())
+  {
+    auto [offset, count] = blocks.back();
+    blocks.pop_back();
+    for (uint32_t i{0}; i < count; ++i)
+    {
+      const Node& node{at<Node>(offset)[i]};
+      Node& saved{reinterpret_cast<Node*>(nodes.data() + offset)[i]};
+      if (is_container(node.type))
+      {
+        if (node.size)
+        {
+          blocks.push_back({node.data, node.size});
+        }
+        continue;
+      }
+      if (node.type == AST::Type::number)
+      {
+        continue;
+      }
+      std::string_view chars{this->text(node)};
+      if (node.type == AST::Type::string)
+      {
+        saved.data = text.size();
+        saved.flags &= ~Node::unescaped;
+        text += chars;
+        continue;
+      }
+      auto [atom, added] = interned.try_emplace(chars, atoms.size() / 2);
+      if (added)
+      {
+        atoms.push_back(text.size());
+        atoms.push_back(chars.size());
+        text += chars;
+      }
+      saved.data = atom->second;
+      saved.flags |= Node::atom;
+    }
+  }
+  std::vector<uint32_t> newlines;
+  for (size_t at{text_.find('\n')}; at != std::string_view::npos; at = text_.find('\n', at + 1))
+  {
+    newlines.push_back(at);
+  }
+
+  Header header{};
+  std::memcpy(header.magic, magic, sizeof magic);
+  header.version = version;
+  header.hash = hash(text_);
+  header.nodes = nodes_;
+  header.forms = forms_;
+  header.nodes_size = nodes.size();
+  header.atom_count = atoms.size() / 2;
+  header.text_size = text.size();
+  header.line_count = newlines.size();
+  Layout sections{layout(header)};
+
+  // written aside and renamed, so a reader never maps half a file
+  std::string temporary{path + ".tmp" + std::to_string(::getpid())};
+  {
+    std::ofstream out{temporary, std::ios::binary | std::ios::trunc};
+    auto pad = [&](size_t to) {
+      static const char zeros[8]{};
+      out.write(zeros, to - static_cast<size_t>(out.tellp()));
+    };
+    out.write(reinterpret_cast<const char*>(&header), sizeof header);
+    out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size());
+    pad(sections.atoms);
+    out.write(reinterpret_cast<const char*>(atoms.data()), atoms.size() * sizeof(uint32_t));
+    out.write(text.data(), text.size());
+    pad(sections.lines);
+    out.write(reinterpret_cast<const char*>(newlines.data()), newlines.size() * sizeof(uint32_t));
+    if (!out)
+    {
+      std::remove(temporary.c_str());
+      throw std::runtime_error("could not write " + path);
+    }
+  }
+  if (std::rename(temporary.c_str(), path.c_str()) != 0)
+  {
+    std::remove(temporary.c_str());
+    throw std::runtime_error("could not write " + path);
+  }
+}
+
+std::optional<SyntaxTree> SyntaxTree::load(const std::string& path, uint64_t hash)
+{
+  int fd{::open(path.c_str(), O_RDONLY)};
+  if (fd < 0)
+  {
+    return std::nullopt;
+  }
+  struct stat info;
+  if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header))
+  {
+    ::close(fd);
+    return std::nullopt;
+  }
+  size_t size{static_cast<size_t>(info.st_size)};
+  void* mapped{::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)};
+  ::close(fd);
+  if (mapped == MAP_FAILED)
+  {
+    return std::nullopt;
+  }
+  std::shared_ptr<const std::byte> image{static_cast<const std::byte*>(mapped),
+    [size](const std::byte* p) { ::munmap(const_cast<std::byte*>(p), size); }};
+
+  const Header& header{*reinterpret_cast<const Header*>(image.get())};
+  if (std::memcmp(header.magic, magic, sizeof magic) != 0 || header.version != version ||
+    header.hash != hash)
+  {
+    return std::nullopt;
+  }
+  Layout sections{layout(header)};
+  if (sections.end > size || header.forms.type != AST::Type::start || !valid(image.get(), header, sections))
+  {
+    return std::nullopt;
+  }
+
+  SyntaxTree tree;
+  tree.forms_ = header.forms;
+  tree.nodes_ = header.nodes;
+  tree.base_ = image.get() + sections.nodes;
+  tree.atoms_ = reinterpret_cast<const uint32_t*>(image.get() + sections.atoms);
+  tree.text_ = {reinterpret_cast<const char*>(image.get() + sections.text), header.text_size};
+  tree.newlines_ = {reinterpret_cast<const uint32_t*>(image.get() + sections.lines), header.line_count};
+  tree.image_ = std::move(image);
+  return tree;
+}
+
+std::string SyntaxTree::cache_path(const std::string& path)
+{
+  std::filesystem::path dir;
+  const char* xdg{std::getenv("XDG_CACHE_HOME")};
+  const char* home{std::getenv("HOME")};
+  if (xdg != nullptr && *xdg != '\0')
+  {
+    dir = xdg;
+  }
+  else if (home != nullptr && *home != '\0')
+  {
+    dir = std::filesystem::path{home} / ".cache";
+  }
+  else
+  {
+    return "";
+  }
+  // files of the same name in different places get a file each
+  std::error_code error;
+  std::filesystem::path absolute{std::filesystem::absolute(path, error)};
+  char id[17];
+  std::snprintf(id, sizeof id, "%016llx", static_cast<unsigned long long>(hash_bytes(absolute.string())));
+  return (dir / "tyson" / (absolute.stem().string() + "-" + id + ".tyc")).string();
+}
+
+SyntaxTree SyntaxTree::load_file(const std::string& path, bool cache)
+{
+  std::unique_ptr<Source> source{Source::from_file(path)};
+  std::string cached{cache ? cache_path(path) : ""};
+  if (cached.empty())
+  {
+    return SyntaxTree{std::make_shared<const TokenBuffer>(std::move(source))};
+  }
+  if (auto tree{load(cached, hash(source->window()))})
+  {
+    return std::move(*tree);
+  }
+  SyntaxTree tree{std::make_shared<const TokenBuffer>(std::move(source))};
+  std::error_code error;
+  std::filesystem::create_directories(std::filesystem::path{cached}.parent_path(), error);
+  try
+  {
+    tree.save(cached);
+  }
+  catch (const std::runtime_error&)
+  {
+    // somewhere we cannot write only means no cache
+  }
+  return tree;
+}
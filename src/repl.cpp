@@ -2,16 +2,111 @@
 #include <string>
 #include <replxx.hxx>
 #include <utility>
-#include "parser/parser.h"
+#include <vector>
+#include "parser/syntax_tree.h"
+#include "engine/engine.h"
+#include "engine/jit.h"
+#include "engine/optimizer.h"
 #include "lisp/env.h"
 
-int main(int /*argc*/, char** /*argv*/)
+namespace
 {
+bool optimize{true};
+// --optimizer-stats, what the passes of the optimizer did goes to stderr
+bool optimizer_stats{false};
+// --no-cache, a file is parsed every time and nothing is written
+bool cache{true};
+}
+
+// Runs a file form by form. Its parse is kept in the user's cache directory,
+// so the next run of the same file does not lex or parse it again.
+int run_file(const char* path, Engine& engine)
+{
+  std::unique_ptr<Env> environment = std::make_unique<Env>();
+  try
+  {
+    SyntaxTree tree{SyntaxTree::load_file(path, cache)};
+    // every form is checked and compiled before the first one runs
+    auto locate = [&](size_t offset) { return tree.position(offset); };
+    Optimizer optimizer{environment};
+    std::vector<Engine::Program> programs;
+    for (const auto& form : tree.forms())
+    {
+      auto prepared{prepare(tree.to_ast(form), environment, locate, optimize ? &optimizer : nullptr)};
+      programs.push_back(engine.compile(std::move(prepared)));
+    }
+    if (optimizer_stats)
+    {
+      std::cerr << optimizer.stats();
+    }
+    for (auto& program : programs)
+    {
+      program(environment);
+    }
+  }
+  catch (const std::runtime_error& err)
+  {
+    std::cerr << path << ": " << err.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// usage: tyson [--engine=tree|vm|closure|quick|jit] [--no-jit] [--no-optimize] [--optimizer-stats] [--no-cache] [file]
+int main(int argc, char** argv)
+{
+  std::string engine_name{"tree"};
+  const char* path{nullptr};
+  for (int i{1}; i < argc; ++i)
+  {
+    std::string arg{argv[i]};
+    if (arg.starts_with("--engine="))
+    {
+      engine_name = arg.substr(9);
+    }
+    else if (arg == "--no-jit")
+    {
+      Jit::set_enabled(false);
+    }
+    else if (arg == "--no-optimize")
+    {
+      optimize = false;
+    }
+    else if (arg == "--optimizer-stats")
+    {
+      optimizer_stats = true;
+    }
+    else if (arg == "--no-cache")
+    {
+      cache = false;
+    }
+    else
+    {
+      path = argv[i];
+    }
+  }
+  std::unique_ptr<Engine> engine;
+  try
+  {
+    engine = Engine::factory(engine_name);
+  }
+  catch (const std::runtime_error& err)
+  {
+    std::cerr << err.what() << std::endl;
+    return 1;
+  }
+  if (path != nullptr)
+  {
+    return run_file(path, *engine);
+  }
+
   replxx::Replxx console;
   console.set_max_history_size(10000);
   console.set_no_color(false);
 
   std::unique_ptr<Env> environment = std::make_unique<Env>();
+  // kept from line to line, a lambda defined on one is inlined on the next
+  auto optimizer{std::make_unique<Optimizer>(environment)};
 
   while (true)
   {
@@ -29,10 +124,12 @@ int main(int /*argc*/, char** /*argv*/)
 
     try
     {
-      Parser p{line};
-      auto parsed{p.parse()};
-      auto val(parsed->eval(environment));
-      val = val.execute(environment);
+      auto program{compile(line, *engine, environment, optimize ? optimizer.get() : nullptr)};
+      if (optimizer_stats)
+      {
+        std::cerr << optimizer->stats();
+      }
+      auto val(program(environment));
       std::cout << val <<std::endl;
       console.history_add(line);
     }
@@ -40,6 +137,7 @@ int main(int /*argc*/, char** /*argv*/)
     {
       std::cout << err.what() << std::endl;
       environment = std::make_unique<Env>();
+      optimizer = std::make_unique<Optimizer>(environment);
     }
   }
   return 0;
@@ -0,0 +1,84 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "aot/translator.h"
+#include "engine/engine.h"
+#include "engine/optimizer.h"
+#include "parser/syntax_tree.h"
+
+// Translates a Tyson file to C++ and builds it. The executable runs the
+// forms of the file and prints the value of the last one, a shared object
+// has Value tyson_run(std::unique_ptr<Env>&) for a program that links the
+// lisp library to call. --include and --libraries say where the tyson
+// headers and libraries are, as $TYSON_AOT_INCLUDE and $TYSON_AOT_LIBRARIES do.
+// usage: tyson-aot [--cpp | --shared] [--include dir] [--libraries list] [-o output] file
+int main(int argc, char** argv)
+{
+  bool cpp{false};
+  bool shared{false};
+  std::string output;
+  Toolchain toolchain;
+  const char* path{nullptr};
+  for (int i{1}; i < argc; ++i)
+  {
+    std::string arg{argv[i]};
+    if (arg == "--cpp")
+    {
+      cpp = true;
+    }
+    else if (arg == "--shared")
+    {
+      shared = true;
+    }
+    else if (arg == "--include" && i + 1 < argc)
+    {
+      toolchain.set_include(argv[++i]);
+    }
+    else if (arg == "--libraries" && i + 1 < argc)
+    {
+      toolchain.set_libraries(argv[++i]);
+    }
+    else if (arg == "-o" && i + 1 < argc)
+    {
+      output = argv[++i];
+    }
+    else
+    {
+      path = argv[i];
+    }
+  }
+  if (path == nullptr)
+  {
+    std::cerr << "usage: tyson-aot [--cpp | --shared] [--include dir] [--libraries list] [-o output] file" << std::endl;
+    return 1;
+  }
+  std::filesystem::path source{path};
+  if (output.empty())
+  {
+    output = source.stem().string() + (cpp ? ".cpp" : shared ? ".so" : "");
+  }
+
+  try
+  {
+    std::unique_ptr<Env> environment{std::make_unique<Env>()};
+    SyntaxTree tree{SyntaxTree::load_file(path)};
+    Optimizer optimizer{environment};
+    auto program{prepare(tree.to_ast(), environment, [&](size_t offset) { return tree.position(offset); }, &optimizer)};
+    std::string code{Translator::prelude() + Translator{environment}.translate(*program, "program") +
+                     (shared ? Translator::entry("program") : Translator::main({"program"}))};
+    std::string cpp_path{cpp ? output : output + ".cpp"};
+    std::ofstream{cpp_path} << code;
+    if (!cpp)
+    {
+      toolchain.build(cpp_path, output, shared);
+      std::filesystem::remove(cpp_path);
+    }
+  }
+  catch (const std::runtime_error& err)
+  {
+    std::cerr << path << ": " << err.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include "util/arena.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+Arena::Arena(size_t capacity)
+{
+  reserve(capacity);
+}
+
+Arena::Offset Arena::allocate(size_t size, size_t align)
+{
+  size_t start{(used_ + align - 1) & ~(align - 1)};
+  if (start + size > capacity_)
+  {
+    reserve(std::max(start + size, capacity_ * 2));
+  }
+  used_ = start + size;
+  return static_cast<Offset>(start);
+}
+
+void Arena::reserve(size_t capacity)
+{
+  if (capacity <= capacity_)
+  {
+    return;
+  }
+  if (capacity > std::numeric_limits<Offset>::max())
+  {
+    throw std::runtime_error("arena too large");
+  }
+  resize(capacity);
+}
+
+void Arena::shrink_to_fit()
+{
+  if (used_ < capacity_)
+  {
+    resize(used_);
+  }
+}
+
+void Arena::resize(size_t capacity)
+{
+  // new[] memory is aligned for any fundamental type
+  std::unique_ptr<std::byte[]> data{capacity ? new std::byte[capacity] : nullptr};
+  if (used_)
+  {
+    std::memcpy(data.get(), data_.get(), used_);
+  }
+  data_ = std::move(data);
+  capacity_ = capacity;
+}
@@ -0,0 +1,35 @@
+#include "util/hash.h"
+#include <cstring>
+
+namespace
+{
+constexpr uint64_t golden{0x9e3779b97f4a7c15ull};
+
+uint64_t mix(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+}
+
+uint64_t hash_bytes(std::string_view data, uint64_t seed)
+{
+  uint64_t h{seed ^ (data.size() * golden)};
+  const char* p{data.data()};
+  size_t left{data.size()};
+  for (; left >= 8; p += 8, left -= 8)
+  {
+    uint64_t word;
+    std::memcpy(&word, p, 8);
+    h = (h ^ mix(word)) * golden;
+    h = (h << 31) | (h >> 33);
+  }
+  uint64_t tail{0};
+  std::memcpy(&tail, p, left);
+  h ^= mix(tail ^ left);
+  return mix(h);
+}
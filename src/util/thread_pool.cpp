@@ -0,0 +1,113 @@
+#include "util/thread_pool.h"
+
+ThreadPool::ThreadPool(size_t threads)
+{
+  if (threads == 0)
+  {
+    threads = 1;
+  }
+  workers_.reserve(threads - 1);
+  for (size_t i{1}; i < threads; ++i)
+  {
+    workers_.emplace_back([this] { work(); });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard lock{mutex_};
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto& worker : workers_)
+  {
+    worker.join();
+  }
+}
+
+void ThreadPool::run(size_t count, const std::function<void(size_t)>& task)
+{
+  if (count == 0)
+  {
+    return;
+  }
+  std::unique_lock lock{mutex_};
+  task_ = &task;
+  count_ = count;
+  next_ = 0;
+  finished_ = 0;
+  error_ = nullptr;
+  ++generation_;
+  lock.unlock();
+  wake_.notify_all();
+
+  lock.lock();
+  ++busy_;
+  lock.unlock();
+  drain();
+  lock.lock();
+  --busy_;
+  // workers that woke late must be out before the task goes out of scope
+  done_.wait(lock, [this] { return finished_ == count_ && busy_ == 0; });
+  task_ = nullptr;
+  if (error_)
+  {
+    std::rethrow_exception(std::exchange(error_, nullptr));
+  }
+}
+
+void ThreadPool::work()
+{
+  size_t seen{0};
+  std::unique_lock lock{mutex_};
+  while (true)
+  {
+    wake_.wait(lock, [&] { return stop_ || (task_ && generation_ != seen); });
+    if (stop_)
+    {
+      return;
+    }
+    seen = generation_;
+    ++busy_;
+    lock.unlock();
+    drain();
+    lock.lock();
+    --busy_;
+    if (busy_ == 0)
+    {
+      done_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::drain()
+{
+  // takes parts one at a time until there are none left
+  std::unique_lock lock{mutex_};
+  while (next_ < count_)
+  {
+    size_t index{next_++};
+    const auto& task{*task_};
+    lock.unlock();
+    std::exception_ptr error;
+    try
+    {
+      task(index);
+    }
+    catch (...)
+    {
+      error = std::current_exception();
+    }
+    lock.lock();
+    if (error && !error_)
+    {
+      error_ = error;
+    }
+    ++finished_;
+  }
+  if (finished_ == count_)
+  {
+    done_.notify_all();
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef TYSON_HARNESS_H__
+#define TYSON_HARNESS_H__
+#include "ast/analysis.h"
+#include "engine/engine.h"
+#include "engine/optimizer.h"
+#include "parser/parser.h"
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// How the engine tests take programs from text to values
+
+// All of program as one form, lowered but with its names not resolved
+inline std::unique_ptr<AST> lowered(const std::string& program, std::unique_ptr<Env>& env)
+{
+  Parser parser{program};
+  return Analysis{env, [&](size_t offset) { return parser.position(offset); }}.lower(parser.parse());
+}
+
+// All of program as one form, as an engine compiles it
+inline std::unique_ptr<AST> prepared(const std::string& program, std::unique_ptr<Env>& env,
+                                     Optimizer* optimizer = nullptr)
+{
+  Parser parser{program};
+  return prepare(parser.parse(), env, [&](size_t offset) { return parser.position(offset); }, optimizer);
+}
+
+// What work gives as the REPL prints it, or "error: " and what it threw
+template <typename Work>
+std::string printed(Work work)
+{
+  std::ostringstream out;
+  try
+  {
+    out << work();
+  }
+  catch (const std::runtime_error& err)
+  {
+    out << "error: " << err.what();
+  }
+  return out.str();
+}
+
+// Compiles and runs program in env, which keeps what it defines
+inline std::string run(const std::string& program, Engine& engine, std::unique_ptr<Env>& env,
+                       Optimizer* optimizer = nullptr)
+{
+  return printed([&] { return compile(program, engine, env, optimizer)(env); });
+}
+
+// Compiles and runs program in an env of its own
+inline std::string run(const std::string& program, const std::string& engine, bool optimize = false)
+{
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  Optimizer optimizer{env};
+  return run(program, *Engine::factory(engine), env, optimize ? &optimizer : nullptr);
+}
+
+// Programs every engine and the AOT translator have to agree on
+inline const std::vector<std::string> corpus{
+  "(define fib (lambda (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))) (fib 15)",
+  "(define tak (lambda (x y z) (if (< y x) (tak (tak (- x 1) y z) (tak (- y 1) z x) (tak (- z 1) x y)) z)))"
+  " (tak 12 8 4)",
+  "(define adder (lambda (n) (lambda (x) (+ x n)))) ((adder 3) 4)",
+  "(define counter (let ((n 0)) (lambda () (set n (+ n 1)) n))) (counter) (counter) (counter)",
+  "(let ((x 1)) (+ (let ((x 10)) x) x))",
+  "(define f (lambda (n) (define even (lambda (k) (if (= k 0) true (odd (- k 1))))) "
+  "(define odd (lambda (k) (if (= k 0) false (even (- k 1))))) (even n))) (f 7)",
+  "(define build (lambda (n acc) (if (= n 0) acc (build (- n 1) (cons n acc))))) (build 5 (list))",
+  "(define sum (lambda (l) (if l (+ (car l) (sum (cdr l))) 0))) (sum '(1 2 3 4))",
+  "(define x 1) (define f (lambda () (set x 2))) (f) x",
+  "(if nil 1 2)",
+  "(let () )",
+  "((lambda (f) (f 1 2)) +)",
+  // arithmetic on ints carries on in double when it overflows
+  "(define f (lambda (a b) (+ a b))) (f 2147483647 1)",
+  // errors
+  "(+ 1 missing)",
+  "(set missing 1)",
+  "((lambda (x) x))",
+  "(1 2)",
+  "(+ 1 \"a\")",
+  // code that was compiled for a global sees it redefined
+  "(define f (lambda (a b) (+ a b))) (f 1 2) (set + -) (f 5 2)",
+  "(define g (lambda () 1)) (define f (lambda () (g))) (f) (define g (lambda () 2)) (f)",
+};
+
+#endif // TYSON_HARNESS_H__
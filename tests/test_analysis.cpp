@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include "harness.h"
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+std::string run(const std::string& program, bool analyze)
+{
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  std::unique_ptr<AST> ast{analyze ? lowered(program, env) : Parser{program}.parse()};
+  return printed([&] { return ast->eval(env).execute(env); });
+}
+
+std::string analysis_error(const std::string& program)
+{
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  try
+  {
+    lowered(program, env);
+  }
+  catch (const std::runtime_error& err)
+  {
+    return err.what();
+  }
+  return "";
+}
+}
+
+TEST(AnalysisMatchesEval, ParserTests)
+{
+  const std::string programs[]{
+    "(define sq (lambda (x) (* x x))) (sq 4)",
+    "(let ((y 1) (z 2)) (+ y z))",
+    "(define y 1) (set y 5) y",
+    "(let ((y 1)) (set y 2) y)",
+    "((lambda (x y) (+ x y)) 1 2)",
+    "(define a 2) (define b (let ((a 10)) (* a 3))) (+ a b)",
+    "(if (< 1 2) (let ((x 4)) x) 0)",
+    "(define add (lambda (x y) (+ x y))) (add (add 1 2) (add 3 4))",
+  };
+  for (const auto& program : programs)
+  {
+    EXPECT_EQ(run(program, true), run(program, false)) << program;
+  }
+  // empty binding and parameter lists only work lowered
+  EXPECT_EQ(run("(define f (lambda () (+ 3 4))) (f)", true), "7");
+  EXPECT_EQ(run("(let () 3)", true), "3");
+}
+
+TEST(AnalysisNodes, ParserTests)
+{
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  auto ast{lowered("(define x 1) (set x 2) (let ((a x) (b 2)) a) (lambda (p) p) '(let 1) (+ x (let () 1))", env)};
+  auto start{static_cast<ASTStart*>(ast.get())};
+  ASSERT_EQ(start->size(), 6);
+  EXPECT_NE(dynamic_cast<ASTLoweredDefine*>(start->get_child_at(0)), nullptr);
+  EXPECT_NE(dynamic_cast<ASTLoweredSet*>(start->get_child_at(1)), nullptr);
+  EXPECT_NE(dynamic_cast<ASTLoweredLet*>(start->get_child_at(2)), nullptr);
+  EXPECT_NE(dynamic_cast<ASTLoweredLambda*>(start->get_child_at(3)), nullptr);
+  // quoted forms are data and stay as parsed
+  std::vector<const AST*> quoted;
+  start->get_child_at(4)->append_children(quoted);
+  ASSERT_EQ(quoted.size(), 1);
+  EXPECT_EQ(dynamic_cast<const ASTLoweredLet*>(quoted[0]), nullptr);
+  // special forms in any other list are lowered
+  auto call{static_cast<ASTList*>(start->get_child_at(5))};
+  EXPECT_NE(dynamic_cast<ASTLoweredLet*>(call->get_child_at(2)), nullptr);
+  // the lowered nodes keep the offsets and types of the ones they replace
+  EXPECT_EQ(start->get_child_at(2)->type(), AST::Type::let);
+  EXPECT_EQ(start->get_child_at(2)->offset(), 24);
+}
+
+TEST(AnalysisErrors, ParserTests)
+{
+  EXPECT_EQ(analysis_error("(define 1 2)"), "define takes a name and a value at line 1, column 2");
+  EXPECT_EQ(analysis_error("(define x)"), "define takes a name and a value at line 1, column 2");
+  EXPECT_EQ(analysis_error("(set (x) 2)"), "set takes a name and a value at line 1, column 2");
+  EXPECT_EQ(analysis_error("(let x 1)"), "let takes a list of bindings at line 1, column 2");
+  EXPECT_EQ(analysis_error("(let (x) x)"), "a let binding is a name and a value at line 1, column 7");
+  EXPECT_EQ(analysis_error("(let ((x 1 2)) x)"), "a let binding is a name and a value at line 1, column 7");
+  EXPECT_EQ(analysis_error("(let ((1 2)) 3)"), "a let binding is a name and a value at line 1, column 7");
+  EXPECT_EQ(analysis_error("(lambda)"), "lambda takes a list of parameters at line 1, column 2");
+  EXPECT_EQ(analysis_error("\n(lambda (x 1) x)"), "a lambda parameter is a name at line 2, column 12");
+  EXPECT_EQ(analysis_error("(if 1 2)"), "if takes a test, a then and an else form at line 1, column 2");
+  EXPECT_EQ(analysis_error("(quote)"), "quote takes one form at line 1, column 2");
+  EXPECT_EQ(analysis_error("(+ 1 (let (y) y))"), "a let binding is a name and a value at line 1, column 12");
+  EXPECT_EQ(analysis_error("'(let x) '(define)"), "");
+}
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include "aot/translator.h"
+#include "harness.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+// What only the translator runs, on top of the corpus
+const std::vector<std::string> programs{
+  "'(a \"b\\n\" 1.5 (true nil))",
+  "(* 1.5 2)",
+  "(< 1 2.5)",
+  // tail calls, short enough to keep the interpreter quick
+  "(define loop (lambda (n acc) (if (= n 0) acc (loop (- n 1) (+ acc 2))))) (loop 10000 0)",
+  "(define even (lambda (n) (if (= n 0) true (odd (- n 1))))) "
+  "(define odd (lambda (n) (if (= n 0) false (even (- n 1))))) (even 10001)",
+  // errors
+  "(f 1) (define f (lambda (x) x))",
+  "(define f (lambda (x) x)) (f 1 2)",
+  // inlined calls see what they called redefined
+  "(define sq (lambda (x) (* x x))) (define f (lambda (n) (+ (sq n) 1))) (f 3) (define sq (lambda (x) x)) (f 3)",
+  "(define f (lambda () (g))) (define g (lambda () 1)) (define h (lambda () (g))) (h) (set g +) (h)",
+};
+
+std::string translate(const std::string& program, const std::string& name, bool optimize = false)
+{
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  Optimizer optimizer{env};
+  return Translator{env}.translate(*prepared(program, env, optimize ? &optimizer : nullptr), name);
+}
+}
+
+TEST(AotMatchesInterpreter, LispTests)
+{
+  Toolchain toolchain;
+  if (!toolchain.available())
+  {
+    GTEST_SKIP() << "no compiler to build translated code with";
+  }
+  std::vector<std::string> all{corpus};
+  all.insert(all.end(), programs.begin(), programs.end());
+  std::string code{Translator::prelude()};
+  std::vector<std::string> names;
+  for (size_t i{0}; i < all.size(); ++i)
+  {
+    names.push_back("program_" + std::to_string(i));
+    code += translate(all[i], names.back());
+    // and as tyson-aot has it, after the optimizer
+    names.push_back("optimized_" + std::to_string(i));
+    code += translate(all[i], names.back(), true);
+  }
+  code += Translator::main(names);
+
+  auto directory{std::filesystem::temp_directory_path() / ("tyson_aot_" + std::to_string(getpid()))};
+  std::filesystem::create_directories(directory);
+  std::string source{(directory / "programs.cpp").string()};
+  std::string executable{(directory / "programs").string()};
+  std::ofstream{source} << code;
+  toolchain.set_flags("-O0");
+  ASSERT_NO_THROW(toolchain.build(source, executable, false));
+
+  std::string output;
+  FILE* pipe{popen((executable + " 2>&1").c_str(), "r")};
+  ASSERT_NE(pipe, nullptr);
+  char buffer[256];
+  while (fgets(buffer, sizeof(buffer), pipe) != nullptr)
+  {
+    output += buffer;
+  }
+  pclose(pipe);
+  std::filesystem::remove_all(directory);
+
+  std::istringstream lines{output};
+  for (const auto& program : all)
+  {
+    std::string expected{run(program, "tree")};
+    std::string line;
+    std::getline(lines, line);
+    EXPECT_EQ(line, expected) << program;
+    std::getline(lines, line);
+    EXPECT_EQ(line, expected) << "optimized: " << program;
+  }
+}
+
+TEST(AotDirectCalls, LispTests)
+{
+  // a global defined once to a lambda is a C++ function called by name
+  std::string code{translate("(define f (lambda (x) x)) (f 1)", "p")};
+  EXPECT_NE(code.find("Value global_0(std::unique_ptr<Env>& env, Value a0)"), std::string::npos) << code;
+  EXPECT_NE(code.find("global_0(env, "), code.rfind("Value global_0(")) << code;
+  // one that is set is called through its global
+  code = translate("(define f (lambda (x) x)) (set f 1)", "p");
+  EXPECT_EQ(code.find("global_0"), std::string::npos) << code;
+  // so are + and the others once a program changes them
+  EXPECT_NE(translate("(+ 1 2)", "p").find("aot::builtin<aot::Builtin::add>"), std::string::npos);
+  EXPECT_EQ(translate("(define + -) (+ 1 2)", "p").find("aot::builtin"), std::string::npos);
+}
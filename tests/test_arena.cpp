@@ -0,0 +1,23 @@
+#include <gtest/gtest.h>
+#include "util/arena.h"
+
+TEST(ArenaOffsetsSurviveGrowth, UtilTests)
+{
+  Arena arena{8};
+  Arena::Offset first{arena.allocate<int>(1)};
+  *arena.at<int>(first) = 42;
+  Arena::Offset doubles{arena.allocate<double>(100)};
+  EXPECT_EQ(doubles % alignof(double), 0);
+  for (size_t i{0}; i < 100; ++i)
+  {
+    arena.at<double>(doubles)[i] = i / 2.0;
+  }
+  EXPECT_GE(arena.capacity(), arena.size());
+  EXPECT_EQ(*arena.at<int>(first), 42);
+  EXPECT_EQ(arena.at<double>(doubles)[99], 49.5);
+  arena.shrink_to_fit();
+  EXPECT_EQ(arena.capacity(), arena.size());
+  EXPECT_EQ(arena.at<double>(doubles)[10], 5);
+  arena.clear();
+  EXPECT_EQ(arena.size(), 0);
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include "engine/bytecode.h"
+#include "harness.h"
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+// What only the engines run, on top of the corpus
+const std::string programs[]{
+  // arithmetic on doubles, and on an int and a double
+  "(define f (lambda (a b) (* a b))) (f 1.5 2)",
+  "(define f (lambda (a b) (< a b))) (f 1 2.5)",
+  // code that was compiled for the primitive sees it redefined
+  "(define f (lambda (a b) (- a b))) (f 1 2) (define - (lambda (a b) a)) (f 5 2)",
+  "(define f (lambda (a b) (= a b))) (f 1 1) (set = <) (f 1 1)",
+  // and calls that specialised on what they saw see something else
+  "(define f (lambda (a b) (+ a b))) (f 1 2) (f 1.5 2.5) (f 1 2.5) (f 2147483647 1)",
+  "(define f (lambda (a b) (< a b))) (f 1.5 2.5) (f 1 2) (f \"a\" 1)",
+  "(define g (lambda () 1)) (define f (lambda () (g))) (f) (set g +) (f)",
+  // tail calls
+  "(define loop (lambda (n acc) (if (= n 0) acc (loop (- n 1) (+ acc 1))))) (loop 1000 0)",
+  "(define even (lambda (n) (if (= n 0) true (odd (- n 1))))) "
+  "(define odd (lambda (n) (if (= n 0) false (even (- n 1))))) (even 1001)",
+  "(define f (lambda (n) (let ((m (- n 1))) (if (= m 0) 0 (f m))))) (f 1000)",
+  "(define apply1 (lambda (g x) (g x))) (apply1 (lambda (y) (* y 2)) 21)",
+  "(define collect (lambda (n acc) (if (= n 0) acc (collect (- n 1) (cons (lambda () n) acc))))) "
+  "(define l (collect 3 (list))) (+ ((car l)) ((car (cdr l))))",
+  "(define f (lambda (n) (f n n))) (f 1)",
+  "(define f (lambda () (1 2))) (f)",
+  // folded calls and pruned branches
+  "(define f (lambda (n) (+ n (* 2 (- 10 4))))) (f 1)",
+  "(define f (lambda () (if (< 1 2) 1 (car 1)))) (f)",
+  "(define f (lambda () (+ 1 2))) (f) (set + -) (f)",
+  "(define f (lambda () (if (< 1 2) 1 2))) (f) (define < (lambda (a b) false)) (f)",
+  "(define f (lambda (n) 1 n (lambda () n) (if n 2 3) n)) (f 4)",
+  "(/ 1 0)",
+  // inlined calls
+  "(define square (lambda (x) (* x x))) (define add (lambda (a b) (+ a b))) "
+  "(define f (lambda (n acc) (if (= n 0) acc (f (- n 1) (add acc (square n)))))) (f 10 0)",
+  "(define sq (lambda (x) (* x x))) (define f (lambda (n) (sq (+ n 1)))) (f 3) (define sq (lambda (x) x)) (f 3)",
+  "(define id (lambda (x) x)) (define f (lambda () (id 1))) (f) (set id car) (f)",
+  "(define first (lambda (l) (car l))) (first 1)",
+  "(define step (lambda (n) (loop (- n 1)))) (define loop (lambda (n) (if (= n 0) 0 (step n)))) (loop 1000)",
+  "(define h nil) (define g (lambda (x) (h) x)) (define f (lambda (n) (set h (lambda () (set n 5))) (g n))) (f 1)",
+  "(define two (lambda (a b) b)) (define f (lambda () (two (car 1) 2))) (f)",
+  // a right operand that sets the left one does not change what was read
+  "(define f (lambda (x) (- x (set x 5)))) (f 1)",
+  "(define f (lambda (x) (if (< x (set x 0)) 1 2))) (f -1)",
+};
+}
+
+TEST(EnginesAgree, LispTests)
+{
+  std::vector<std::string> all{corpus};
+  all.insert(all.end(), std::begin(programs), std::end(programs));
+  for (const auto& program : all)
+  {
+    std::string tree{run(program, "tree")};
+    for (const auto& engine : Engine::names())
+    {
+      EXPECT_EQ(run(program, engine), tree) << engine << ": " << program;
+      EXPECT_EQ(run(program, engine, true), tree) << engine << " optimized: " << program;
+    }
+  }
+  EXPECT_EQ(run("(define fib (lambda (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))) (fib 15)", "vm"), "610");
+  EXPECT_THROW(Engine::factory("none"), std::runtime_error);
+}
+
+TEST(MachineCalls, LispTests)
+{
+  // calls between compiled lambdas do not use the C++ stack
+  EXPECT_EQ(run("(define down (lambda (n) (if (= n 0) 0 (+ 1 (down (- n 1)))))) (down 200000)", "vm"), "200000");
+}
+
+TEST(CompilerCode, LispTests)
+{
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  auto function{Compiler{}.compile(*prepared("(lambda (n) (if (< n 2) n 0))", env))};
+  ASSERT_EQ(function->functions.size(), 1);
+  std::ostringstream out;
+  out << *function->functions[0];
+  EXPECT_EQ(out.str(),
+    "0 local 0 0\n"
+    "1 constant 0 0\n"
+    "2 call_global 2 " + std::to_string(env->intern("<")) + "\n"
+    "3 jump_if_false 6 0\n"
+    "4 local 0 0\n"
+    "5 jump 7 0\n"
+    "6 constant 1 0\n"
+    "7 ret 0 0\n");
+}
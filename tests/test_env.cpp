@@ -1,2 +1,34 @@
 #include <gtest/gtest.h>
 #include "lisp/env.h"
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+TEST(EnvIntegerArithmetic, LispTests)
+{
+  Env env;
+  Value add{env.lookup("+")};
+  ASSERT_TRUE(add.is_primitive());
+  std::vector<Value> args{Value{Number{2}}, Value{Number{3}}};
+  Value sum{add.as_primitive()(args)};
+  EXPECT_TRUE(sum.as_number().is_int());
+  EXPECT_EQ(sum.as_number().as_int(), 5);
+
+  args.push_back(Value{Number{0.5}});
+  sum = add.as_primitive()(args);
+  EXPECT_FALSE(sum.as_number().is_int());
+  EXPECT_NEAR(sum.as_number().as_double(), 5.5, 1e-9);
+
+  Value div{env.lookup("/")};
+  std::vector<Value> exact{Value{Number{6}}, Value{Number{3}}};
+  EXPECT_TRUE(div.as_primitive()(exact).as_number().is_int());
+  std::vector<Value> inexact{Value{Number{7}}, Value{Number{2}}};
+  EXPECT_NEAR(div.as_primitive()(inexact).as_number().as_double(), 3.5, 1e-9);
+
+  std::vector<Value> overflow{Value{Number{std::numeric_limits<int>::max()}}, Value{Number{1}}};
+  Value big{add.as_primitive()(overflow)};
+  EXPECT_FALSE(big.as_number().is_int());
+  // a double is never read as an int
+  EXPECT_THROW(big.as_number().as_int(), std::runtime_error);
+  EXPECT_THROW(Number{std::numeric_limits<double>::infinity()}.as_int(), std::runtime_error);
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "engine/jit.h"
+#include "harness.h"
+#include <string>
+
+namespace
+{
+// Runs programs on the jit engine in one env, compiling on the first call
+class Jitted
+{
+public:
+  Jitted() { Jit::set_threshold(1); }
+  ~Jitted()
+  {
+    Jit::set_threshold(1000);
+    Jit::set_enabled(true);
+  }
+
+  std::string run(const std::string& program) { return ::run(program, engine_, env_); }
+
+  bool compiled(const std::string& name)
+  {
+    Value* value{env_->global(env_->intern(name))};
+    auto* body{dynamic_cast<JitBody*>(&value->as_procedure().body())};
+    return body != nullptr && body->state().compiled();
+  }
+private:
+  JitEngine engine_;
+  std::unique_ptr<Env> env_{std::make_unique<Env>()};
+};
+}
+
+TEST(JitCompiles, LispTests)
+{
+  if (!Jit::supported())
+  {
+    GTEST_SKIP();
+  }
+  Jitted jitted;
+  jitted.run("(define fib (lambda (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))");
+  jitted.run("(define tak (lambda (x y z) (if (< y x) (tak (tak (- x 1) y z) (tak (- y 1) z x) (tak (- z 1) x y)) z)))");
+  jitted.run("(define less (lambda (a b) (< a b)))");
+  EXPECT_EQ(jitted.run("(fib 20)"), "6765");
+  EXPECT_TRUE(jitted.compiled("fib"));
+  EXPECT_EQ(jitted.run("(tak 18 12 6)"), "7");
+  EXPECT_TRUE(jitted.compiled("tak"));
+  EXPECT_EQ(jitted.run("(less 1 2)"), "True");
+  EXPECT_TRUE(jitted.compiled("less"));
+}
+
+TEST(JitFallsBack, LispTests)
+{
+  if (!Jit::supported())
+  {
+    GTEST_SKIP();
+  }
+  Jitted jitted;
+  jitted.run("(define add (lambda (a b) (+ a b)))");
+  EXPECT_EQ(jitted.run("(add 1 2)"), "3");
+  EXPECT_TRUE(jitted.compiled("add"));
+  // the native code gives up and the interpreter has the answer
+  EXPECT_EQ(jitted.run("(add 2147483647 1)"), jitted.run("(+ 2147483647.0 1)"));
+  EXPECT_EQ(jitted.run("(add 1.5 2)"), "3.5");
+  EXPECT_EQ(jitted.run("(add 1 \"a\")"), "error: trying to add not a number");
+  jitted.run("(set + -)");
+  EXPECT_EQ(jitted.run("(add 5 2)"), "3");
+  EXPECT_FALSE(jitted.compiled("add"));
+
+  // anything but ints stays in the interpreter
+  jitted.run("(define first (lambda (l) (car l)))");
+  EXPECT_EQ(jitted.run("(first '(1 2))"), "1");
+  EXPECT_FALSE(jitted.compiled("first"));
+}
+
+TEST(JitCallsInterpreted, LispTests)
+{
+  if (!Jit::supported())
+  {
+    GTEST_SKIP();
+  }
+  Jitted jitted;
+  jitted.run("(define g (lambda (x) (car (list x)))) (define f (lambda (x) (* 2 (g x))))");
+  EXPECT_EQ(jitted.run("(f 4)"), "8");
+  EXPECT_EQ(jitted.run("(f 5)"), "10");
+  jitted.run("(define g (lambda (x) (+ x 1)))");
+  EXPECT_EQ(jitted.run("(f 5)"), "12");
+  EXPECT_TRUE(jitted.compiled("g"));
+}
+
+TEST(JitSwitchedOff, LispTests)
+{
+  Jitted jitted;
+  Jit::set_enabled(false);
+  jitted.run("(define add (lambda (a b) (+ a b)))");
+  EXPECT_EQ(jitted.run("(add 1 2)"), "3");
+  EXPECT_FALSE(jitted.compiled("add"));
+}
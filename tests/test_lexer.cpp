@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "lexer/lexer.h"
+#include <cmath>
 
 TEST(LexerParents, LexerTests)
 {
@@ -8,8 +9,9 @@ TEST(LexerParents, LexerTests)
   Lexer lexer{text};
   Token t{lexer.token()};
   EXPECT_EQ(t.type(), Token::Type::open);
-  EXPECT_EQ(1, t.line());
-  EXPECT_EQ(1, t.column());
+  EXPECT_EQ(0, t.offset());
+  EXPECT_EQ(1, lexer.position(t).line);
+  EXPECT_EQ(1, lexer.position(t).column);
 }
 
 TEST(LexerParseNumber, LexerTests)
@@ -44,3 +46,79 @@ TEST(LexerParseSrc, LexerTests)
   token = lexer.token();
   EXPECT_EQ(token.type(), Token::Type::END);
 }
+
+TEST(LexerStringViews, LexerTests)
+{
+  const std::string text{R"END((print "plain" "es\"caped"))END"};
+  Lexer lexer{text};
+  Token token{lexer.token()};
+  token = lexer.token();
+  EXPECT_EQ(token.type(), Token::Type::symbol);
+  EXPECT_EQ(token.string(), "print");
+  token = lexer.token();
+  EXPECT_EQ(token.type(), Token::Type::string);
+  EXPECT_EQ(token.string(), "plain");
+  EXPECT_FALSE(token.owns_text());
+  token = lexer.token();
+  EXPECT_EQ(token.type(), Token::Type::string);
+  EXPECT_EQ(token.string(), "es\"caped");
+  EXPECT_TRUE(token.owns_text());
+  lexer.push_back(token);
+  Token again{lexer.token()};
+  EXPECT_EQ(again.string(), "es\"caped");
+}
+
+TEST(LexerIntegerNumbers, LexerTests)
+{
+  Lexer lexer{"42 -7 +3 4.5 1e3 -2.5e-1 99999999999"};
+  Token token{lexer.token()};
+  EXPECT_TRUE(token.is_integer());
+  EXPECT_EQ(token.integer(), 42);
+  token = lexer.token();
+  EXPECT_TRUE(token.is_integer());
+  EXPECT_EQ(token.integer(), -7);
+  token = lexer.token();
+  EXPECT_TRUE(token.is_integer());
+  EXPECT_EQ(token.integer(), 3);
+  token = lexer.token();
+  EXPECT_FALSE(token.is_integer());
+  EXPECT_NEAR(token.number(), 4.5, 1e-9);
+  token = lexer.token();
+  EXPECT_FALSE(token.is_integer());
+  EXPECT_NEAR(token.number(), 1000, 1e-9);
+  token = lexer.token();
+  EXPECT_NEAR(token.number(), -0.25, 1e-9);
+  token = lexer.token();
+  EXPECT_FALSE(token.is_integer());
+  EXPECT_NEAR(token.number(), 99999999999.0, 1e-9);
+}
+
+TEST(LexerOutOfRangeNumbers, LexerTests)
+{
+  // too big for a double is infinite, too small is zero
+  Lexer lexer{"1e999 -1e999 +1e999 1e-999"};
+  Token token{lexer.token()};
+  EXPECT_EQ(token.number(), HUGE_VAL);
+  token = lexer.token();
+  EXPECT_EQ(token.number(), -HUGE_VAL);
+  token = lexer.token();
+  EXPECT_EQ(token.number(), HUGE_VAL);
+  token = lexer.token();
+  EXPECT_EQ(token.number(), 0.0);
+}
+
+TEST(LexerPositions, LexerTests)
+{
+  Lexer lexer{"(a\n  bc\n\n\"d\")"};
+  Token token{lexer.token()};
+  token = lexer.token();
+  token = lexer.token();
+  EXPECT_EQ(token.string(), "bc");
+  EXPECT_EQ(token.offset(), 5);
+  EXPECT_EQ(lexer.position(token).line, 2);
+  EXPECT_EQ(lexer.position(token).column, 3);
+  token = lexer.token();
+  EXPECT_EQ(token.type(), Token::Type::string);
+  EXPECT_EQ(lexer.position(token).line, 4);
+  EXPECT_EQ(lexer.position(token).column, 1);
+}
@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+#include "ast/resolver.h"
+#include "harness.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+// Compiles every form before running any like a file, or each just before
+// it runs like the REPL, and gives the value of the last
+std::string run_forms(const std::vector<std::string>& forms, const std::string& engine, bool file)
+{
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  Optimizer optimizer{env};
+  auto factory{Engine::factory(engine)};
+  std::vector<Engine::Program> programs;
+  return printed([&] {
+    Value last;
+    for (const auto& form : forms)
+    {
+      programs.push_back(compile(form, *factory, env, &optimizer));
+      if (!file)
+      {
+        last = programs.back()(env);
+      }
+    }
+    for (auto& program : programs)
+    {
+      last = file ? program(env) : last;
+    }
+    return last;
+  });
+}
+
+Optimizer::Stats stats(const std::string& form)
+{
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  Optimizer optimizer{env};
+  prepared(form, env, &optimizer);
+  return optimizer.stats();
+}
+}
+
+TEST(OptimizerFolds, LispTests)
+{
+  EXPECT_EQ(stats("(* 2 5)").folded, 1u);
+  EXPECT_EQ(stats("(+ 1 (* 2 (- 10 4)))").folded, 3u);
+  EXPECT_EQ(stats("(< 1 2.5)").folded, 1u);
+  // only constant numbers
+  EXPECT_EQ(stats("(lambda (n) (+ n 1))").folded, 0u);
+  EXPECT_EQ(stats("(+ 1 \"a\")").folded, 0u);
+  EXPECT_EQ(stats("(f 1 2)").folded, 0u);
+  EXPECT_EQ(stats("(+ 1 2 3)").folded, 0u);
+
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  Optimizer optimizer{env};
+  auto form{prepared("(+ 1 (* 2 3))", env, &optimizer)};
+  // one guard on both builtins, the call it was is kept for when it fails
+  std::vector<const AST*> forms;
+  form->append_children(forms);
+  ASSERT_EQ(forms.size(), 1u);
+  auto* guard{dynamic_cast<const ASTGuard*>(forms[0])};
+  ASSERT_NE(guard, nullptr);
+  EXPECT_EQ(guard->guards().size(), 2u);
+  EXPECT_NE(dynamic_cast<const ASTConstant*>(&guard->fast()), nullptr);
+  EXPECT_NE(dynamic_cast<const ASTCall*>(&guard->slow()), nullptr);
+  EXPECT_EQ(Engine::factory("tree")->compile(std::move(form))(env).as_number().as_int(), 7);
+}
+
+TEST(OptimizerGuards, LispTests)
+{
+  for (const auto& engine : Engine::names())
+  {
+    for (bool file : {true, false})
+    {
+      EXPECT_EQ(run_forms({"(define f (lambda () (+ 1 2)))", "(set + -)", "(f)"}, engine, file), "-1") << engine;
+      EXPECT_EQ(run_forms({"(define f (lambda () (* 2 3)))", "(f)", "(define * (lambda (a b) a))", "(f)"}, engine, file),
+                "2")
+          << engine;
+      EXPECT_EQ(run_forms({"(set + -)", "(+ 5 2)"}, engine, file), "3") << engine;
+      EXPECT_EQ(run_forms({"(define f (lambda () (+ 1 2)))", "(f)"}, engine, file), "3") << engine;
+    }
+  }
+  // a builtin that is already something else is not folded
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  Optimizer optimizer{env};
+  run("(set + -)", *Engine::factory("tree"), env, &optimizer);
+  prepared("(+ 5 2)", env, &optimizer);
+  EXPECT_EQ(optimizer.stats().folded, 0u);
+}
+
+TEST(OptimizerPrunes, LispTests)
+{
+  EXPECT_EQ(stats("(if true 1 (car 1))").pruned, 1u);
+  EXPECT_EQ(stats("(if nil (car 1) 2)").pruned, 1u);
+  EXPECT_EQ(stats("(lambda (n) (if n 1 2))").pruned, 0u);
+  // the test of a fold is kept, its builtin may yet change
+  EXPECT_EQ(stats("(if (< 1 2) 1 2)").pruned, 0u);
+  for (const auto& engine : Engine::names())
+  {
+    EXPECT_EQ(run_forms({"(if true 1 (car 1))"}, engine, true), "1") << engine;
+    EXPECT_EQ(run_forms({"(if nil (car 1) 2)"}, engine, true), "2") << engine;
+  }
+}
+
+TEST(OptimizerDrops, LispTests)
+{
+  EXPECT_EQ(stats("(lambda (n) 1 n (lambda () n) n)").dropped, 3u);
+  EXPECT_EQ(stats("(let ((x 1)) 2 x)").dropped, 1u);
+  // statements that may have an effect or fail stay
+  EXPECT_EQ(stats("(lambda (n) (f n) (set n 1) missing n)").dropped, 0u);
+  // and so does everything at the top level, where the REPL prints it
+  EXPECT_EQ(stats("1 2 3").dropped, 0u);
+  // the last statement is the value
+  EXPECT_EQ(stats("(lambda (n) n)").dropped, 0u);
+  for (const auto& engine : Engine::names())
+  {
+    EXPECT_EQ(run_forms({"(define f (lambda (n) 1 n (if n 2 3) n))", "(f 4)"}, engine, true), "4") << engine;
+  }
+}
+
+TEST(OptimizerInlines, LispTests)
+{
+  EXPECT_EQ(stats("(define sq (lambda (x) (* x x))) (define f (lambda (n) (sq n))) (sq 2)").inlined, 2u);
+  // an argument read more than once is only inlined when it is a constant
+  // or a local nothing sets
+  EXPECT_EQ(stats("(define sq (lambda (x) (* x x))) (define f (lambda (n) (sq (+ n 1))))").inlined, 0u);
+  EXPECT_EQ(stats("(define sq (lambda (x) (* x x))) (define f (lambda (n) (set n 1) (sq n)))").inlined, 0u);
+  // one read once is evaluated there, as long as nothing that can fail or
+  // have an effect comes before it
+  EXPECT_EQ(stats("(define inc (lambda (x) (+ x 1))) (define f (lambda (n) (inc (* n 2))))").inlined, 1u);
+  EXPECT_EQ(stats("(define inc (lambda (x) (+ x 1))) (define f (lambda (n) (inc (car n))))").inlined, 0u);
+  EXPECT_EQ(stats("(define g (lambda (x) (h) x)) (define f (lambda (n) (g (+ n 1))))").inlined, 0u);
+  EXPECT_EQ(stats("(define g (lambda (x) (if x 1 2))) (define f (lambda (n) (g (+ n 1))))").inlined, 1u);
+  EXPECT_EQ(stats("(define g (lambda (x y) (if y x 2))) (define f (lambda (n) (g (+ n 1) n)))").inlined, 0u);
+  EXPECT_EQ(stats("(define g (lambda (x y) (- y x))) (define f (lambda (n) (g (+ n 1) (+ n 2))))").inlined, 0u);
+  EXPECT_EQ(stats("(define g (lambda (x y) (- x y))) (define f (lambda (n) (g (+ n 1) (+ n 2))))").inlined, 1u);
+  // nor are lambdas that call themselves, are too big or have locals
+  EXPECT_EQ(stats("(define f (lambda (n) (if (= n 0) 0 (f (- n 1))))) (f 2)").inlined, 0u);
+  EXPECT_EQ(stats("(define f (lambda (n) (+ n (+ n (+ n (+ n (+ n (+ n (+ n (+ n (+ n n))))))))))) (f 2)").inlined, 0u);
+  EXPECT_EQ(stats("(define f (lambda (n) (define m n) m)) (f 2)").inlined, 0u);
+  EXPECT_EQ(stats("(define f (lambda (n) (lambda () n))) (f 2)").inlined, 0u);
+  EXPECT_EQ(stats("(define f (lambda (n) n)) (f 1 2)").inlined, 0u);
+  // or what a global was set to
+  EXPECT_EQ(stats("(define f 1) (set f (lambda (n) n)) (f 2)").inlined, 0u);
+  EXPECT_EQ(stats("(define f (lambda (n) n)) (define f 1) (f 2)").inlined, 0u);
+}
+
+TEST(OptimizerInlineGuards, LispTests)
+{
+  for (const auto& engine : Engine::names())
+  {
+    for (bool file : {true, false})
+    {
+      EXPECT_EQ(run_forms({"(define sq (lambda (x) (* x x)))", "(define f (lambda (n) (sq n)))", "(f 3)"}, engine, file),
+                "9")
+          << engine;
+      EXPECT_EQ(run_forms({"(define sq (lambda (x) (* x x)))", "(define f (lambda (n) (sq n)))", "(f 3)",
+                     "(define sq (lambda (x) x))", "(f 3)"},
+                    engine, file),
+                "3")
+          << engine;
+      EXPECT_EQ(run_forms({"(define sq (lambda (x) (* x x)))", "(define f (lambda (n) (sq n)))",
+                     "(set sq (lambda (x) (+ x 1)))", "(f 3)"},
+                    engine, file),
+                "4")
+          << engine;
+      // a define that never ran defined nothing
+      EXPECT_EQ(run_forms({"(if nil (define id (lambda (x) x)) 0)", "(id 1)"}, engine, file),
+                "error: Could not find symbol id")
+          << engine;
+    }
+  }
+}
+
+TEST(OptimizerStats, LispTests)
+{
+  std::ostringstream out;
+  out << stats("(define one (lambda () 1)) (lambda () 1 (if true (+ (one) 2) 3))");
+  EXPECT_EQ(out.str(), "inline: 1 calls inlined\nfold: 1 calls folded\nprune: 1 branches pruned\n"
+                       "drop: 1 statements dropped\n");
+}
@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 #include "parser/parser.h"
+#include "util/thread_pool.h"
 #include <iostream>
+#include <sstream>
+#include <vector>
 
 TEST(ParserConstructor, ParserTests)
 {
@@ -17,3 +20,169 @@ TEST(ParserConstructor, ParserTests)
   //parsed->get_child()->output(std::cout);
 }
 
+
+TEST(ParserAllForms, ParserTests)
+{
+  Parser parser{"(define x 2)\n'quoted\n(+ x 3)"};
+  std::unique_ptr<AST> parsed{parser.parse()};
+  auto start{static_cast<ASTStart*>(parsed.get())};
+  ASSERT_EQ(start->size(), 3);
+  EXPECT_EQ(start->get_child_at(0)->type(), AST::Type::define);
+  EXPECT_EQ(start->get_child_at(1)->type(), AST::Type::quote);
+  EXPECT_EQ(start->get_child_at(2)->type(), AST::Type::list);
+
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  Value result{parsed->eval(env).execute(env)};
+  ASSERT_TRUE(result.is_number());
+  EXPECT_EQ(result.as_number().as_int(), 5);
+}
+
+TEST(ParserNextForm, ParserTests)
+{
+  Parser parser{"1 \"two\" (three) '(4 5) ''six () (quote 7)"};
+  std::vector<AST::Type> expected{AST::Type::number, AST::Type::string, AST::Type::list,
+    AST::Type::quote, AST::Type::quote, AST::Type::nil, AST::Type::quote};
+  for (AST::Type type : expected)
+  {
+    std::unique_ptr<AST> form{parser.next_form()};
+    ASSERT_NE(form, nullptr);
+    EXPECT_EQ(form->type(), type);
+  }
+  EXPECT_EQ(parser.next_form(), nullptr);
+  EXPECT_EQ(parser.next_form(), nullptr);
+}
+
+TEST(ParserFromLexer, ParserTests)
+{
+  // the parser takes the lexer over where it stopped
+  Lexer lexer{"skipped (two) 3"};
+  lexer.token();
+  Parser parser{std::move(lexer)};
+  std::unique_ptr<AST> form{parser.next_form()};
+  ASSERT_NE(form, nullptr);
+  EXPECT_EQ(form->type(), AST::Type::list);
+  form = parser.next_form();
+  ASSERT_NE(form, nullptr);
+  EXPECT_EQ(form->type(), AST::Type::number);
+  EXPECT_EQ(parser.next_form(), nullptr);
+}
+
+TEST(ParserQuoteChar, ParserTests)
+{
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  Parser parser{"'(a 'b (c))"};
+  std::unique_ptr<AST> form{parser.next_form()};
+  std::ostringstream out;
+  out << form->eval(env);
+  Parser quoted{"(quote (a 'b (c)))"};
+  std::ostringstream expected;
+  expected << quoted.next_form()->eval(env);
+  EXPECT_EQ(out.str(), expected.str());
+}
+
+TEST(ParserLongInput, ParserTests)
+{
+  // far more tokens than the C++ stack would take one frame each
+  std::string many;
+  for (size_t i{0}; i < 200000; ++i)
+  {
+    many += "(f " + std::to_string(i) + ")\n";
+  }
+  std::istringstream in{many};
+  Parser streamed{Source::from_stream(in, 4096)};
+  size_t forms{0};
+  while (streamed.next_form())
+  {
+    ++forms;
+  }
+  EXPECT_EQ(forms, 200000);
+
+  size_t depth{5000};
+  std::string deep(depth, '(');
+  deep += std::string(depth, ')');
+  Parser nested{deep};
+  std::unique_ptr<AST> form{nested.next_form()};
+  ASSERT_NE(form, nullptr);
+  EXPECT_EQ(form->type(), AST::Type::list);
+  EXPECT_EQ(nested.next_form(), nullptr);
+}
+
+TEST(ParserErrors, ParserTests)
+{
+  auto message = [](std::string code) {
+    try
+    {
+      Parser parser{code};
+      parser.parse();
+    }
+    catch (const std::runtime_error& err)
+    {
+      return std::string{err.what()};
+    }
+    return std::string{};
+  };
+  EXPECT_EQ(message("(a)\n  (b (c)"), "missing ')' for the '(' opened at line 2, column 3");
+  EXPECT_EQ(message("(a))"), "unexpected ')' at line 1, column 4");
+  EXPECT_EQ(message("(a\n . b)"), "dotted pairs are not supported at line 2, column 2");
+  EXPECT_EQ(message("x '"), "nothing to quote after ' at line 1, column 3");
+  EXPECT_EQ(message("(a '))"), "unexpected ')' at line 1, column 5");
+
+  auto tokens{std::make_shared<const TokenBuffer>(std::string{"(a\n(b"})};
+  Parser buffered{tokens};
+  EXPECT_THROW(buffered.parse(), std::runtime_error);
+}
+
+TEST(ParserParallel, ParserTests)
+{
+  std::string code;
+  for (size_t i{0}; i < 500; ++i)
+  {
+    code += "(define f" + std::to_string(i) + " (lambda (x) (if x '(a \"b)\" ; c\n) ())))\n";
+    code += i % 3 ? "'sym " : "''(q) ";
+    code += std::to_string(i) + " ()\n";
+  }
+  auto tokens{std::make_shared<const TokenBuffer>(code)};
+  std::unique_ptr<AST> expected{Parser{tokens}.parse()};
+  ThreadPool pool{4};
+  std::unique_ptr<AST> parsed{Parser{tokens}.parse(pool)};
+  auto expected_start{static_cast<ASTStart*>(expected.get())};
+  auto start{static_cast<ASTStart*>(parsed.get())};
+  ASSERT_EQ(start->size(), expected_start->size());
+  for (size_t i{0}; i < start->size(); ++i)
+  {
+    std::ostringstream out, expected_out;
+    start->get_child_at(i)->output(out);
+    expected_start->get_child_at(i)->output(expected_out);
+    EXPECT_EQ(start->get_child_at(i)->offset(), expected_start->get_child_at(i)->offset());
+    EXPECT_EQ(out.str(), expected_out.str());
+  }
+
+  // the first error in the input wins, whichever thread finds it
+  for (std::string bad : {"(a) (b))\n(c", "(a) x '", "(a)\n(b\n(c)", "(a . b) ("})
+  {
+    std::string expected_message, message;
+    auto bad_tokens{std::make_shared<const TokenBuffer>(bad)};
+    try
+    {
+      Parser{bad_tokens}.parse();
+    }
+    catch (const std::runtime_error& err)
+    {
+      expected_message = err.what();
+    }
+    try
+    {
+      Parser{bad_tokens}.parse(pool);
+    }
+    catch (const std::runtime_error& err)
+    {
+      message = err.what();
+    }
+    EXPECT_FALSE(message.empty()) << bad;
+    EXPECT_EQ(message, expected_message) << bad;
+  }
+
+  // over a lexer it parses in order
+  Parser serial{"1 2 3"};
+  EXPECT_EQ(static_cast<ASTStart*>(serial.parse(pool).get())->size(), 3);
+}
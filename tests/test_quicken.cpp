@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include "engine/quicken.h"
+#include "harness.h"
+#include <string>
+#include <vector>
+
+namespace
+{
+// Quickens and runs programs in one env, the nodes of the lambdas they
+// define stay around to be looked at
+class Quickened
+{
+public:
+  std::string run(const std::string& program)
+  {
+    forms_.push_back(Quickener{}.quicken(prepared(program, env_)));
+    return printed([&] { return forms_.back()->eval(env_); });
+  }
+
+  // The first node of type T in the forms run so far
+  template <typename T>
+  const T* find() const
+  {
+    std::vector<const AST*> nodes;
+    for (const auto& form : forms_)
+    {
+      nodes.push_back(form.get());
+    }
+    for (size_t i{0}; i < nodes.size(); ++i)
+    {
+      if (auto* node{dynamic_cast<const T*>(nodes[i])})
+      {
+        return node;
+      }
+      nodes[i]->append_children(nodes);
+    }
+    return nullptr;
+  }
+private:
+  std::unique_ptr<Env> env_{std::make_unique<Env>()};
+  std::vector<std::unique_ptr<AST>> forms_;
+};
+}
+
+TEST(QuickBuiltinStates, LispTests)
+{
+  Quickened quickened;
+  quickened.run("(define f (lambda (a b) (+ a b)))");
+  auto* add{quickened.find<ASTQuickBuiltin>()};
+  ASSERT_NE(add, nullptr);
+  EXPECT_EQ(add->state(), ASTQuickBuiltin::State::unknown);
+
+  EXPECT_EQ(quickened.run("(f 1 2)"), "3");
+  EXPECT_EQ(add->state(), ASTQuickBuiltin::State::ints);
+  // an overflow fails the guard of ints
+  EXPECT_EQ(quickened.run("(f 2147483647 1)"), quickened.run("(+ 2147483647.0 1)"));
+  EXPECT_EQ(add->state(), ASTQuickBuiltin::State::numbers);
+  EXPECT_EQ(quickened.run("(f 1 2)"), "3");
+  EXPECT_EQ(add->state(), ASTQuickBuiltin::State::numbers);
+  EXPECT_EQ(quickened.run("(f 1 \"a\")"), "error: trying to add not a number");
+  EXPECT_EQ(add->state(), ASTQuickBuiltin::State::generic);
+  EXPECT_EQ(quickened.run("(f 1 2)"), "3");
+}
+
+TEST(QuickBuiltinRedefined, LispTests)
+{
+  Quickened quickened;
+  quickened.run("(define f (lambda (a b) (< a b)))");
+  auto* lt{quickened.find<ASTQuickBuiltin>()};
+  ASSERT_NE(lt, nullptr);
+  EXPECT_EQ(quickened.run("(f 1.5 2.5)"), "True");
+  EXPECT_EQ(lt->state(), ASTQuickBuiltin::State::doubles);
+  quickened.run("(set < >)");
+  EXPECT_EQ(quickened.run("(f 1.5 2.5)"), "False");
+  EXPECT_EQ(lt->state(), ASTQuickBuiltin::State::generic);
+}
+
+TEST(QuickCallStates, LispTests)
+{
+  Quickened quickened;
+  quickened.run("(define g (lambda (x) x)) (define f (lambda (x) (g x)))");
+  auto* call{quickened.find<ASTQuickCall>()};
+  ASSERT_NE(call, nullptr);
+  EXPECT_EQ(quickened.run("(f 1)"), "1");
+  EXPECT_EQ(call->state(), ASTQuickCall::State::procedure);
+  quickened.run("(define g (lambda (x) (* x 2)))");
+  EXPECT_EQ(quickened.run("(f 2)"), "4");
+  EXPECT_EQ(call->state(), ASTQuickCall::State::generic);
+}
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include "lisp/reader.h"
+#include "parser/parser.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+std::string print(const Value& value)
+{
+  std::ostringstream out;
+  out << value;
+  return out.str();
+}
+
+std::string read_error(const std::string& text)
+{
+  Env env;
+  try
+  {
+    Reader{text, env}.all();
+  }
+  catch (const std::runtime_error& err)
+  {
+    return err.what();
+  }
+  return "";
+}
+}
+
+TEST(ReaderValues, LispTests)
+{
+  Env env;
+  Reader reader{"(1 -2.5 \"a \\\"b\\\"\" sym TRUE false nil () (x (y))) 'q 42", env};
+  auto list{reader.next()};
+  ASSERT_TRUE(list && list->is_list());
+  List& values{list->as_list()};
+  ASSERT_EQ(values.size(), 9);
+  EXPECT_EQ(values[0].as_number().as_int(), 1);
+  EXPECT_EQ(values[1].as_number().as_double(), -2.5);
+  EXPECT_EQ(values[2].as_string().value(), "a \"b\"");
+  EXPECT_EQ(values[3].as_symbol().value(), "sym");
+  EXPECT_EQ(values[3].as_symbol().id(), env.intern("sym"));
+  EXPECT_TRUE(values[4].is_boolean() && values[4].is_true());
+  EXPECT_TRUE(values[5].is_boolean() && !values[5].is_true());
+  EXPECT_TRUE(values[6].is_nil());
+  EXPECT_TRUE(values[7].is_nil());
+  ASSERT_TRUE(values[8].is_list());
+  EXPECT_EQ(values[8].as_list()[1].as_list()[0].as_symbol().value(), "y");
+
+  auto quoted{reader.next()};
+  ASSERT_TRUE(quoted && quoted->is_list());
+  EXPECT_EQ(quoted->as_list()[0].as_symbol().value(), "quote");
+  EXPECT_EQ(quoted->as_list()[1].as_symbol().value(), "q");
+  auto number{reader.next()};
+  ASSERT_TRUE(number && number->is_number());
+  EXPECT_FALSE(reader.next());
+
+  // numbers out of range for a double read as infinite
+  Value huge{Reader{"(1e999 -1e999)", env}.all()};
+  EXPECT_EQ(huge.as_list()[0].as_list()[0].as_number().as_double(), HUGE_VAL);
+  EXPECT_EQ(huge.as_list()[0].as_list()[1].as_number().as_double(), -HUGE_VAL);
+}
+
+TEST(ReaderMatchesQuote, LispTests)
+{
+  std::string data{"(1 (2.5 \"s\" (sym other)) () nil true)\n; comment\n(a b (c (d (e))))\n-7\n"};
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  Parser parser{data};
+  Reader reader{data, *env};
+  while (auto form{parser.next_form()})
+  {
+    auto value{reader.next()};
+    ASSERT_TRUE(value);
+    EXPECT_EQ(print(*value), print(form->quote(env)));
+  }
+  EXPECT_FALSE(reader.next());
+}
+
+TEST(ReaderDeep, LispTests)
+{
+  Env env;
+  std::string data(5000, '(');
+  data += "x";
+  data += std::string(5000, ')');
+  auto value{Reader{data, env}.next()};
+  ASSERT_TRUE(value);
+  Value* inner{&*value};
+  size_t depth{0};
+  while (inner->is_list())
+  {
+    inner = &inner->as_list()[0];
+    ++depth;
+  }
+  EXPECT_EQ(depth, 5000);
+}
+
+TEST(ReaderErrors, LispTests)
+{
+  EXPECT_EQ(read_error("(1 2"), "missing ')' for the '(' opened at line 1, column 1");
+  EXPECT_EQ(read_error("(1)\n )"), "unexpected ')' at line 2, column 2");
+  EXPECT_EQ(read_error("(a . b)"), "dotted pairs are not supported at line 1, column 4");
+  EXPECT_EQ(read_error("(a ')"), "unexpected ')' at line 1, column 5");
+  EXPECT_EQ(read_error("'"), "nothing to quote after ' at line 1, column 1");
+  EXPECT_EQ(read_error("(a) (b (c))"), "");
+}
+
+TEST(ReaderPrimitives, LispTests)
+{
+  std::string path{"test_reader_data.txt"};
+  std::ofstream{path} << "(1 2)\n(three \"four\")\n";
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  Value read{Parser{"(read \"(x 2)\")"}.parse()->eval(env).execute(env)};
+  ASSERT_TRUE(read.is_list());
+  EXPECT_EQ(read.as_list()[0].as_symbol().value(), "x");
+  Value file{Parser{"(read-file \"" + path + "\")"}.parse()->eval(env).execute(env)};
+  std::remove(path.c_str());
+  ASSERT_TRUE(file.is_list());
+  ASSERT_EQ(file.as_list().size(), 2);
+  EXPECT_EQ(file.as_list()[1].as_list()[1].as_string().value(), "four");
+  EXPECT_THROW(Parser{"(read 1)"}.parse()->eval(env).execute(env), std::runtime_error);
+}
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include "ast/resolver.h"
+#include "harness.h"
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+// The value of the lowered tree of program, its names looked up as it runs
+std::string unresolved(const std::string& program)
+{
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  return printed([&] { return lowered(program, env)->eval(env).execute(env); });
+}
+}
+
+TEST(ResolverMatchesEval, LispTests)
+{
+  const std::string programs[]{
+    "(define sq (lambda (x) (* x x))) (sq 4)",
+    "(let ((y 1) (z 2)) (+ y z))",
+    "(define y 1) (set y 5) y",
+    "(let ((y 1)) (set y 2) y)",
+    "((lambda (x y) (+ x y)) 1 2)",
+    "(define a 2) (define b (let ((a 10)) (* a 3))) (+ a b)",
+    "(if (< 1 2) (let ((x 4)) x) 0)",
+    "(define add (lambda (x y) (+ x y))) (add (add 1 2) (add 3 4))",
+    "(car '(1 2 3))",
+    "(list 1 \"two\" true nil)",
+  };
+  for (const auto& program : programs)
+  {
+    EXPECT_EQ(run(program, "tree"), unresolved(program)) << program;
+  }
+}
+
+TEST(ResolverScopes, LispTests)
+{
+  EXPECT_EQ(run("(define fib (lambda (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))) (fib 15)", "tree"),
+            "610");
+  // closures keep the scope they were made in
+  EXPECT_EQ(run("(define adder (lambda (n) (lambda (x) (+ x n)))) (define add3 (adder 3)) (add3 4)", "tree"),
+            "7");
+  EXPECT_EQ(run("(define counter (let ((n 0)) (lambda () (set n (+ n 1)) n))) (counter) (counter) (counter)",
+                "tree"),
+            "3");
+  // an inner let shadows, the outer binding is back after it
+  EXPECT_EQ(run("(let ((x 1)) (+ (let ((x 10)) x) x))", "tree"), "11");
+  EXPECT_EQ(run("((lambda (x) ((lambda (y) (+ x y)) 2)) 1)", "tree"), "3");
+  // defines in a body are local to it and can refer to each other
+  EXPECT_EQ(run("(define f (lambda (n) (define even (lambda (k) (if (= k 0) true (odd (- k 1))))) "
+                "(define odd (lambda (k) (if (= k 0) false (even (- k 1))))) (even n))) (f 10)",
+                "tree"),
+            "True");
+  EXPECT_EQ(run("(define f (lambda () (define hidden 1) hidden)) (f) hidden", "tree"),
+            "error: Could not find symbol hidden");
+  // globals are looked up when they run, a define after the lambda counts
+  EXPECT_EQ(run("(define g (lambda () later)) (define later 5) (g)", "tree"), "5");
+  EXPECT_EQ(run("(define x 1) (define f (lambda () (set x 2))) (f) x", "tree"), "2");
+}
+
+TEST(ResolverAddresses, LispTests)
+{
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  auto ast{prepared("(lambda (a b) (let ((c a)) (+ b c)))", env)};
+  auto* block{static_cast<ASTBlock*>(ast.get())};
+  auto* procedure{dynamic_cast<ASTProcedure*>(block->statements()[0].get())};
+  ASSERT_NE(procedure, nullptr);
+  EXPECT_EQ(procedure->code()->parameters, 2);
+  EXPECT_EQ(procedure->code()->size, 2);
+  auto* let{dynamic_cast<const ASTScope*>(static_cast<const ASTBlock*>(procedure->code()->body.get())->statements()[0].get())};
+  ASSERT_NE(let, nullptr);
+  auto* a{dynamic_cast<const ASTLocal*>(let->values()[0].get())};
+  ASSERT_NE(a, nullptr);
+  EXPECT_EQ(a->depth(), 0);
+  EXPECT_EQ(a->index(), 0);
+  auto* call{dynamic_cast<const ASTCall*>(static_cast<const ASTBlock&>(let->body()).statements()[0].get())};
+  ASSERT_NE(call, nullptr);
+  EXPECT_NE(dynamic_cast<const ASTGlobal*>(&call->callee()), nullptr);
+  auto* b{dynamic_cast<const ASTLocal*>(call->arguments()[0].get())};
+  auto* c{dynamic_cast<const ASTLocal*>(call->arguments()[1].get())};
+  ASSERT_NE(b, nullptr);
+  ASSERT_NE(c, nullptr);
+  EXPECT_EQ(b->depth(), 1);
+  EXPECT_EQ(b->index(), 1);
+  EXPECT_EQ(c->depth(), 0);
+  EXPECT_EQ(c->index(), 0);
+}
+
+TEST(ResolverErrors, LispTests)
+{
+  EXPECT_EQ(run("(+ 1 missing)", "tree"), "error: Could not find symbol missing");
+  EXPECT_EQ(run("(set missing 1)", "tree"), "error: Error trying to set missing");
+  EXPECT_EQ(run("((lambda (x) x))", "tree"), "error: wrong number of arguments passed to lambda");
+  EXPECT_EQ(run("(1 2)", "tree"), "error: Cannot call 1");
+  // a failed call leaves the scope as it was
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  EXPECT_THROW(prepared("((lambda (x) (car x)) 1)", env)->eval(env), std::runtime_error);
+  EXPECT_EQ(env->scope(), nullptr);
+}
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include "lexer/scan.h"
+#include "lexer/lexer.h"
+#include <string>
+
+TEST(ScanKernelsMatchScalar, LexerTests)
+{
+  const scan::Kernels* scalar{scan::kernels(scan::Isa::scalar)};
+  const std::string alphabet{"  \t\n\r\v\f()\"\\;abc"};
+  unsigned seed{7};
+  auto random = [&seed]() { seed = seed * 1103515245 + 12345; return (seed >> 16) & 0x7fff; };
+  for (scan::Isa isa : {scan::Isa::sse2, scan::Isa::avx2})
+  {
+    const scan::Kernels* kernels{scan::kernels(isa)};
+    if (kernels == nullptr)
+    {
+      continue;
+    }
+    for (size_t size{0}; size < 130; ++size)
+    {
+      for (int round{0}; round < 20; ++round)
+      {
+        std::string text;
+        // long runs of one class so the kernels get past the first block
+        char fill{alphabet[random() % alphabet.size()]};
+        for (size_t i{0}; i < size; ++i)
+        {
+          text += random() % 16 == 0 ? alphabet[random() % alphabet.size()] : fill;
+        }
+        const char* data{text.data()};
+        EXPECT_EQ(kernels->skip_space(data, size), scalar->skip_space(data, size)) << kernels->name;
+        EXPECT_EQ(kernels->symbol_end(data, size), scalar->symbol_end(data, size)) << kernels->name;
+        EXPECT_EQ(kernels->string_end(data, size), scalar->string_end(data, size)) << kernels->name;
+        EXPECT_EQ(kernels->newline(data, size), scalar->newline(data, size)) << kernels->name;
+        scan::Lines expected{scalar->count_lines(data, size)};
+        scan::Lines lines{kernels->count_lines(data, size)};
+        EXPECT_EQ(lines.count, expected.count) << kernels->name;
+        if (expected.count > 0)
+        {
+          EXPECT_EQ(lines.last, expected.last) << kernels->name;
+        }
+      }
+    }
+  }
+}
+
+TEST(ScanLexerComments, LexerTests)
+{
+  Lexer lexer{"; first\n   ; second comment line\n// third\n  (x"};
+  Token token{lexer.token()};
+  EXPECT_EQ(token.type(), Token::Type::open);
+  EXPECT_EQ(lexer.position(token).line, 4);
+  EXPECT_EQ(lexer.position(token).column, 3);
+  token = lexer.token();
+  EXPECT_EQ(token.type(), Token::Type::symbol);
+  EXPECT_EQ(token.string(), "x");
+}
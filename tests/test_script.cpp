@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+#include "parser/script.h"
+#include "parser/parser.h"
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+// The type and token text of every node, depth first
+std::string dump(const AST& ast)
+{
+  std::ostringstream out;
+  std::vector<const AST*> nodes{&ast};
+  while (!nodes.empty())
+  {
+    const AST* node{nodes.back()};
+    nodes.pop_back();
+    node->AST::output(out) << ' ' << node->str() << ';';
+    std::vector<const AST*> children;
+    node->append_children(children);
+    nodes.insert(nodes.end(), children.rbegin(), children.rend());
+  }
+  return out.str();
+}
+
+// The script has the forms a full parse of its text gives
+void expect_parsed(const Script& script)
+{
+  Parser parser{script.text()};
+  for (size_t i{0}; ; ++i)
+  {
+    size_t start{parser.next_offset()};
+    auto form{parser.next_form()};
+    if (!form)
+    {
+      EXPECT_EQ(i, script.size());
+      return;
+    }
+    ASSERT_LT(i, script.size());
+    EXPECT_EQ(script.start(i), start);
+    EXPECT_EQ(dump(script.form(i)), dump(*form));
+  }
+}
+
+int integer(Env& env, const std::string& name)
+{
+  return env.lookup(name).as_number().as_int();
+}
+}
+
+TEST(ScriptReload, ParserTests)
+{
+  std::string text;
+  for (int i{0}; i < 1000; ++i)
+  {
+    text += "(define v" + std::to_string(i) + " " + std::to_string(i) + ")\n";
+  }
+  text += "(define total (+ v1 v998))\n";
+  Script script;
+  Script::Stats stats{script.load(text)};
+  EXPECT_EQ(stats.forms, 1001u);
+  EXPECT_EQ(stats.changed, 1001u);
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  EXPECT_EQ(script.run(env), 1001u);
+  EXPECT_EQ(integer(*env, "total"), 999);
+
+  // the same text again changes nothing
+  stats = script.load(text);
+  EXPECT_EQ(stats.changed, 0u);
+  EXPECT_EQ(script.run(env), 0u);
+
+  // one value changes, only it and what uses it run again
+  std::string edited{text};
+  edited.replace(edited.find("(define v998 998)"), 17, "(define v998 1998)");
+  stats = script.load(edited);
+  EXPECT_EQ(stats.forms, 1001u);
+  EXPECT_EQ(stats.changed, 1u);
+  EXPECT_LE(stats.parsed, 3u);
+  EXPECT_LT(stats.lexed, 100u);
+  expect_parsed(script);
+  EXPECT_EQ(script.run(env), 2u);
+  EXPECT_EQ(integer(*env, "total"), 1999);
+
+  // forms after an insertion are kept though they moved
+  edited.insert(edited.find("(define v10 "), "(define extra 7)\n");
+  stats = script.load(edited);
+  EXPECT_EQ(stats.forms, 1002u);
+  EXPECT_EQ(stats.changed, 1u);
+  EXPECT_LT(stats.lexed, 100u);
+  expect_parsed(script);
+  EXPECT_EQ(script.run(env), 1u);
+  EXPECT_EQ(integer(*env, "extra"), 7);
+}
+
+TEST(ScriptDependencies, ParserTests)
+{
+  Script script;
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  script.load("(define a 1)\n(define b (+ a 1))\n(define c (* b 2))\n(define d 5)\n");
+  EXPECT_EQ(script.run(env), 4u);
+  EXPECT_EQ(integer(*env, "c"), 4);
+
+  // a change flows through every define that depends on it
+  script.load("(define a 10)\n(define b (+ a 1))\n(define c (* b 2))\n(define d 5)\n");
+  EXPECT_EQ(script.run(env), 3u);
+  EXPECT_EQ(integer(*env, "c"), 22);
+
+  // moving a form does not make it run again
+  script.load("(define d 5)\n(define a 10)\n(define b (+ a 1))\n(define c (* b 2))\n");
+  EXPECT_EQ(script.run(env), 0u);
+
+  // the forms that used a define that went away run again
+  script.load("(define d 5)\n(define a 10)\n(define c (* b 2))\n");
+  EXPECT_EQ(script.run(env), 1u);
+}
+
+TEST(ScriptErrors, ParserTests)
+{
+  Script script;
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  std::string text{"(define a 1)\n(define b 2)\n(define c 3)\n"};
+  script.load(text);
+  script.run(env);
+  try
+  {
+    script.load("(define a 1)\n(define b 2)\n(define c 3\n");
+    FAIL() << "expected a syntax error";
+  }
+  catch (const std::runtime_error& err)
+  {
+    EXPECT_EQ(std::string{err.what()}, "missing ')' for the '(' opened at line 3, column 1");
+  }
+  EXPECT_EQ(script.text(), text);
+  EXPECT_EQ(script.size(), 3u);
+
+  // a form that fails runs again next time, the ones after it too
+  script.load("(define a 1)\n(define b (undefined-function 2))\n(define c 4)\n");
+  EXPECT_THROW(script.run(env), std::runtime_error);
+  script.load("(define a 1)\n(define b 5)\n(define c 4)\n");
+  EXPECT_EQ(script.run(env), 2u);
+  EXPECT_EQ(integer(*env, "b"), 5);
+  EXPECT_EQ(integer(*env, "c"), 4);
+}
+
+TEST(ScriptRandomEdits, ParserTests)
+{
+  // Edits that change how the text around them lexes: new parens, quotes,
+  // comment starts and joined or split tokens
+  const std::string pieces[]{"(", ")", "\"", ";", "\n", " ", "'", "x", "1", "(f a)", "; c\n", "\"s\""};
+  std::mt19937 random{14};
+  std::string text;
+  for (int i{0}; i < 60; ++i)
+  {
+    text += "(define s" + std::to_string(i) + " (list \"a b\" 'q " + std::to_string(i) + "))";
+    text += i % 3 == 0 ? " ; note\n" : "\n";
+  }
+  Script script;
+  script.load(text);
+  for (int round{0}; round < 400; ++round)
+  {
+    std::string edited{text};
+    size_t at{random() % (edited.size() + 1)};
+    if (random() % 2 == 0)
+    {
+      edited.insert(at, pieces[random() % std::size(pieces)]);
+    }
+    else
+    {
+      edited.erase(at, random() % 4);
+    }
+    bool valid{true};
+    try
+    {
+      Parser{edited}.parse();
+    }
+    catch (const std::runtime_error&)
+    {
+      valid = false;
+    }
+    if (valid)
+    {
+      script.load(edited);
+      text = edited;
+    }
+    else
+    {
+      EXPECT_THROW(script.load(edited), std::runtime_error);
+    }
+    ASSERT_EQ(script.text(), text);
+    expect_parsed(script);
+  }
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "lexer/lexer.h"
+#include "lexer/source.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+const std::string program{R"END(; a comment
+(define add (lambda (x y) (+ x y)))
+(print "a \"quoted\" string" 1.5e3 -42 'sym)
+)END"};
+
+std::vector<Token> all_tokens(Lexer& lexer, std::vector<std::string>& texts)
+{
+  std::vector<Token> ret;
+  while (true)
+  {
+    Token t{lexer.token()};
+    texts.emplace_back(t.string());
+    ret.push_back(t);
+    if (t.type() == Token::Type::END)
+    {
+      return ret;
+    }
+  }
+}
+
+void expect_same_tokens(Lexer& lexer)
+{
+  Lexer reference{program};
+  std::vector<std::string> expected_text, text;
+  auto expected{all_tokens(reference, expected_text)};
+  auto tokens{all_tokens(lexer, text)};
+  ASSERT_EQ(expected.size(), tokens.size());
+  for (size_t i{0}; i < tokens.size(); ++i)
+  {
+    EXPECT_EQ(expected[i].type(), tokens[i].type());
+    EXPECT_EQ(expected_text[i], text[i]);
+    EXPECT_EQ(expected[i].offset(), tokens[i].offset());
+    EXPECT_EQ(reference.position(expected[i]).line, lexer.position(tokens[i]).line);
+    EXPECT_EQ(reference.position(expected[i]).column, lexer.position(tokens[i]).column);
+  }
+}
+}
+
+TEST(SourceMappedFile, LexerTests)
+{
+  std::string path{testing::TempDir() + "tyson_source_test.tsn"};
+  {
+    std::ofstream out{path};
+    out << program;
+  }
+  Lexer lexer{Source::from_file(path)};
+  expect_same_tokens(lexer);
+  std::remove(path.c_str());
+}
+
+TEST(SourceStream, LexerTests)
+{
+  for (size_t chunk : {1, 2, 3, 7, 4096})
+  {
+    std::istringstream in{program};
+    Lexer lexer{Source::from_stream(in, chunk)};
+    expect_same_tokens(lexer);
+  }
+}
+
+TEST(SourceStreamPeek, LexerTests)
+{
+  std::istringstream in{"abcdefgh"};
+  StringHandler handler{Source::from_stream(in, 3)};
+  EXPECT_EQ(handler.peek(5), 'f');
+  EXPECT_EQ(handler.next(), 'a');
+  EXPECT_EQ(handler.peek(6), 'h');
+  EXPECT_TRUE(handler.eof(7));
+  EXPECT_EQ(handler.peek(7), '\0');
+  EXPECT_EQ(handler.next(), 'b');
+  EXPECT_EQ(handler.column(), 3);
+}
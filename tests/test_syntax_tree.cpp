@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+#include "parser/syntax_tree.h"
+#include "parser/parser.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+namespace
+{
+const std::string program{R"END(; scores
+(define score (lambda (x) (* x 2.5)))
+(print "plain" "with \"escapes\"" 'quoted 42 -1e3 TRUE false nil)
+(if (< 1 2) '(a 'b) ())
+(let ((y 1)) (set! y 2) y)
+(quote (1 2)) define
+)END"};
+
+std::string dump(const AST& ast)
+{
+  std::ostringstream out;
+  ast.output(out);
+  return out.str();
+}
+}
+
+TEST(SyntaxTreeMatchesParser, ParserTests)
+{
+  SyntaxTree tree{program};
+  Parser parser{program};
+  std::unique_ptr<AST> expected{parser.parse()};
+  std::unique_ptr<AST> converted{tree.to_ast()};
+  auto expected_start{static_cast<ASTStart*>(expected.get())};
+  auto start{static_cast<ASTStart*>(converted.get())};
+  ASSERT_EQ(tree.forms().size(), expected_start->size());
+  ASSERT_EQ(start->size(), expected_start->size());
+  for (size_t i{0}; i < start->size(); ++i)
+  {
+    EXPECT_EQ(start->get_child_at(i)->type(), expected_start->get_child_at(i)->type());
+    EXPECT_EQ(start->get_child_at(i)->offset(), expected_start->get_child_at(i)->offset());
+    EXPECT_EQ(start->get_child_at(i)->str(), expected_start->get_child_at(i)->str());
+    EXPECT_EQ(dump(*start->get_child_at(i)), dump(*expected_start->get_child_at(i)));
+  }
+
+}
+
+TEST(SyntaxTreeEval, ParserTests)
+{
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  Value result{SyntaxTree{"(define x 2)\n(* x 3.5)"}.to_ast()->eval(env).execute(env)};
+  ASSERT_TRUE(result.is_number());
+  EXPECT_EQ(result.as_number().as_double(), 7);
+}
+
+TEST(SyntaxTreeNodes, ParserTests)
+{
+  SyntaxTree tree{"(define x \"a\\\"b\")\n'(1 2.5)"};
+  auto forms{tree.forms()};
+  ASSERT_EQ(forms.size(), 2);
+  EXPECT_EQ(forms[0].type, AST::Type::define);
+  EXPECT_EQ(tree.text(forms[0]), "define");
+  auto define{tree.children(forms[0])};
+  ASSERT_EQ(define.size(), 2);
+  EXPECT_EQ(define[0].type, AST::Type::symbol);
+  EXPECT_EQ(tree.text(define[0]), "x");
+  EXPECT_EQ(define[1].type, AST::Type::string);
+  EXPECT_EQ(tree.text(define[1]), "a\"b");
+
+  EXPECT_EQ(forms[1].type, AST::Type::quote);
+  EXPECT_EQ(tree.position(forms[1]).line, 2);
+  auto list{tree.children(tree.children(forms[1])[0])};
+  ASSERT_EQ(list.size(), 2);
+  EXPECT_EQ(std::get<int>(tree.number(list[0])), 1);
+  EXPECT_EQ(std::get<double>(tree.number(list[1])), 2.5);
+  EXPECT_TRUE(tree.children(list[0]).empty());
+  EXPECT_EQ(tree.nodes(), 7);
+}
+
+TEST(SyntaxTreeErrors, ParserTests)
+{
+  for (std::string code : {"(a)\n  (b (c)", "(a))", "(a\n . b)", "x '", "(a '))", "("})
+  {
+    std::string expected, message;
+    try
+    {
+      Parser{code}.parse();
+    }
+    catch (const std::runtime_error& err)
+    {
+      expected = err.what();
+    }
+    try
+    {
+      SyntaxTree{code};
+    }
+    catch (const std::runtime_error& err)
+    {
+      message = err.what();
+    }
+    EXPECT_FALSE(message.empty()) << code;
+    EXPECT_EQ(message, expected) << code;
+  }
+}
+
+TEST(SyntaxTreeCache, ParserTests)
+{
+  std::string path{testing::TempDir() + "syntax_tree_cache.ty"};
+  ::setenv("XDG_CACHE_HOME", (testing::TempDir() + "cache").c_str(), 1);
+  std::string cache{SyntaxTree::cache_path(path)};
+  EXPECT_EQ(cache.rfind(testing::TempDir() + "cache/tyson/syntax_tree_cache-", 0), 0u) << cache;
+  std::remove(cache.c_str());
+  std::ofstream{path} << program;
+
+  // not at all when asked not to
+  SyntaxTree::load_file(path, false);
+  EXPECT_FALSE(SyntaxTree::load_file(path, false).cached());
+  EXPECT_FALSE(std::ifstream{cache}.good());
+
+  SyntaxTree cold{SyntaxTree::load_file(path)};
+  EXPECT_FALSE(cold.cached());
+  // nothing is left next to the source
+  EXPECT_FALSE(std::ifstream{path + ".tyc"}.good());
+  SyntaxTree warm{SyntaxTree::load_file(path)};
+  ASSERT_TRUE(warm.cached());
+  EXPECT_EQ(warm.nodes(), cold.nodes());
+
+  std::unique_ptr<AST> expected{cold.to_ast()};
+  std::unique_ptr<AST> loaded{warm.to_ast()};
+  auto expected_start{static_cast<ASTStart*>(expected.get())};
+  auto start{static_cast<ASTStart*>(loaded.get())};
+  ASSERT_EQ(start->size(), expected_start->size());
+  for (size_t i{0}; i < start->size(); ++i)
+  {
+    EXPECT_EQ(start->get_child_at(i)->offset(), expected_start->get_child_at(i)->offset());
+    EXPECT_EQ(dump(*start->get_child_at(i)), dump(*expected_start->get_child_at(i)));
+  }
+  for (size_t i{0}; i < cold.forms().size(); ++i)
+  {
+    EXPECT_EQ(warm.position(warm.forms()[i]).line, cold.position(cold.forms()[i]).line);
+    EXPECT_EQ(warm.position(warm.forms()[i]).column, cold.position(cold.forms()[i]).column);
+  }
+  // symbols are shared in the atom table, strings come out unescaped
+  auto print{warm.children(warm.forms()[1])};
+  EXPECT_EQ(warm.text(print[0]), "print");
+  EXPECT_EQ(warm.text(print[2]), "with \"escapes\"");
+
+  // an edit makes the cache stale
+  std::ofstream{path} << "(define y 1)";
+  SyntaxTree edited{SyntaxTree::load_file(path)};
+  EXPECT_FALSE(edited.cached());
+  EXPECT_EQ(edited.forms().size(), 1);
+  EXPECT_TRUE(SyntaxTree::load_file(path).cached());
+
+  // anything that is not a tree of this source is ignored
+  EXPECT_FALSE(SyntaxTree::load(cache, SyntaxTree::hash("something else")));
+  std::ofstream{cache} << "garbage";
+  EXPECT_FALSE(SyntaxTree::load(cache, SyntaxTree::hash("(define y 1)")));
+  EXPECT_FALSE(SyntaxTree::load_file(path).cached());
+
+  // and so is one whose hash matches but whose sections are cut short or
+  // point out of bounds
+  std::string image;
+  {
+    std::ifstream in{cache, std::ios::binary};
+    image.assign(std::istreambuf_iterator<char>{in}, {});
+  }
+  ASSERT_GT(image.size(), 64u);
+  std::ofstream{cache, std::ios::binary} << image.substr(0, image.size() - 1);
+  EXPECT_FALSE(SyntaxTree::load(cache, SyntaxTree::hash("(define y 1)")));
+  std::string corrupted{image};
+  std::fill(corrupted.begin() + 64, corrupted.end(), '\xff');
+  std::ofstream{cache, std::ios::binary} << corrupted;
+  EXPECT_FALSE(SyntaxTree::load(cache, SyntaxTree::hash("(define y 1)")));
+  std::ofstream{cache, std::ios::binary} << image;
+  EXPECT_TRUE(SyntaxTree::load(cache, SyntaxTree::hash("(define y 1)")));
+  std::remove(cache.c_str());
+  std::remove(path.c_str());
+}
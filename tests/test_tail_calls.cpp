@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include "ast/resolver.h"
+#include "engine/jit.h"
+#include "harness.h"
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+namespace
+{
+// Runs work on a thread with a stack of only a megabyte, a C++ frame per
+// call runs out of it in under a thousand calls on every engine
+template <typename Work>
+void small_stack(Work work)
+{
+  pthread_attr_t attributes;
+  pthread_attr_init(&attributes);
+  pthread_attr_setstacksize(&attributes, 1 << 20);
+  pthread_t thread;
+  auto body = [](void* work) -> void* {
+    (*static_cast<Work*>(work))();
+    return nullptr;
+  };
+  ASSERT_EQ(pthread_create(&thread, &attributes, body, &work), 0);
+  pthread_join(thread, nullptr);
+  pthread_attr_destroy(&attributes);
+}
+
+// Makes every lambda hot on its first call for as long as it lives
+class HotThreshold
+{
+public:
+  HotThreshold() : threshold_{Jit::threshold()} { Jit::set_threshold(1); }
+  ~HotThreshold() { Jit::set_threshold(threshold_); }
+private:
+  size_t threshold_;
+};
+
+// The calls of a resolved tree, whether each is a tail call, in order
+std::vector<bool> tails(const std::string& program)
+{
+  std::unique_ptr<Env> env{std::make_unique<Env>()};
+  auto resolved{prepared(program, env)};
+  std::vector<bool> ret;
+  std::vector<const AST*> nodes{resolved.get()};
+  while (!nodes.empty())
+  {
+    const AST* node{nodes.back()};
+    nodes.pop_back();
+    if (auto* call{dynamic_cast<const ASTCall*>(node)})
+    {
+      ret.push_back(call->tail());
+    }
+    std::vector<const AST*> children;
+    node->append_children(children);
+    nodes.insert(nodes.end(), children.rbegin(), children.rend());
+  }
+  return ret;
+}
+}
+
+TEST(TailCallsMarked, LispTests)
+{
+  // the test of an if and the operands of a call are not in tail position
+  EXPECT_EQ(tails("(lambda (n) (if (< n 1) n (f (- n 1))))"), (std::vector<bool>{false, true, false}));
+  EXPECT_EQ(tails("(lambda (n) (g n) (let ((m n)) (f m)))"), (std::vector<bool>{false, true}));
+  // nor is anything at the top level
+  EXPECT_EQ(tails("(f 1)"), (std::vector<bool>{false}));
+}
+
+TEST(TailCallsRunInConstantStack, LispTests)
+{
+  // a few times deeper than a C++ frame per call fits in a small stack,
+  // bench_engines runs them a million deep
+  const std::string loop{"(define loop (lambda (n acc) (if (= n 0) acc (loop (- n 1) (+ acc 2))))) (loop 5000 0)"};
+  const std::string mutual{"(define even (lambda (n) (if (= n 0) true (odd (- n 1))))) "
+                           "(define odd (lambda (n) (if (= n 0) false (even (- n 1))))) (even 5001)"};
+  const std::string through{"(define count (lambda (n) (if (= n 0) 0 ((lambda (m) (count m)) (- n 1))))) "
+                            "(count 5000)"};
+  small_stack([&] {
+    for (const auto& engine : Engine::names())
+    {
+      EXPECT_EQ(run(loop, engine), "10000") << engine;
+      EXPECT_EQ(run(mutual, engine), "False") << engine;
+      EXPECT_EQ(run(through, engine), "0") << engine;
+    }
+  });
+}
+
+TEST(TailCallsReuseScopes, LispTests)
+{
+  // a scope that a lambda closed over is not used again by the next call
+  const std::string program{"(define collect (lambda (n acc) (if (= n 0) acc "
+                            "(collect (- n 1) (cons (lambda () n) acc))))) "
+                            "(define l (collect 3 (list))) (+ ((car l)) ((car (cdr l))))"};
+  for (const auto& engine : Engine::names())
+  {
+    EXPECT_EQ(run(program, engine), "3") << engine;
+  }
+}
+
+TEST(TailCallsNative, LispTests)
+{
+  if (!Jit::supported())
+  {
+    GTEST_SKIP() << "no JIT on this platform";
+  }
+  HotThreshold hot;
+  // a tail call of itself jumps back in native code, one of another
+  // lambda returns to the call that went native
+  EXPECT_EQ(run("(define loop (lambda (n acc) (if (= n 0) acc (loop (- n 1) (+ acc 1))))) (loop 100000 0)", "jit"),
+            "100000");
+  EXPECT_EQ(run("(define a (lambda (n) (if (= n 0) 7 (b (- n 1))))) (define b (lambda (n) (a n))) (a 100000)", "jit"),
+            "7");
+}
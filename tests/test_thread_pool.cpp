@@ -0,0 +1,41 @@
+#include <gtest/gtest.h>
+#include "util/thread_pool.h"
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+TEST(ThreadPoolRunsAll, UtilTests)
+{
+  for (size_t threads : {0, 1, 2, 8})
+  {
+    ThreadPool pool{threads};
+    EXPECT_EQ(pool.size(), threads ? threads : 1);
+    for (size_t count : {0, 1, 3, 100})
+    {
+      std::vector<std::atomic<int>> hits(count);
+      pool.run(count, [&](size_t i) { ++hits[i]; });
+      for (auto& hit : hits)
+      {
+        EXPECT_EQ(hit, 1);
+      }
+    }
+  }
+}
+
+TEST(ThreadPoolErrors, UtilTests)
+{
+  ThreadPool pool{4};
+  std::atomic<int> ran{0};
+  EXPECT_THROW(pool.run(50, [&](size_t i) {
+    ++ran;
+    if (i == 7)
+    {
+      throw std::runtime_error("part failed");
+    }
+  }), std::runtime_error);
+  EXPECT_EQ(ran, 50);
+  // still usable afterwards
+  ran = 0;
+  pool.run(10, [&](size_t) { ++ran; });
+  EXPECT_EQ(ran, 10);
+}
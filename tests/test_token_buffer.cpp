@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include "lexer/token_buffer.h"
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "util/thread_pool.h"
+#include <random>
+#include <sstream>
+
+namespace
+{
+const std::string program{R"END(; scores
+(define score (lambda (x) (* x 2.5)))
+(print "plain" "with \"escapes\"" 'quoted 42 -1e3)
+)END"};
+}
+
+TEST(TokenBufferMatchesLexer, LexerTests)
+{
+  TokenBuffer tokens{program};
+  Lexer lexer{program};
+  size_t i{0};
+  while (true)
+  {
+    Token expected{lexer.token()};
+    ASSERT_LT(i, tokens.size());
+    Token token{tokens.token(i)};
+    EXPECT_EQ(token.type(), expected.type());
+    EXPECT_EQ(token.string(), expected.string());
+    EXPECT_EQ(token.offset(), expected.offset());
+    EXPECT_EQ(tokens.position(i).line, lexer.position(expected).line);
+    EXPECT_EQ(tokens.position(i).column, lexer.position(expected).column);
+    if (expected.type() == Token::Type::number)
+    {
+      EXPECT_EQ(token.is_integer(), expected.is_integer());
+      EXPECT_EQ(token.number(), expected.number());
+    }
+    ++i;
+    if (expected.type() == Token::Type::END)
+    {
+      break;
+    }
+  }
+  EXPECT_EQ(i, tokens.size());
+  EXPECT_EQ(tokens.token(tokens.size() + 10).type(), Token::Type::END);
+}
+
+TEST(TokenBufferStream, LexerTests)
+{
+  std::istringstream in{program};
+  TokenBuffer streamed{Source::from_stream(in, 5)};
+  TokenBuffer tokens{program};
+  ASSERT_EQ(streamed.size(), tokens.size());
+  for (size_t i{0}; i < tokens.size(); ++i)
+  {
+    EXPECT_EQ(streamed.type(i), tokens.type(i));
+    EXPECT_EQ(streamed.text(i), tokens.text(i));
+  }
+}
+
+TEST(TokenBufferParser, ParserTests)
+{
+  std::string code{"((ADD (MUL 1 2) (DIV 4 2)))"};
+  Parser from_text{code};
+  Parser from_tokens{std::make_shared<const TokenBuffer>(code)};
+  auto expected{from_text.parse()};
+  auto parsed{from_tokens.parse()};
+  std::ostringstream expected_out, out;
+  expected->get_child()->output(expected_out);
+  parsed->get_child()->output(out);
+  EXPECT_EQ(out.str(), expected_out.str());
+}
+
+namespace
+{
+// Lines of forms, comments and strings that run over several lines with
+// comment and paren chars inside them, so chunks start in every state
+std::string random_program(unsigned seed, size_t lines)
+{
+  std::mt19937 random{seed};
+  const std::vector<std::string> pieces{
+    "(define x 12)", "(+ 1 -2.5e3 .5)", "; a comment with a \" quote",
+    "\"a string\"", "\"over\n; two (lines\"", "\"esc\\\" ; \\\\\"", "// (",
+    "'(a . b)", "(lambda (y) (* y y))", "\"\n\n\"", "# \"", "nil if set! let",
+    "\"open\n(\n\"(((", ")))"};
+  std::string program;
+  for (size_t i{0}; i < lines; ++i)
+  {
+    size_t count{random() % 4};
+    for (size_t j{0}; j < count; ++j)
+    {
+      program += pieces[random() % pieces.size()];
+      program += random() % 3 ? " " : "";
+    }
+    program += '\n';
+  }
+  return program;
+}
+
+void expect_same(const TokenBuffer& tokens, const TokenBuffer& expected)
+{
+  ASSERT_EQ(tokens.size(), expected.size());
+  for (size_t i{0}; i < expected.size(); ++i)
+  {
+    Token token{tokens.token(i)};
+    Token want{expected.token(i)};
+    ASSERT_EQ(token.type(), want.type()) << i;
+    ASSERT_EQ(token.offset(), want.offset()) << i;
+    ASSERT_EQ(token.string(), want.string()) << i;
+    if (want.type() == Token::Type::number)
+    {
+      ASSERT_EQ(token.is_integer(), want.is_integer()) << i;
+      ASSERT_EQ(token.number(), want.number()) << i;
+    }
+  }
+}
+}
+
+TEST(TokenBufferParallel, LexerTests)
+{
+  ThreadPool single{1};
+  ThreadPool pool{4};
+  for (unsigned seed{0}; seed < 20; ++seed)
+  {
+    std::string text{random_program(seed, 200)};
+    TokenBuffer serial{text};
+    for (size_t chunk : {1, 7, 64, 1000, 1 << 20})
+    {
+      expect_same(TokenBuffer{Source::from_string(text), single, chunk}, serial);
+      expect_same(TokenBuffer{Source::from_string(text), pool, chunk}, serial);
+    }
+  }
+}
+
+TEST(TokenBufferParallelEdges, LexerTests)
+{
+  ThreadPool pool{3};
+  for (std::string text : {"", "\n\n\n", "(a)", "\"never closed\n(a\n(b\n", "; only\n; comments\n",
+        "\"\n\n\n\n\n\n\n\n\"x\n"})
+  {
+    expect_same(TokenBuffer{Source::from_string(text), pool, 1}, TokenBuffer{text});
+  }
+}